@@ -13,6 +13,103 @@ namespace Math {
 #define CHECKRESIZE(_n) { if(empty()) resize(_n); else Assert(size()==_n); }
 
 
+/* Small float and double arrays are recycled through a per-thread cache of
+ * freed blocks, so the temporaries of configuration math do not go through
+ * the heap on every construction.  Sizes up to VECTOR_CACHE_MAX_SIZE are
+ * rounded up to one of a few size classes.  The class of a block only
+ * depends on the capacity that is stored with it, so blocks can be freed
+ * by any thread, and the cache of each class is bounded.  Other element
+ * types always use new[] and delete[].
+ */
+#define VECTOR_CACHE_MAX_SIZE 64
+#define VECTOR_CACHE_NUM_CLASSES 5
+#define VECTOR_CACHE_BLOCKS 32
+
+inline int VectorCacheClass(int n)
+{
+  if(n <= 4) return 0;
+  if(n <= 8) return 1;
+  if(n <= 16) return 2;
+  if(n <= 32) return 3;
+  return 4;
+}
+
+//plain data, so that it outlives the thread-local destructors and frees
+//from static destructors still work
+template <class T>
+struct VectorBlockCache
+{
+  //0: not yet used, 1: in use, 2: flushed at thread exit
+  int state;
+  int count[VECTOR_CACHE_NUM_CLASSES];
+  T* blocks[VECTOR_CACHE_NUM_CLASSES][VECTOR_CACHE_BLOCKS];
+};
+
+template <class T>
+struct VectorBlockCacheFlusher
+{
+  VectorBlockCache<T>* cache;
+  ~VectorBlockCacheFlusher() {
+    for(int c=0;c<VECTOR_CACHE_NUM_CLASSES;c++) {
+      for(int i=0;i<cache->count[c];i++)
+        delete [] cache->blocks[c][i];
+      cache->count[c] = 0;
+    }
+    cache->state = 2;
+  }
+};
+
+template <class T>
+inline VectorBlockCache<T>* GetVectorBlockCache()
+{
+  static thread_local VectorBlockCache<T> cache;
+  if(cache.state == 0) {
+    static thread_local VectorBlockCacheFlusher<T> flusher;
+    flusher.cache = &cache;
+    cache.state = 1;
+  }
+  return (cache.state == 1 ? &cache : NULL);
+}
+
+template <class T>
+inline T* AllocateCachedBlock(int n)
+{
+  if(n > VECTOR_CACHE_MAX_SIZE) return new T[n];
+  int c = VectorCacheClass(n);
+  VectorBlockCache<T>* cache = GetVectorBlockCache<T>();
+  if(cache && cache->count[c] > 0)
+    return cache->blocks[c][--cache->count[c]];
+  return new T[4<<c];
+}
+
+template <class T>
+inline void FreeCachedBlock(T* vals,int capacity)
+{
+  if(capacity <= VECTOR_CACHE_MAX_SIZE) {
+    int c = VectorCacheClass(capacity);
+    VectorBlockCache<T>* cache = GetVectorBlockCache<T>();
+    if(cache && cache->count[c] < VECTOR_CACHE_BLOCKS) {
+      cache->blocks[c][cache->count[c]++] = vals;
+      return;
+    }
+  }
+  delete [] vals;
+}
+
+template <class T>
+inline T* AllocateVector(int n) { return new T[n]; }
+template <class T>
+inline void FreeVector(T* vals,int capacity) { delete [] vals; }
+template <>
+inline float* AllocateVector(int n) { return AllocateCachedBlock<float>(n); }
+template <>
+inline void FreeVector(float* vals,int capacity) { FreeCachedBlock(vals,capacity); }
+template <>
+inline double* AllocateVector(int n) { return AllocateCachedBlock<double>(n); }
+template <>
+inline void FreeVector(double* vals,int capacity) { FreeCachedBlock(vals,capacity); }
+
+
 template <class T>
 VectorTemplate<T>::VectorTemplate()
 :vals(NULL),capacity(0),allocated(false),
@@ -93,8 +190,8 @@ void VectorTemplate<T>::resize(int _n)
       clear();
     }
     if(_n > capacity) {
-      SafeArrayDelete(vals);
-      vals = new T[_n];
+      if(vals) FreeVector(vals,capacity);
+      vals = AllocateVector<T>(_n);
       capacity = _n;
       if(!vals) {
 	FatalError("Not enough memory to allocate vector of size %d",_n);
@@ -133,14 +230,15 @@ void VectorTemplate<T>::resizePersist(int _n)
     }
     if(_n > capacity) {
       T* oldvals = vals;
-      vals = new T[_n];
+      int oldcapacity = capacity;
+      vals = AllocateVector<T>(_n);
       capacity = _n;
       if(!vals) {
 	FatalError("Not enough memory to allocate vector of size %d",_n);
       }
       //copy n values 
       gen_array_equal(vals, 1, oldvals, stride, n);
-      SafeArrayDelete(oldvals);
+      if(oldvals) FreeVector(oldvals,oldcapacity);
     }
     base = 0;
     stride = 1;
@@ -164,11 +262,9 @@ template <class T>
 void VectorTemplate<T>::clear()
 {
   if(allocated) {
-    SafeArrayDelete(vals);
-  }
-  else {
-    vals=NULL;
+    if(vals) FreeVector(vals,capacity);
   }
+  vals=NULL;
   capacity = 0;
   allocated = false;
   base=0;
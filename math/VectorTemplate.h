@@ -68,6 +68,10 @@ public:
  * should be called directly.  To reset it to the empty state (and delete
  * all manged data) the clear() method should be used.
  *
+ * The storage of small float and double vectors (up to 64 elements) is
+ * recycled through a per-thread cache, so temporary vectors, e.g.
+ * configurations in planning loops, rarely touch the heap.
+ *
  * A second usage mode is to point to data managed by some outside source.
  * Altering vector elements will alter the external data, and vice versa.
  * For example,
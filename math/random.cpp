@@ -5,5 +5,6 @@
 namespace Math {
 
 StandardRNG rng;
+thread_local RNG64* threadRng = NULL;
 
 } //namespace Math
@@ -9,7 +9,8 @@
  * @brief Defines a standard method for random floating-point number
  * generation.
  *
- * The random number generator is defined as Math::rng.
+ * The random number generator is defined as Math::rng.  A per-thread
+ * generator can be substituted by setting Math::threadRng.
  */
 
 /** @addtogroup Math
@@ -22,29 +23,42 @@ template <class RNG>
 float frand_gaussian(RNG& rng);
 template <class RNG>
 double drand_gaussian(RNG& rng);
+///RNG64 caches the spare gaussian value in the generator, so that each
+///stream's sequence does not depend on draws made from other streams
+inline float frand_gaussian(RNG64& rng);
+inline double drand_gaussian(RNG64& rng);
 
 namespace Math {
   /** @addtogroup Math */
   /*@{*/
 
 extern StandardRNG rng;
-inline void Srand(unsigned long seed) { rng.seed(seed); }
-inline long int RandInt() { return rng.randInt(); }
-inline long int RandInt(long int n) { return rng.randInt(n); }
+/** @brief If non-NULL, the random functions below draw from this generator
+ * rather than rng when called from the current thread.
+ *
+ * Multithreaded code that needs reproducible results should give each
+ * thread its own stream, e.g., RNG64 myRng; myRng.seed(seed,threadIndex);
+ * threadRng = &myRng;.  It is initially NULL on every thread.
+ */
+extern thread_local RNG64* threadRng;
+
+inline void Srand(unsigned long seed) { if(threadRng) threadRng->seed(seed); else rng.seed(seed); }
+inline long int RandInt() { return (threadRng ? threadRng->randInt() : rng.randInt()); }
+inline long int RandInt(long int n) { return (threadRng ? threadRng->randInt(n) : rng.randInt(n)); }
 
 #ifdef MATH_DOUBLE
-inline Real Rand() { return rng.randDouble(); }
-inline Real Rand(Real a,Real b) { return rng.randDouble(a,b); }
-inline Real RandGaussian() { return drand_gaussian(rng); }
+inline Real Rand() { return (threadRng ? threadRng->randDouble() : rng.randDouble()); }
+inline Real Rand(Real a,Real b) { return (threadRng ? threadRng->randDouble(a,b) : rng.randDouble(a,b)); }
+inline Real RandGaussian() { return (threadRng ? drand_gaussian(*threadRng) : drand_gaussian(rng)); }
 inline Real RandGaussian(Real mean, Real stddev) { return RandGaussian()*stddev+mean; }
 #else
-inline Real Rand() { return rng.randFloat(); }
-inline Real Rand(Real a,Real b) { return rng.randFloat(a,b); }
-inline Real RandGaussian() { return frand_gaussian(rng); }
+inline Real Rand() { return (threadRng ? threadRng->randFloat() : rng.randFloat()); }
+inline Real Rand(Real a,Real b) { return (threadRng ? threadRng->randFloat(a,b) : rng.randFloat(a,b)); }
+inline Real RandGaussian() { return (threadRng ? frand_gaussian(*threadRng) : frand_gaussian(rng)); }
 inline Real RandGaussian(Real mean, Real stddev) { return RandGaussian()*stddev+mean; }
 #endif //MATH_DOUBLE
 
-inline bool RandBool() { return rng.randInt() < (rng.maxValue()/2); }
+inline bool RandBool() { return (threadRng ? threadRng->randInt() < (threadRng->maxValue()/2) : rng.randInt() < (rng.maxValue()/2)); }
 inline bool RandBool(Real p) { return Rand() < p; }
 
 /** @fn Srand()
@@ -89,7 +103,7 @@ inline bool RandBool(Real p) { return Rand() < p; }
 template <class RNG>
 float frand_gaussian(RNG& rng)
 {
-  static float t = 0.0f;
+  static thread_local float t = 0.0f;
   float x,v1,v2,r;
   if (t == 0) {
     do {
@@ -111,7 +125,7 @@ float frand_gaussian(RNG& rng)
 template <class RNG>
 double drand_gaussian(RNG& rng)
 {
-  static double t = 0.0;
+  static thread_local double t = 0.0;
   double x,v1,v2,r;
   if (t == 0) {
     do {
@@ -130,4 +144,29 @@ double drand_gaussian(RNG& rng)
   }
 }
 
+inline double drand_gaussian(RNG64& rng)
+{
+  double x,v1,v2,r;
+  if (rng.gaussianSpare == 0) {
+    do {
+      v1 = 2.0 * rng.randDouble() - 1.0;
+      v2 = 2.0 * rng.randDouble() - 1.0;
+      r = v1 * v1 + v2 * v2;
+    } while (r>=1.0);
+    r = sqrt((-2.0*log(r))/r);
+    rng.gaussianSpare = v2*r;
+    return (v1*r);
+  }
+  else {
+    x = rng.gaussianSpare;
+    rng.gaussianSpare = 0.0;
+    return (x);
+  }
+}
+
+inline float frand_gaussian(RNG64& rng)
+{
+  return (float)drand_gaussian(rng);
+}
+
 #endif
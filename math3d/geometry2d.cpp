@@ -71,14 +71,15 @@ Real Box2D::distance(const Point2D& pt,Point2D& out) const
 
 Real Box2D::distanceSquared(const Point2D& pt,Point2D& out) const
 {
-  Point2D loc;
+  Point2D loc,closest;
   toLocal(pt, loc);
-  if(loc.x < 0) loc.x = 0;
-  if(loc.y < 0) loc.y = 0;
-  if(loc.x > dims.x) loc.x = dims.x;
-  if(loc.y > dims.y) loc.y = dims.y;
-  Real norm2 = loc.normSquared();
-  fromLocal(loc,out);
+  closest = loc;
+  if(closest.x < 0) closest.x = 0;
+  if(closest.y < 0) closest.y = 0;
+  if(closest.x > dims.x) closest.x = dims.x;
+  if(closest.y > dims.y) closest.y = dims.y;
+  Real norm2 = loc.distanceSquared(closest);
+  fromLocal(closest,out);
   return norm2;
 }
 
@@ -8,6 +8,8 @@
 #include "OMPLInterface.h"
 #include "PointLocation.h"
 #include "SBL.h"
+#include "ParallelTreePlanner.h"
+#include "ParallelShortcut.h"
 #include "FMMMotionPlanner.h"
 #include "Timer.h"
 
@@ -21,6 +23,8 @@ void ToCollection(const MotionPlannerFactory& factory,AnyCollection& items)
   items["type"] = factory.type;
   items["knn"] = factory.knn;
   items["suboptimalityFactor"] = factory.suboptimalityFactor;
+  items["informedSampling"] = factory.informedSampling;
+  items["pruning"] = factory.pruning;
   items["connectionThreshold"] = factory.connectionThreshold;
   items["ignoreConnectedComponents"] = factory.ignoreConnectedComponents;
   items["perturbationRadius"] = factory.perturbationRadius;
@@ -28,7 +32,9 @@ void ToCollection(const MotionPlannerFactory& factory,AnyCollection& items)
   items["bidirectional"] = factory.bidirectional;
   items["useGrid"] = factory.useGrid;
   items["gridResolution"] = factory.gridResolution;
+  items["sparseGrid"] = factory.sparseGrid;
   items["randomizeFrequency"] = factory.randomizeFrequency;
+  items["numThreads"] = factory.numThreads;
   items["pointLocation"] = factory.pointLocation;
   items["storeEdges"] = factory.storeEdges;
   items["shortcut"] = factory.shortcut;
@@ -182,20 +188,25 @@ class RestartShortcutMotionPlanner : public RestartMotionPlanner
 };
 
 /** @brief Plans a path and then tries to shortcut it with the remaining time.
+ *
+ * Shortcuts are tested in batches by a ParallelShortcutter, and each tested
+ * shortcut counts as one iteration.
  */
 class ShortcutMotionPlanner : public PiggybackMotionPlanner
 {
  public:
-  ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp);
+  ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp,int numThreads=1);
   virtual bool IsOptimizing() const { return true; }
   virtual std::string Plan(MilestonePath& path,const HaltingCondition& cond);
   virtual int PlanMore();
   virtual bool IsSolved() { return !bestPath.edges.empty(); }
   virtual void GetSolution(MilestonePath& path) { path = bestPath; }
   virtual int NumIterations() const { return numIters; }
+  virtual void GetStats(PropertyMap& stats) const;
 
   MilestonePath bestPath;
   int numIters;
+  ParallelShortcutter shortcutter;
 };
 
 
@@ -557,6 +568,51 @@ class SBLInterface  : public MotionPlannerInterface
   Config qStart,qGoal;
 };
 
+class ParallelBidirectionalInterface  : public MotionPlannerInterface
+{
+ public:
+  ParallelBidirectionalInterface(ParallelBidirectionalPlanner* _planner)
+    :planner(_planner)
+  {}
+  virtual bool CanAddMilestone() const { if(qStart.n != 0 && qGoal.n != 0) return false; return true; }
+  virtual int AddMilestone(const Config& q) {
+    if(qStart.n == 0) {
+      qStart = q;
+      return 0;
+    }
+    else if(qGoal.n == 0) {
+      qGoal = q;
+      planner->Init(qStart,qGoal);
+      return 1;
+    }
+    fprintf(stderr,"ParallelBidirectionalInterface::AddMilestone: Warning, point-to-point planner already has a start and goal\n");
+    AssertNotReached();
+    return -1;
+  }
+  virtual void GetMilestone(int i,Config& q) { if(i==0) q=qStart; else q=qGoal; }
+  virtual int PlanMore() { 
+    if(qStart.n == 0 || qGoal.n == 0) {
+      fprintf(stderr,"AnyMotionPlanner::PlanMore(): parallel planners are point-to-point, AddMilestone() must be called to set the start and goal configuration\n");
+      return -1;
+    }
+    planner->PlanRound();
+    return -1;
+  }
+  virtual int NumIterations() const { return planner->numIters; }
+  virtual int NumMilestones() const { return planner->NumMilestones(); }
+  virtual int NumComponents() const { return (planner->IsDone() ? 1 : 2); }
+  virtual bool IsConnected(int ma,int mb) const { return planner->IsDone(); }
+  virtual void GetPath(int ma,int mb,MilestonePath& path) { planner->CreatePath(path); if(ma == 1) ReversePath(path); }
+  virtual void GetStats(PropertyMap& stats) const {
+    MotionPlannerInterface::GetStats(stats);
+    stats.set("numThreads",planner->numThreads);
+    stats.set("numRounds",planner->numRounds);
+  }
+
+  SmartPointer<ParallelBidirectionalPlanner> planner;
+  Config qStart,qGoal;
+};
+
 class SBLPRTInterface  : public MotionPlannerInterface
 {
  public:
@@ -699,6 +755,8 @@ class PRMStarInterface  : public MotionPlannerInterface
     stats.set("numEdgeChecks",planner.numEdgeChecks);
     if(planner.lazy)
       stats.set("numEdgesPrechecked",planner.numEdgePrechecks);
+    stats.set("numPrunes",planner.numPrunes);
+    stats.set("numMilestonesPruned",planner.numMilestonesPruned);
   }
 
   PRMStarPlanner planner;
@@ -710,7 +768,7 @@ class FMMInterface  : public MotionPlannerInterface
  public:
   FMMInterface(CSpace* space,bool _anytime)
     : planner(space),anytime(_anytime),iterationCount(0)
-    {}
+    { planner.informed = anytime; }
   virtual ~FMMInterface() {}
   virtual bool CanAddMilestone() const { if(qStart.n != 0 && qGoal.n != 0) return false; return true; }
   virtual int AddMilestone(const Config& q) {
@@ -762,14 +820,30 @@ class FMMInterface  : public MotionPlannerInterface
   }
   virtual void GetRoadmap(RoadmapPlanner& roadmap) const { 
     //simply output all the visited grid cells
-    if(planner.distances.numValues()==0) return;
-    vector<int> index(qStart.n,0);
-    do {
-      if(!IsInf(planner.distances[index])) {
-	Vector config = planner.FromGrid(index);
-	roadmap.AddMilestone(config);
+    if(planner.GridSize()==0) return;
+    if(planner.sparse) {
+      const SparseArrayND<Real>& distances = planner.sparseDistances;
+      vector<int> lo,hi(qStart.n),index;
+      for(SparseArrayND<Real>::BlockMap::const_iterator b=distances.blocks.begin();b!=distances.blocks.end();b++) {
+	distances.blockStart(b->first,lo);
+	for(int i=0;i<qStart.n;i++)
+	  hi[i] = Min(lo[i]+distances.blockSize,distances.dims[i])-1;
+	index = lo;
+	do {
+	  if(!IsInf(b->second[distances.offsetInBlock(index)]))
+	    roadmap.AddMilestone(planner.FromGrid(index));
+	} while(!IncrementIndex(index,lo,hi));
       }
-    } while(IncrementIndex(index,planner.distances.dims)==0);
+    }
+    else {
+      vector<int> index(qStart.n,0);
+      do {
+	if(!IsInf(planner.distances[index])) {
+	  Vector config = planner.FromGrid(index);
+	  roadmap.AddMilestone(config);
+	}
+      } while(IncrementIndex(index,planner.distances.dims)==0);
+    }
 
     if(planner.solution.edges.empty()) {
       //add debugging path
@@ -785,12 +859,14 @@ class FMMInterface  : public MotionPlannerInterface
   }
   virtual void GetStats(PropertyMap& stats) const {
     MotionPlannerInterface::GetStats(stats);
-    if(planner.dynamicDomain) {
+    if(planner.dynamicDomain || planner.informed) {
       vector<Real> bmin(planner.bmin),bmax(planner.bmax);
       stats.setArray("gridMin",bmin);
       stats.setArray("gridMax",bmax);
     }
-    stats.set("gridSize",planner.distances.numValues());
+    stats.set("gridSize",planner.GridSize());
+    stats.set("gridMemory",planner.gridMemory);
+    stats.set("peakGridMemory",planner.peakGridMemory);
   }
 
 
@@ -1315,10 +1391,11 @@ MotionPlannerFactory::MotionPlannerFactory()
    knn(10),
    connectionThreshold(Inf),
    suboptimalityFactor(0),
+   informedSampling(false),pruning(false),
    ignoreConnectedComponents(false),
    perturbationRadius(0.1),perturbationIters(5),
    bidirectional(true),
-   useGrid(true),gridResolution(0),randomizeFrequency(50),
+   useGrid(true),gridResolution(0),sparseGrid(false),randomizeFrequency(50),numThreads(1),
    storeEdges(true),shortcut(false),restart(false),
    restartTermCond("{foundSolution:1,maxIters:1000}")
 {}
@@ -1387,7 +1464,7 @@ MotionPlannerInterface* MotionPlannerFactory::ApplyModifiers(MotionPlannerInterf
     return new RestartMotionPlanner(norestart,problem,iterTerm);
   }
   else if(shortcut) {
-    return new ShortcutMotionPlanner(planner);
+    return new ShortcutMotionPlanner(planner,numThreads);
   }
   else
     return planner;
@@ -1461,6 +1538,18 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
   else if(type=="any" || type=="sbl") {
     Real res=gridResolution;
     if(gridResolution <= 0) res = 0.1;
+    if(numThreads > 1) {
+      ParallelSBLPlanner* sbl = new ParallelSBLPlanner(space);
+      sbl->numThreads = numThreads;
+      sbl->seed = (unsigned long)RandInt();
+      sbl->useGrid = useGrid;
+      sbl->gridDivision = res;
+      sbl->numItersPerRandomize = randomizeFrequency;
+      sbl->maxExtendDistance = perturbationRadius;
+      sbl->maxExtendIters = perturbationIters;
+      sbl->edgeConnectionThreshold = connectionThreshold;
+      return new ParallelBidirectionalInterface(sbl);
+    }
     SBLInterface* sbl = new SBLInterface(space,useGrid,res,randomizeFrequency);
     sbl->sbl->maxExtendDistance = perturbationRadius;
     sbl->sbl->maxExtendIters = perturbationIters;
@@ -1475,7 +1564,15 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     return sblprt;
   }
   else if(type=="rrt") {
-    if(bidirectional) {
+    if(bidirectional && numThreads > 1) {
+      ParallelRRTPlanner* rrt = new ParallelRRTPlanner(space);
+      rrt->numThreads = numThreads;
+      rrt->seed = (unsigned long)RandInt();
+      rrt->connectionThreshold = connectionThreshold;
+      rrt->delta = perturbationRadius;
+      return new ParallelBidirectionalInterface(rrt);
+    }
+    else if(bidirectional) {
       BiRRTInterface* rrt = new BiRRTInterface(space);
       rrt->rrt.connectionThreshold = connectionThreshold;
       rrt->rrt.delta = perturbationRadius;
@@ -1492,6 +1589,8 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     PRMStarInterface* prm = new PRMStarInterface(space);
     prm->planner.lazy = false;
     prm->planner.connectionThreshold = connectionThreshold;
+    prm->planner.informedSampling = informedSampling;
+    prm->planner.pruning = pruning;
     ReadPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with PRM* planner\n");
@@ -1504,6 +1603,8 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     prm->planner.bidirectional = bidirectional;
     prm->planner.connectionThreshold = connectionThreshold;
     prm->planner.suboptimalityFactor = suboptimalityFactor;
+    prm->planner.informedSampling = informedSampling;
+    prm->planner.pruning = pruning;
     ReadPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with RRT* planner\n");
@@ -1514,6 +1615,8 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     prm->planner.lazy = true;
     prm->planner.connectionThreshold = connectionThreshold;
     prm->planner.suboptimalityFactor = suboptimalityFactor;
+    prm->planner.informedSampling = informedSampling;
+    prm->planner.pruning = pruning;
     ReadPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with Lazy-PRM* planner\n");
@@ -1526,6 +1629,8 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     prm->planner.bidirectional = bidirectional;
     prm->planner.connectionThreshold = connectionThreshold;
     prm->planner.suboptimalityFactor = suboptimalityFactor;
+    prm->planner.informedSampling = informedSampling;
+    prm->planner.pruning = pruning;
     ReadPointLocation(pointLocation,prm->planner);
     if(shortcut || restart) 
       printf("MotionPlannerInterface: Warning, shortcut and restart are incompatible with Lazy-RRG* planner\n");
@@ -1581,6 +1686,8 @@ MotionPlannerInterface* MotionPlannerFactory::CreateRaw(CSpace* space)
     if(!domainMin.empty() && !domainMax.empty() && gridResolution > 0) {
       fmm->planner.dynamicDomain = false;
     }
+    fmm->planner.numThreads = numThreads;
+    fmm->planner.sparse = sparseGrid;
     if(restart) 
       printf("MotionPlannerInterface: Warning, restart is incompatible with FMM planner\n");
     return fmm;
@@ -1615,13 +1722,17 @@ bool MotionPlannerFactory::Load(TiXmlElement* e)
   e->QueryValueAttribute("knn",&knn);
   e->QueryValueAttribute("connectionThreshold",&connectionThreshold);
   e->QueryValueAttribute("suboptimalityFactor",&suboptimalityFactor);
+  e->QueryValueAttribute("informedSampling",&informedSampling);
+  e->QueryValueAttribute("pruning",&pruning);
   e->QueryValueAttribute("ignoreConnectedComponents",&ignoreConnectedComponents);
   e->QueryValueAttribute("perturbationRadius",&perturbationRadius);
   e->QueryValueAttribute("perturbationIters",&perturbationIters);
   e->QueryValueAttribute("bidirectional",&bidirectional);
   e->QueryValueAttribute("useGrid",&useGrid);
   e->QueryValueAttribute("gridResolution",&gridResolution);
+  e->QueryValueAttribute("sparseGrid",&sparseGrid);
   e->QueryValueAttribute("randomizeFrequency",&randomizeFrequency);
+  e->QueryValueAttribute("numThreads",&numThreads);
   e->QueryValueAttribute("storeEdges",&storeEdges);
   e->QueryValueAttribute("shortcut",&shortcut);
   e->QueryValueAttribute("restart",&restart);
@@ -1649,6 +1760,8 @@ bool MotionPlannerFactory::LoadJSON(const string& str)
   type = typestr;
   items["knn"].as(knn);
   items["suboptimalityFactor"].as(suboptimalityFactor);
+  items["informedSampling"].as(informedSampling);
+  items["pruning"].as(pruning);
   items["connectionThreshold"].as(connectionThreshold);
   items["ignoreConnectedComponents"].as(ignoreConnectedComponents);
   items["perturbationRadius"].as(perturbationRadius);
@@ -1657,7 +1770,9 @@ bool MotionPlannerFactory::LoadJSON(const string& str)
   items["useGrid"].as(useGrid);
   items["pointLocation"].as(pointLocation);
   items["gridResolution"].as(gridResolution);
+  items["sparseGrid"].as(sparseGrid);
   items["randomizeFrequency"].as(randomizeFrequency);
+  items["numThreads"].as(numThreads);
   items["storeEdges"].as(storeEdges);
   items["shortcut"].as(shortcut);
   items["restart"].as(restart);
@@ -1971,9 +2086,13 @@ void RestartShortcutMotionPlanner::GetRoadmap(RoadmapPlanner& roadmap) const
 }
 
 
-ShortcutMotionPlanner::ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp)
+ShortcutMotionPlanner::ShortcutMotionPlanner(const SmartPointer<MotionPlannerInterface>& mp,int numThreads)
   :PiggybackMotionPlanner(mp),numIters(0)
-{}
+{
+  shortcutter.numThreads = numThreads;
+  if(numThreads <= 1) shortcutter.candidatesPerThread = 1;
+  shortcutter.Seed((unsigned long)RandInt());
+}
 
 std::string ShortcutMotionPlanner::Plan(MilestonePath& path,const HaltingCondition& cond)
 {
@@ -1988,7 +2107,8 @@ std::string ShortcutMotionPlanner::Plan(MilestonePath& path,const HaltingConditi
   int itersLeft = cond.maxIters - mp->NumIterations(); 
   Real lastCheckTime = timer.ElapsedTime(), lastCheckValue = path.Length();
   printf("Beginning shortcutting with %d iters and %g seconds left\n",itersLeft,cond.timeLimit-timer.ElapsedTime());
-  for(int iters=0;iters<itersLeft;iters++) {
+  shortcutter.ResetTrace();
+  for(int iters=0;iters<itersLeft;iters+=shortcutter.BatchSize()) {
     Real t = timer.ElapsedTime();
     if(t >= cond.timeLimit) {
       bestPath = path;
@@ -1997,14 +2117,16 @@ std::string ShortcutMotionPlanner::Plan(MilestonePath& path,const HaltingConditi
     //check for cost improvements
     if(t > lastCheckTime + cond.costImprovementPeriod) {
       Real len = path.Length();
-      if(lastCheckValue - len < cond.costImprovementThreshold)
+      if(lastCheckValue - len < cond.costImprovementThreshold) {
+	bestPath = path;
 	return "costImprovementThreshold";
+      }
       lastCheckTime = t;
       lastCheckValue = len;
     }
     //do shortcutting
-    path.Reduce(1);
-    numIters ++;
+    shortcutter.Round(path);
+    numIters += shortcutter.BatchSize();
   }
   bestPath = path;
   return "maxIters";
@@ -2012,16 +2134,29 @@ std::string ShortcutMotionPlanner::Plan(MilestonePath& path,const HaltingConditi
 
 int ShortcutMotionPlanner::PlanMore()
 {
-  numIters++;
   if(bestPath.edges.empty()) {
+    numIters++;
     int res = mp->PlanMore();
     if(mp->IsSolved()) {
       mp->GetSolution(bestPath);
+      shortcutter.ResetTrace();
     }
     return res;
   }
   else {
-    bestPath.Reduce(1);
+    shortcutter.Round(bestPath);
+    numIters += shortcutter.BatchSize();
     return -1;
   }
 }
+
+void ShortcutMotionPlanner::GetStats(PropertyMap& stats) const
+{
+  mp->GetStats(stats);
+  stats.set("numIters",numIters);
+  stats.set("numShortcutRounds",shortcutter.numRounds);
+  stats.set("numShortcutCandidates",shortcutter.numCandidates);
+  stats.set("numShortcuts",shortcutter.numShortcuts);
+  stats.setArray("shortcutTraceTimes",shortcutter.traceTimes);
+  stats.setArray("shortcutTraceLengths",shortcutter.traceLengths);
+}
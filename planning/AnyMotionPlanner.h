@@ -259,13 +259,17 @@ class MotionPlannerFactory
   int knn;                 ///<for PRM (default 10)
   Real connectionThreshold;///<for PRM,RRT,SBL,SBLPRT,RRT*,PRM*,LazyPRM*,LazyRRG* (default Inf)
   Real suboptimalityFactor;///<for RRT*, LazyPRM*, LazyRRG* (default 0)
+  bool informedSampling;   ///<for PRM*, RRT*, LazyPRM*, LazyRRG* (default false): samples from the informed set of the current solution
+  bool pruning;            ///<for PRM*, RRT*, LazyPRM*, LazyRRG* (default false): deletes milestones that cannot improve the current solution
   bool ignoreConnectedComponents; //for PRM (default false)
   Real perturbationRadius; ///<for Perturbation,EST,RRT,SBL,SBLPRT (default 0.1)
   int perturbationIters;   ///<for SBL (default 5)
   bool bidirectional;      ///<for RRT (default true)
   bool useGrid;            ///<for SBL, SBLPRT (default true): for SBL, uses grid-based random point selection
   Real gridResolution;     ///<for SBL, SBLPRT, FMM, FMM* (default 0): if nonzero, for SBL, specifies point selection grid size (default 0.1), for FMM / FMM*, specifies resolution (default 1/8 of domain)
+  bool sparseGrid;         ///<for FMM, FMM* (default false): if true, the grid is stored as sparse blocks and only the blocks the front reaches are allocated, which makes higher-dimensional grids practical (see FMMMotionPlanner::sparse)
   int randomizeFrequency;  ///<for SBL, SBLPRT (default 50): how often the grid projection is randomly perturbed
+  int numThreads;          ///<for SBL, bidirectional RRT, FMM, FMM*, and shortcutting (default 1): if > 1, trees are grown in parallel by this many threads (see ParallelBidirectionalPlanner), FMM grids are solved with the block-parallel FIMSearch, and shortcuts are tested in parallel batches (see ParallelShortcutter)
   string pointLocation;    ///<for PRM, RRT*, PRM*, LazyPRM*, LazyRRG* (default ""): specifies a point location data structure ("random", "randombest [k]", "kdtree" supported)
   bool storeEdges;         ///<true if local planner data is stored during planning (false may save memory, default)
   bool shortcut;           ///<true if you wish to perform shortcutting afterwards (default false)
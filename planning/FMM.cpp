@@ -6,6 +6,7 @@
 #include <math/misc.h>
 #include <math/vector.h>
 #include <utils/ioutils.h>
+#include <utils/threadutils.h>
 #include <fstream>
 #include <Timer.h>
 #include <iostream>
@@ -791,13 +792,492 @@ bool FMMSearch(const Vector& startorig,const Vector& goalorig,
 }
 
 
+/** Block-parallel Fast Iterative Method.
+ *
+ * The grid is divided into blocks of blockSize^N cells.  A list of active
+ * blocks is kept; each round, every active block is relaxed with forward and
+ * backward Gauss-Seidel sweeps of the upwind (Godunov) eikonal update, and
+ * the neighbors of blocks whose boundary values dropped are activated.
+ *
+ * Blocks are colored by the parity of the sum of their block indices, so
+ * blocks that share a face always have different colors.  The update stencil
+ * only reads face neighbors, so all blocks of one color can be relaxed
+ * concurrently without locking, and the result does not depend on the
+ * number of threads.
+ *
+ * The distances, costs, and seed flags are stored in SparseArrayNDs with
+ * the same blocks, and a block is only allocated (and its costs evaluated)
+ * when it is first activated.  Unreached parts of the grid use no memory.
+ * If memoryLimit is nonzero, blocks that would exceed it are never
+ * activated, i.e., treated as obstacles.
+ *
+ * Once all goal cells have finite values, changes that are larger than the
+ * largest goal value are not propagated to other blocks, so like FMMSearch
+ * the field is only guaranteed up to the cost of reaching the goal.
+ */
+struct FIMBlock
+{
+  bool costsEvaluated;
+  bool active;
+  bool stillActive;
+  //smallest value written to each face in the last relaxation
+  vector<Real> faceMin;
+};
+
+struct FIMSolver
+{
+  typedef SparseArrayND<Real>::Key Key;
+  typedef UNORDERED_MAP_TEMPLATE<Key,FIMBlock> BlockMap;
+
+  FIMSolver(SparseArrayND<Real>& distances);
+  void Setup(const vector<int>& dims);
+  ///Allocates the block if necessary and adds it to the active list.
+  ///Returns NULL if the memory limit does not allow it
+  FIMBlock* Activate(Key key);
+  void Seed(const vector<int>& cell,Real value);
+  void EvaluateBlockCosts(Key key,FIMBlock& block);
+  void ProcessBlock(Key key,FIMBlock& block,vector<int>& cells,vector<int>& indices);
+  void Solve(const vector<vector<int> >& goalCells);
+  bool Reached(const vector<vector<int> >& goalCells) const;
+  int Color(Key key) const;
+  size_t MemoryUsage() const;
+  void GetDense(ArrayND<Real>& dense) const;
+
+  SparseArrayND<Real>& distances;
+  SparseArrayND<Real> costs;
+  SparseArrayND<char> fixedCell;
+  BlockMap blocks;
+  vector<Key> activeList;
+  ///costs come from denseCosts if non-NULL, otherwise from costFn at the
+  ///grid points bmin + index*res
+  const ArrayND<Real>* denseCosts;
+  Real (*costFn)(const Vector& coords);
+  Vector bmin,res;
+  int numThreads;
+  int blockSize;
+  int maxSweeps;
+  size_t memoryLimit;
+  bool memoryLimitReached;
+  int n;
+
+  //statistics
+  int numRounds,numBlockUpdates;
+};
+
+struct FIMWorkItem
+{
+  FIMSolver::Key key;
+  FIMBlock* block;
+};
+
+struct FIMThreadData
+{
+  FIMSolver* solver;
+  const vector<FIMWorkItem>* work;
+  int index,stride;
+};
+
+static void* FIMThreadFunc(void* vdata)
+{
+  FIMThreadData* data = (FIMThreadData*)vdata;
+  vector<int> cells,indices;
+  for(size_t i=data->index;i<data->work->size();i+=data->stride)
+    data->solver->ProcessBlock((*data->work)[i].key,*(*data->work)[i].block,cells,indices);
+  return NULL;
+}
+
+FIMSolver::FIMSolver(SparseArrayND<Real>& _distances)
+  :distances(_distances),denseCosts(NULL),costFn(NULL),numThreads(1),blockSize(0),maxSweeps(0),memoryLimit(0),memoryLimitReached(false),n(0),numRounds(0),numBlockUpdates(0)
+{}
+
+void FIMSolver::Setup(const vector<int>& dims)
+{
+  n = (int)dims.size();
+  //blocks of at most ~1000 cells, so that padding at the domain boundary
+  //stays small in high dimensions
+  if(blockSize <= 0) blockSize = (n <= 3 ? 8 : (n <= 5 ? 4 : 2));
+  if(maxSweeps <= 0) maxSweeps = 2*n+2;
+  distances.resize(dims,blockSize,Inf);
+  costs.resize(dims,blockSize,Inf);
+  fixedCell.resize(dims,blockSize,0);
+  blocks.clear();
+  activeList.resize(0);
+}
+
+size_t FIMSolver::MemoryUsage() const
+{
+  size_t perBlock = sizeof(Key)+sizeof(FIMBlock)+2*n*sizeof(Real)+3*sizeof(void*);
+  return distances.memoryUsage()+costs.memoryUsage()+fixedCell.memoryUsage()+blocks.size()*perBlock+blocks.bucket_count()*sizeof(void*);
+}
+
+int FIMSolver::Color(Key key) const
+{
+  int sum = 0;
+  for(int i=0;i<n;i++)
+    sum += int((key/distances.blockStrides[i])%distances.blockDims[i]);
+  return sum%2;
+}
+
+FIMBlock* FIMSolver::Activate(Key key)
+{
+  typename BlockMap::iterator i = blocks.find(key);
+  FIMBlock* block;
+  if(i != blocks.end()) block = &i->second;
+  else {
+    if(memoryLimit > 0) {
+      size_t blockBytes = distances.blockValues*(2*sizeof(Real)+sizeof(char))+2*n*sizeof(Real)+sizeof(FIMBlock);
+      if(MemoryUsage()+blockBytes > memoryLimit) {
+        memoryLimitReached = true;
+        return NULL;
+      }
+    }
+    block = &blocks[key];
+    block->costsEvaluated = false;
+    block->active = false;
+    block->stillActive = false;
+    block->faceMin.resize(2*n,Inf);
+    distances.allocateBlock(key);
+    costs.allocateBlock(key);
+    fixedCell.allocateBlock(key);
+  }
+  if(!block->active) {
+    block->active = true;
+    activeList.push_back(key);
+  }
+  return block;
+}
+
+void FIMSolver::EvaluateBlockCosts(Key key,FIMBlock& block)
+{
+  Real* c = costs.getBlock(key);
+  vector<int> lo,hi(n),index;
+  distances.blockStart(key,lo);
+  for(int i=0;i<n;i++)
+    hi[i] = Min(lo[i]+blockSize,distances.dims[i])-1;
+  index = lo;
+  Vector pt(n);
+  do {
+    int k = distances.offsetInBlock(index);
+    if(denseCosts)
+      c[k] = (*denseCosts)[index];
+    else {
+      for(int i=0;i<n;i++)
+        pt[i] = bmin[i] + index[i]*res[i];
+      c[k] = costFn(pt);
+    }
+  } while(!IncrementIndex(index,lo,hi));
+  block.costsEvaluated = true;
+}
+
+void FIMSolver::Seed(const vector<int>& cell,Real value)
+{
+  Key key = distances.blockKey(cell);
+  FIMBlock* block = Activate(key);
+  if(!block) return;
+  if(!block->costsEvaluated) EvaluateBlockCosts(key,*block);
+  int k = distances.offsetInBlock(cell);
+  Real c = costs.getBlock(key)[k];
+  if(IsInf(c)) return;
+  Real* d = distances.getBlock(key);
+  d[k] = Min(d[k],value*c);
+  fixedCell.getBlock(key)[k] = 1;
+  //seeds are never relaxed, so blocks across the faces they lie on need to
+  //be activated here
+  for(int i=0;i<n;i++) {
+    if(cell[i]%blockSize == 0 && cell[i] > 0)
+      Activate(key-distances.blockStrides[i]);
+    if(cell[i]%blockSize == blockSize-1 && cell[i]+1 < distances.dims[i])
+      Activate(key+distances.blockStrides[i]);
+  }
+}
+
+//solves sum_j max(u-a_j,0)^2 = c^2 given the neighbor values a sorted in
+//increasing order
+static Real UpwindUpdate(const Real* a,int k,Real c)
+{
+  Real u = a[0]+c;
+  Real s = a[0], s2 = Sqr(a[0]);
+  for(int m=2;m<=k;m++) {
+    if(u <= a[m-1]) break;
+    s += a[m-1];
+    s2 += Sqr(a[m-1]);
+    Real det = Sqr(s) - m*(s2-Sqr(c));
+    if(det < 0) break;
+    u = (s + Sqrt(det))/m;
+  }
+  return u;
+}
+
+void FIMSolver::ProcessBlock(Key key,FIMBlock& block,vector<int>& cells,vector<int>& indices)
+{
+  if(!block.costsEvaluated) EvaluateBlockCosts(key,block);
+  Real* d = distances.getBlock(key);
+  const Real* c = costs.getBlock(key);
+  const char* fixed = fixedCell.getBlock(key);
+  const vector<int>& cs = distances.cellStrides;
+  int last = blockSize-1;
+  //local upper bounds and neighboring blocks across each face
+  vector<int> lo,hi(n);
+  distances.blockStart(key,lo);
+  vector<const Real*> nlo(n,(const Real*)NULL),nhi(n,(const Real*)NULL);
+  for(int i=0;i<n;i++) {
+    hi[i] = Min(lo[i]+blockSize,distances.dims[i])-1-lo[i];
+    if(lo[i] > 0) nlo[i] = distances.getBlock(key-distances.blockStrides[i]);
+    if(lo[i]+blockSize < distances.dims[i]) nhi[i] = distances.getBlock(key+distances.blockStrides[i]);
+  }
+  //list the free cells in lexicographic order
+  cells.resize(0);
+  indices.resize(0);
+  vector<int> index(n,0),zero(n,0);
+  do {
+    int k = 0;
+    for(int i=0;i<n;i++) k += index[i]*cs[i];
+    if(fixed[k]) continue;
+    cells.push_back(k);
+    indices.insert(indices.end(),index.begin(),index.end());
+  } while(!IncrementIndex(index,zero,hi));
+
+  vector<Real> a(n);
+  Real* fmin = &block.faceMin[0];
+  for(int i=0;i<2*n;i++) fmin[i] = Inf;
+  int numCells = (int)cells.size();
+  bool changed = false;
+  for(int sweep=0;sweep<maxSweeps;sweep++) {
+    changed = false;
+    for(int j=0;j<numCells;j++) {
+      int m = (sweep%2==0 ? j : numCells-1-j);
+      int k = cells[m];
+      if(IsInf(c[k])) continue;
+      const int* li = &indices[m*n];
+      //smallest neighbor value along each axis, in increasing order
+      int numa = 0;
+      for(int i=0;i<n;i++) {
+        Real v = Inf;
+        if(li[i] > 0) v = d[k-cs[i]];
+        else if(nlo[i]) v = nlo[i][k+last*cs[i]];
+        if(li[i] < hi[i]) v = Min(v,d[k+cs[i]]);
+        else if(nhi[i]) v = Min(v,nhi[i][k-last*cs[i]]);
+        if(IsInf(v)) continue;
+        int p = numa;
+        while(p > 0 && a[p-1] > v) { a[p] = a[p-1]; p--; }
+        a[p] = v;
+        numa++;
+      }
+      if(numa == 0) continue;
+      Real u = UpwindUpdate(&a[0],numa,c[k]);
+      if(u < d[k] && (IsInf(d[k]) || d[k]-u > 1e-10*d[k])) {
+        d[k] = u;
+        changed = true;
+        for(int i=0;i<n;i++) {
+          if(li[i] == 0) fmin[2*i] = Min(fmin[2*i],u);
+          if(li[i] == last) fmin[2*i+1] = Min(fmin[2*i+1],u);
+        }
+      }
+    }
+    if(!changed) break;
+  }
+  //the block did not converge within maxSweeps
+  block.stillActive = changed;
+}
+
+bool FIMSolver::Reached(const vector<vector<int> >& goalCells) const
+{
+  for(size_t i=0;i<goalCells.size();i++)
+    if(IsInf(distances[goalCells[i]])) return false;
+  return true;
+}
+
+void FIMSolver::Solve(const vector<vector<int> >& goalCells)
+{
+  vector<FIMWorkItem> work;
+  vector<Key> rest;
+  while(!activeList.empty()) {
+    Real goalBound = Inf;
+    if(!goalCells.empty() && Reached(goalCells)) {
+      goalBound = 0;
+      for(size_t i=0;i<goalCells.size();i++)
+        goalBound = Max(goalBound,distances[goalCells[i]]);
+    }
+    for(int color=0;color<2;color++) {
+      work.resize(0);
+      rest.resize(0);
+      for(size_t i=0;i<activeList.size();i++) {
+        if(Color(activeList[i]) == color) {
+          FIMWorkItem item;
+          item.key = activeList[i];
+          item.block = &blocks[item.key];
+          work.push_back(item);
+        }
+        else
+          rest.push_back(activeList[i]);
+      }
+      if(work.empty()) continue;
+      numBlockUpdates += (int)work.size();
+
+      int numWorkers = Max(1,Min(numThreads,(int)work.size()));
+      vector<FIMThreadData> data(numWorkers);
+      vector<Thread> threads;
+      threads.reserve(numWorkers);
+      for(int w=0;w<numWorkers;w++) {
+        data[w].solver = this;
+        data[w].work = &work;
+        data[w].index = w;
+        data[w].stride = numWorkers;
+        if(w > 0) threads.push_back(ThreadStart(FIMThreadFunc,&data[w]));
+      }
+      FIMThreadFunc(&data[0]);
+      for(size_t i=0;i<threads.size();i++)
+        ThreadJoin(threads[i]);
+
+      //activate neighbors across faces whose values dropped
+      activeList = rest;
+      for(size_t j=0;j<work.size();j++) {
+        Key key = work[j].key;
+        FIMBlock* block = work[j].block;
+        block->active = false;
+        if(block->stillActive) Activate(key);
+        for(int i=0;i<n;i++) {
+          int bi = int((key/distances.blockStrides[i])%distances.blockDims[i]);
+          if(bi > 0 && block->faceMin[2*i] < goalBound) Activate(key-distances.blockStrides[i]);
+          if(bi+1 < distances.blockDims[i] && block->faceMin[2*i+1] < goalBound) Activate(key+distances.blockStrides[i]);
+        }
+      }
+    }
+    numRounds++;
+  }
+}
+
+void FIMSolver::GetDense(ArrayND<Real>& dense) const
+{
+  dense.resize(distances.dims);
+  dense.set(Inf);
+  vector<int> lo,hi(n),index;
+  for(typename SparseArrayND<Real>::BlockMap::const_iterator b=distances.blocks.begin();b!=distances.blocks.end();b++) {
+    distances.blockStart(b->first,lo);
+    for(int i=0;i<n;i++)
+      hi[i] = Min(lo[i]+blockSize,distances.dims[i])-1;
+    index = lo;
+    do {
+      dense[index] = b->second[distances.offsetInBlock(index)];
+    } while(!IncrementIndex(index,lo,hi));
+  }
+}
+
+bool FIMSearch(const vector<int>& start,const vector<int>& goal,const ArrayND<Real>& costs,ArrayND<Real>& distances,int numThreads)
+{
+  assert(start.size() == costs.dims.size());
+  SparseArrayND<Real> sparse;
+  FIMSolver solver(sparse);
+  solver.denseCosts = &costs;
+  solver.numThreads = numThreads;
+  solver.Setup(costs.dims);
+  solver.Seed(start,0);
+  vector<vector<int> > goalCells;
+  if(goal.size()==start.size()) goalCells.push_back(goal);
+  solver.Solve(goalCells);
+#if DO_TIMING
+  printf("%d block updates in %d rounds\n",solver.numBlockUpdates,solver.numRounds);
+#endif //DO_TIMING
+  solver.GetDense(distances);
+  return solver.Reached(goalCells);
+}
+
+//shared by the FIMSearch variants with continuous start and goal
+static bool FIMSearch(FIMSolver& solver,const Vector& start,const Vector& goal)
+{
+  vector<vector<int> > scells, gcells;
+  CoordinatesToGridPoints(start,solver.distances.dims,scells);
+  CoordinatesToGridPoints(goal,solver.distances.dims,gcells);
+  for(size_t i=0;i<scells.size();i++)
+    solver.Seed(scells[i],Distance(start,scells[i]));
+  solver.Solve(gcells);
+#if DO_TIMING
+  printf("%d block updates in %d rounds\n",solver.numBlockUpdates,solver.numRounds);
+#endif //DO_TIMING
+  if(solver.memoryLimitReached)
+    printf("FIMSearch: Warning, memory limit reached, some of the grid was not searched\n");
+  return solver.Reached(gcells);
+}
+
+bool FIMSearch(const Vector& start,const Vector& goal,const ArrayND<Real>& costs,ArrayND<Real>& distances,int numThreads)
+{
+  assert(start.size() == (int)costs.dims.size());
+  SparseArrayND<Real> sparse;
+  FIMSolver solver(sparse);
+  solver.denseCosts = &costs;
+  solver.numThreads = numThreads;
+  solver.Setup(costs.dims);
+  bool res = FIMSearch(solver,start,goal);
+  solver.GetDense(distances);
+  return res;
+}
+
+//sets up the grid and normalizes the start and goal for the FIMSearch
+//variants with a cost function
+static void SetupCostFnSearch(FIMSolver& solver,const Vector& startorig,const Vector& goalorig,
+			      const Vector& bmin,const Vector& bmax,const Vector& res,
+			      Real (*costFn)(const Vector& coords),Vector& start,Vector& goal)
+{
+  assert(startorig.size() == res.size());
+  assert(startorig.size() == bmin.size());
+  assert(startorig.size() == bmax.size());
+  vector<int> dims(res.size());
+  for(int i=0;i<res.n;i++) {
+    dims[i] = (int)Ceil((bmax[i]-bmin[i])/res[i]);
+    if(dims[i] == ((bmax[i]-bmin[i])/res[i])) //upper bound is identically an integer
+      dims[i] ++;
+  }
+  start.resize(startorig.n);
+  for(int i=0;i<start.n;i++)
+    start[i] = (startorig[i] - bmin[i])/res[i];
+  goal.resize(goalorig.n);
+  for(int i=0;i<goal.n;i++)
+    goal[i] = (goalorig[i] - bmin[i])/res[i];
+  solver.costFn = costFn;
+  solver.bmin = bmin;
+  solver.res = res;
+  solver.Setup(dims);
+}
+
+bool FIMSearch(const Vector& startorig,const Vector& goalorig,
+	       const Vector& bmin,const Vector& bmax,const Vector& res,
+	       Real (*costFn)(const Vector& coords),ArrayND<Real>& distances,
+	       int numThreads)
+{
+  SparseArrayND<Real> sparse;
+  FIMSolver solver(sparse);
+  solver.numThreads = numThreads;
+  Vector start,goal;
+  SetupCostFnSearch(solver,startorig,goalorig,bmin,bmax,res,costFn,start,goal);
+  bool result = FIMSearch(solver,start,goal);
+  solver.GetDense(distances);
+  return result;
+}
+
+bool FIMSearch(const Vector& startorig,const Vector& goalorig,
+	       const Vector& bmin,const Vector& bmax,const Vector& res,
+	       Real (*costFn)(const Vector& coords),SparseArrayND<Real>& distances,
+	       int numThreads,size_t memoryLimit,size_t* memoryUsage)
+{
+  FIMSolver solver(distances);
+  solver.numThreads = numThreads;
+  solver.memoryLimit = memoryLimit;
+  Vector start,goal;
+  SetupCostFnSearch(solver,startorig,goalorig,bmin,bmax,res,costFn,start,goal);
+  bool result = FIMSearch(solver,start,goal);
+  if(memoryUsage) *memoryUsage = solver.MemoryUsage();
+  return result;
+}
+
+
 
 
 
 /** Multilinear interpolation of an ND field.
 * Sensitive to Inf's in the field -- will ignore them
 */
-Real EvalMultilinear(const ArrayND<Real>& field,const Vector& point)
+template <class Field>
+Real EvalMultilinear(const Field& field,const Vector& point)
 {
   vector<int> low(point.size());
   Vector u(point.n);
@@ -846,7 +1326,8 @@ Real EvalMultilinear(const ArrayND<Real>& field,const Vector& point)
 #define INF_POS 1
 #define INF_NEG 2
 
-Vector FiniteDifference(const ArrayND<Real>& field,const Vector& x,vector<int>& infDirs)
+template <class Field>
+Vector FiniteDifference(const Field& field,const Vector& x,vector<int>& infDirs)
 {
   infDirs.resize(x.n);
   fill(infDirs.begin(),infDirs.end(),0);
@@ -883,7 +1364,8 @@ Vector FiniteDifference(const ArrayND<Real>& field,const Vector& x,vector<int>&
 }
 
 /** Gradient descent of an ND field */
-vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
+template <class Field>
+vector<Vector> GradientDescentT(const Field& field,const Vector& start)
 {
   Vector pt = start;
   vector<Vector> path;
@@ -974,6 +1456,16 @@ vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
 }
 
 
+vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start)
+{
+  return GradientDescentT(field,start);
+}
+
+vector<Vector> GradientDescent(const SparseArrayND<Real>& field,const Vector& start)
+{
+  return GradientDescentT(field,start);
+}
+
 /*
 
 struct GridFeature
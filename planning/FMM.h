@@ -2,6 +2,7 @@
 #define PLANNING_FMM_H
 
 #include <KrisLibrary/structs/arraynd.h>
+#include <KrisLibrary/structs/SparseArrayND.h>
 #include <KrisLibrary/math/vector.h>
 using namespace Math;
 
@@ -37,6 +38,54 @@ bool FMMSearch(const Vector& start,const Vector& goal,
 	       Real (*costFn) (const Vector& coords),
 	       ArrayND<Real>& distances);
 
+/** @brief An alternative to FMMSearch that solves the Eikonal equation with
+ * a block-parallel Fast Iterative Method.
+ *
+ * The grid is split into blocks that are relaxed with Gauss-Seidel sweeps,
+ * and blocks that do not share a face are relaxed concurrently by
+ * numThreads threads.  Unlike FMMSearch there is no priority queue over the
+ * whole grid, so this scales better to large grids and multiple cores, at
+ * the price of relaxing some cells more than once.  Cells are updated with
+ * the standard first-order upwind scheme, so for unit costs the result
+ * agrees closely with FMMSearch.  The result does not depend on numThreads.
+ *
+ * The arguments and outputs are the same as the corresponding FMMSearch.
+ */
+bool FIMSearch(const std::vector<int>& start,const std::vector<int>& goal,const ArrayND<Real>& costs,ArrayND<Real>& distances,int numThreads=1);
+
+/** @brief Block-parallel version of FMMSearch with continuous start and goal
+ * coordinates.  See the FIMSearch above.
+ */
+bool FIMSearch(const Vector& start,const Vector& goal,const ArrayND<Real>& costs,ArrayND<Real>& distances,int numThreads=1);
+
+/** @brief Block-parallel version of FMMSearch with a cost function.  See the
+ * FIMSearch above.
+ *
+ * costFn is evaluated lazily, a block at a time, the first time the block
+ * is reached.  If numThreads > 1 it is called from several threads at once,
+ * so it must be thread-safe.
+ */
+bool FIMSearch(const Vector& start,const Vector& goal,
+	       const Vector& bmin,const Vector& bmax,const Vector& res,
+	       Real (*costFn) (const Vector& coords),
+	       ArrayND<Real>& distances,int numThreads=1);
+
+/** @brief Block-parallel version of FMMSearch with a cost function and
+ * sparse output.
+ *
+ * Only the blocks of the grid reached by the front are allocated, so
+ * large high-dimensional domains can be searched when the front stays in
+ * a small region (e.g., with costFn returning Inf outside of an informed
+ * set).  If memoryLimit > 0, the search stops expanding into new blocks
+ * once about memoryLimit bytes are in use.  If memoryUsage is non-NULL, it
+ * is set to the number of bytes used by the search, which is also its peak.
+ */
+bool FIMSearch(const Vector& start,const Vector& goal,
+	       const Vector& bmin,const Vector& bmax,const Vector& res,
+	       Real (*costFn) (const Vector& coords),
+	       SparseArrayND<Real>& distances,int numThreads=1,
+	       size_t memoryLimit=0,size_t* memoryUsage=NULL);
+
 /** @brief Perform gradient descent on an ND field, starting from some coordinates.
  * Returns the path traced, ending at a local minimum.
  * 
@@ -47,4 +96,7 @@ bool FMMSearch(const Vector& start,const Vector& goal,
  */
 std::vector<Vector> GradientDescent(const ArrayND<Real>& field,const Vector& start);
 
+///Gradient descent on a sparse field, in which unallocated cells are Inf
+std::vector<Vector> GradientDescent(const SparseArrayND<Real>& field,const Vector& start);
+
 #endif
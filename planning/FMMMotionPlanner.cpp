@@ -4,19 +4,27 @@
 
 ///binding for fMM
 static CSpace* currentFMMSpace = NULL;
+///informed set for fMM: cells with d(start,x)+d(x,goal) >= bound are pruned
+static const Config* currentFMMStart = NULL;
+static const Config* currentFMMGoal = NULL;
+static Real currentFMMBound = Inf;
 Real FMMCost(const Vector& coords)
 {
   if(!currentFMMSpace) return 1;
+  if(!IsInf(currentFMMBound)) {
+    if(currentFMMSpace->Distance(*currentFMMStart,coords)+currentFMMSpace->Distance(coords,*currentFMMGoal) >= currentFMMBound)
+      return Inf;
+  }
   if(currentFMMSpace->IsFeasible(coords)) return 1;
   return Inf;
 }
 
 FMMMotionPlanner::FMMMotionPlanner(CSpace* _space)
-  :space(_space),dynamicDomain(true)
+  :space(_space),dynamicDomain(true),informed(true),euclidean(false),numThreads(1),sparse(false),memoryLimit(1<<30),gridMemory(0),peakGridMemory(0)
 {}
 
 FMMMotionPlanner::FMMMotionPlanner(CSpace* _space,const Vector& _bmin,const Vector& _bmax,int divs)
-  :space(_space),bmin(_bmin),bmax(_bmax),dynamicDomain(false)
+  :space(_space),bmin(_bmin),bmax(_bmax),dynamicDomain(false),informed(true),euclidean(false),numThreads(1),sparse(false),memoryLimit(1<<30),gridMemory(0),peakGridMemory(0)
 {
   resolution = bmax-bmin;
   resolution *= 1.0/divs;
@@ -27,8 +35,16 @@ void FMMMotionPlanner::Init(const Config& a,const Config& b)
   start = a;
   goal = b;
   distances.clear();
+  sparseDistances.clear();
+  gridMemory = peakGridMemory = 0;
   solution.edges.clear();
 
+  PropertyMap props;
+  space->Properties(props);
+  string metric;
+  vector<Real> weights;
+  euclidean = (props.get("metric",metric) && metric=="euclidean" && !props.getArray("metricWeights",weights));
+
   if(dynamicDomain) {
     Real d = space->Distance(a,b);
     bmin = a;
@@ -65,7 +81,7 @@ bool FreeLower(const ArrayND<Real>& distances,int axis)
   do {
     indexlo = index;
     indexlo[axis] = 0;
-    if(!IsInf(distances[index])) return true;
+    if(!IsInf(distances[indexlo])) return true;
   } while(!IncrementIndex(index,ranges));
   return false;
 }
@@ -79,11 +95,36 @@ bool FreeUpper(const ArrayND<Real>& distances,int axis)
   do {
     indexhi = index;
     indexhi[axis] = distances.dims[axis]-1;
-    if(!IsInf(distances[index])) return true;
+    if(!IsInf(distances[indexhi])) return true;
   } while(!IncrementIndex(index,ranges));
   return false;
 }
 
+//sparse version of FreeLower / FreeUpper: only allocated blocks can be free
+bool FreeFace(const SparseArrayND<Real>& distances,int axis,bool upper)
+{
+  int face = (upper ? distances.dims[axis]-1 : 0);
+  vector<int> lo,hi(distances.dims.size()),index;
+  for(SparseArrayND<Real>::BlockMap::const_iterator b=distances.blocks.begin();b!=distances.blocks.end();b++) {
+    distances.blockStart(b->first,lo);
+    if(face < lo[axis] || face >= lo[axis]+distances.blockSize) continue;
+    for(size_t i=0;i<lo.size();i++)
+      hi[i] = Min(lo[i]+distances.blockSize,distances.dims[i])-1;
+    lo[axis] = hi[axis] = face;
+    index = lo;
+    do {
+      if(!IsInf(b->second[distances.offsetInBlock(index)])) return true;
+    } while(!IncrementIndex(index,lo,hi));
+  }
+  return false;
+}
+
+size_t FMMMotionPlanner::GridSize() const
+{
+  if(sparse) return sparseDistances.numValues();
+  return distances.numValues();
+}
+
 Vector FMMMotionPlanner::ToGrid(const Vector& q) const
 {
   Vector res = q-bmin;
@@ -110,6 +151,32 @@ Vector FMMMotionPlanner::FromGrid(const vector<int>& cell) const
 }
 
 
+//bound on the cost of paths through the informed set of the solution
+static Real InformedBound(const MilestonePath& solution,const Vector& resolution)
+{
+  //allow for the discretization of the grid path
+  return solution.Length() + resolution.norm();
+}
+
+bool FMMMotionPlanner::ShrinkToInformedSet()
+{
+  if(solution.edges.empty() || !euclidean) return false;
+  Real c = InformedBound(solution,resolution);
+  Real cmin = start.distance(goal);
+  if(cmin <= 0) return false;
+  //axis-aligned bounding box of the ellipsoid with foci start and goal,
+  //major axis c and minor axes sqrt(c^2-cmin^2)
+  Real r1 = c*Half, r2 = Sqrt(Max(c*c-cmin*cmin,Zero))*Half;
+  for(int i=0;i<start.n;i++) {
+    Real u = (goal[i]-start[i])/cmin;
+    Real h = Sqrt(Sqr(r1*u) + Sqr(r2)*(One-u*u));
+    Real center = (start[i]+goal[i])*Half;
+    bmin[i] = Max(bmin[i],center-h-resolution[i]);
+    bmax[i] = Min(bmax[i],center+h+resolution[i]);
+  }
+  return true;
+}
+
 bool FMMMotionPlanner::SolveFMM()
 {
   Assert(start.n == goal.n);
@@ -117,15 +184,17 @@ bool FMMMotionPlanner::SolveFMM()
   Assert(start.n == bmax.n);
   Assert(start.n == resolution.n);
 
-  if(dynamicDomain && distances.numValues() > 0) {
+  bool shrunk = (informed && ShrinkToInformedSet());
+  //the informed set's box already contains all improving paths
+  if(dynamicDomain && !shrunk && GridSize() > 0) {
     //check distances, if there are any non-inf along an edge then that edge should be expanded
-    for(size_t i=0;i<distances.dims.size();i++) {
+    for(int i=0;i<start.n;i++) {
       Real w=(bmax[i]-bmin[i]);
-      if(FreeLower(distances,i)) {
+      if(sparse ? FreeFace(sparseDistances,i,false) : FreeLower(distances,i)) {
 	bmin[i] -= w*0.25;
 	printf("Decreasing bottom domain %d by %g\n",i,w*0.25);
       }
-      if(FreeUpper(distances,i)) {
+      if(sparse ? FreeFace(sparseDistances,i,true) : FreeUpper(distances,i)) {
 	bmax[i] += w*0.25;
 	printf("Increasing top domain %d by %g\n",i,w*0.25);
       }
@@ -133,11 +202,33 @@ bool FMMMotionPlanner::SolveFMM()
   }
 
   currentFMMSpace = space;
-  if(!FMMSearch(start,goal,bmin,bmax,resolution,FMMCost,distances)) {
+  currentFMMStart = &start;
+  currentFMMGoal = &goal;
+  currentFMMBound = ((informed && !solution.edges.empty()) ? InformedBound(solution,resolution) : Inf);
+  bool res;
+  if(sparse) {
+    distances.clear();
+    res = FIMSearch(start,goal,bmin,bmax,resolution,FMMCost,sparseDistances,Max(numThreads,1),memoryLimit,&gridMemory);
+  }
+  else {
+    if(numThreads > 1)
+      res = FIMSearch(start,goal,bmin,bmax,resolution,FMMCost,distances,numThreads);
+    else
+      res = FMMSearch(start,goal,bmin,bmax,resolution,FMMCost,distances);
+    //distances, status, and priority queue arrays
+    gridMemory = distances.numValues()*(2*sizeof(Real)+3*sizeof(int));
+  }
+  peakGridMemory = Max(peakGridMemory,gridMemory);
+  currentFMMBound = Inf;
+  if(!res) {
     printf("FMM search failed\n");
     return false;
   }
-  vector<Vector> pts = GradientDescent(distances,ToGrid(goal));
+  vector<Vector> pts;
+  if(sparse)
+    pts = GradientDescent(sparseDistances,ToGrid(goal));
+  else
+    pts = GradientDescent(distances,ToGrid(goal));
   reverse(pts.begin(),pts.end());
   //convert these grid-space coordinates to configuration space coordinates
   for(size_t i=0;i<pts.size();i++) {
@@ -25,13 +25,42 @@ class FMMMotionPlanner
   Vector ToGrid(const Vector& q) const;
   Vector FromGrid(const Vector& q) const;
   Vector FromGrid(const vector<int>& pt) const;
+  ///Number of grid cells stored by the last search
+  size_t GridSize() const;
+
+  ///Helper: once a solution is known, shrinks the domain to the bounding
+  ///box of the solution's informed set.  Returns false if there is no
+  ///solution or the space is not Euclidean.
+  bool ShrinkToInformedSet();
 
   CSpace* space;
   Vector bmin,bmax;
   bool dynamicDomain;
+  ///If true (default), once a solution of cost c is found, later searches
+  ///are restricted to the informed set: cells x with
+  ///d(start,x)+d(x,goal) > c (plus one cell diagonal) are treated as
+  ///obstacles, and in Euclidean spaces the grid is shrunk to the set's
+  ///bounding box.  This bounds the grid size as the resolution is refined.
+  bool informed;
+  ///Set in Init: true if the informed bounding box can be used
+  bool euclidean;
+  ///If > 1, the grid is solved with the block-parallel FIMSearch using
+  ///this many threads, rather than FMMSearch (default 1).  The space's
+  ///IsFeasible must then be thread-safe.
+  int numThreads;
+  ///If true, the grid is solved with the sparse FIMSearch into
+  ///sparseDistances, so memory is only used for the blocks of the grid the
+  ///front reaches.  The search uses at most memoryLimit bytes (default
+  ///1GB, 0 for no limit).  Default false.
+  bool sparse;
+  size_t memoryLimit;
   Vector resolution;
   Config start,goal;
   ArrayND<Real> distances;
+  SparseArrayND<Real> sparseDistances;
+  ///Approximate memory used by the last search and the largest over all
+  ///searches since Init, in bytes
+  size_t gridMemory,peakGridMemory;
   MilestonePath solution;
   //debug: a path that failed the secondary feasibility check
   MilestonePath failedCheck;
@@ -4,7 +4,7 @@
 #include <vector>
 #include <map>
 #include <KrisLibrary/utils/stl_tr1.h>
-#include <KrisLibrary/structs/IndexedPriorityQueue.h>
+#include <KrisLibrary/structs/FixedSizeHeap.h>
 
 namespace AI {
 
@@ -29,6 +29,16 @@ namespace AI {
  *
  * ints, floats, and doubles are fine for the cost class, but you can also
  * implement more sophisticated costs, such as multi-objective costs.
+ *
+ * Nodes are allocated from a pool owned by the search, in chunks that are
+ * reused by later calls to SetStart(), so node pointers are only valid until
+ * the next SetStart() or the destruction of the search.  The fringe is an
+ * indexed binary heap over node indices, so reducing a node's cost updates
+ * its existing fringe entry rather than leaving a stale one behind.
+ *
+ * For states that map to a dense range of integers, e.g., grid cells,
+ * GeneralizedAStarWithArray avoids the lookup cost of the map-based
+ * visited tests.
  */
 template <class S,class C>
 struct GeneralizedAStar
@@ -36,8 +46,7 @@ struct GeneralizedAStar
   //a node in the tree
   struct Node
   {
-    Node():parent(NULL) {}
-    ~Node() { for(size_t i=0;i<children.size();i++) delete children[i]; }
+    Node():parent(NULL),index(0) {}
 
     ///cost from start
     C g;
@@ -49,11 +58,24 @@ struct GeneralizedAStar
     Node* parent;
     ///list of pointers to children
     std::vector<Node*> children;
+    ///index of the node in the pool, 0 for the root
+    int index;
+  };
+
+  ///Fringe priority: a node with lower f, or equal f and greater g, has
+  ///higher priority
+  struct Priority
+  {
+    Priority() {}
+    Priority(const C& _f,const C& _g):f(_f),g(_g) {}
+    bool operator < (const Priority& p) const { return p.f < f || (!(f < p.f) && g < p.g); }
+    bool operator > (const Priority& p) const { return p < *this; }
+    C f,g;
   };
 
   GeneralizedAStar();
   GeneralizedAStar(const S& start);
-  virtual ~GeneralizedAStar() {}
+  virtual ~GeneralizedAStar();
   /// Resets the search from the given start state
   void SetStart(const S& start);
   /// Performs search until a goal is reached
@@ -70,6 +92,17 @@ struct GeneralizedAStar
   int NumDescendents(const Node& n) const;
   /// Returns the priority of the next node to be expanded
   C TopPriority() const;
+  /// Returns the node with the given index (0 is the root)
+  inline Node* GetNode(int index) {
+    if(index == 0) return &root;
+    return &nodeChunks[(index-1)/NodeChunkSize][(index-1)%NodeChunkSize];
+  }
+  inline const Node* GetNode(int index) const {
+    if(index == 0) return &root;
+    return &nodeChunks[(index-1)/NodeChunkSize][(index-1)%NodeChunkSize];
+  }
+  /// Returns an unused node from the pool
+  Node* NewNode();
 
   /// Returns true if the goal has been found
   inline bool GoalFound() const { return !path.empty(); }
@@ -77,7 +110,7 @@ struct GeneralizedAStar
   /// testGoalOnGeneration=false
   inline C GoalCost() const { if(goal != NULL) return goal->g; return zero; }
   /// Returns path of states to the goal
-  inline const vector<S>& GoalPath() const { return path; }
+  inline const std::vector<S>& GoalPath() const { return path; }
 
   ///The following must be overloaded by the subclass
   virtual bool IsGoal(const S& s) =0;
@@ -104,13 +137,18 @@ struct GeneralizedAStar
   ///The A* search tree
   Node root;
 
-  ///The A* search fringe.  Requires a pair for the key value,
-  ///because if two items have the same f value, then the one with the
-  ///greatest g is picked
-  IndexedPriorityQueue<Node*,std::pair<C,C> > fringe;
+  ///The A* search fringe, indexed by node index.  Requires a pair for the
+  ///key value, because if two items have the same f value, then the one
+  ///with the greatest g is picked
+  FixedSizeHeap<Priority> fringe;
+  ///Node pool, allocated in chunks of NodeChunkSize nodes.  Node i>0 is
+  ///stored at nodeChunks[(i-1)/NodeChunkSize][(i-1)%NodeChunkSize].
+  enum { NodeChunkSize = 1024 };
+  std::vector<Node*> nodeChunks;
   ///Temporary variables -- slightly reduces the number of memory allocations
   std::vector<S> successors;
   std::vector<C> costs;
+  ///Number of nodes in use, including the root
   int numNodes;
 
   ///Upon successful termination, goal contains the goal node
@@ -175,6 +213,23 @@ class GeneralizedAStarWithHashMap : public GeneralizedAStar<S,C>
   }
 };
 
+///Convenience class: stores visited nodes in an array, for states that map
+///to integers 0,...,N-1, e.g., grid cells or graph vertices.  The subclass
+///must overload StateIndex(), and call SetNumStates() before SetStart().
+template <class S,class C>
+class GeneralizedAStarWithArray : public GeneralizedAStar<S,C>
+{
+ public:
+  typedef struct GeneralizedAStar<S,C>::Node Node;
+  std::vector<Node*> visited;
+  virtual ~GeneralizedAStarWithArray() {}
+  virtual int StateIndex(const S& s) =0;
+  void SetNumStates(int n) { visited.resize(n,NULL); }
+  virtual void ClearVisited() { std::fill(visited.begin(),visited.end(),(Node*)NULL); }
+  virtual void Visit(const S& s,Node* n) { visited[StateIndex(s)]=n; }
+  virtual Node* VisitedStateNode(const S& s) { return visited[StateIndex(s)]; }
+};
+
 
 template <class S,class C>
 GeneralizedAStar<S,C>::GeneralizedAStar()
@@ -189,6 +244,29 @@ GeneralizedAStar<S,C>::GeneralizedAStar(const S& start)
   SetStart(start);
 }
 
+template <class S,class C>
+GeneralizedAStar<S,C>::~GeneralizedAStar()
+{
+  for(size_t i=0;i<nodeChunks.size();i++)
+    delete [] nodeChunks[i];
+}
+
+template <class S,class C>
+typename GeneralizedAStar<S,C>::Node* GeneralizedAStar<S,C>::NewNode()
+{
+  int index = numNodes;
+  if(index > (int)nodeChunks.size()*NodeChunkSize)
+    nodeChunks.push_back(new Node[NodeChunkSize]);
+  if(index >= fringe.maxObjects())
+    fringe.increaseCapacity(2*index);
+  numNodes++;
+  Node* n = GetNode(index);
+  n->index = index;
+  n->parent = NULL;
+  n->children.resize(0);
+  return n;
+}
+
 template <class S,class C>
 void GeneralizedAStar<S,C>::SetStart(const S& start)
 {  
@@ -210,10 +288,10 @@ void GeneralizedAStar<S,C>::SetStart(const S& start)
   root.f=Heuristic(start);
   root.data = start;
   root.parent = NULL;
-  for(size_t i=0;i<root.children.size();i++)
-    delete root.children[i];
-  root.children.clear();
-  fringe.insert(&root,std::pair<C,C>(root.f,-root.g));
+  root.index = 0;
+  root.children.resize(0);
+  if(fringe.maxObjects() == 0) fringe.init(NodeChunkSize);
+  fringe.push(0,Priority(root.f,root.g));
   Visit(start,&root);
 }
 
@@ -232,7 +310,7 @@ bool GeneralizedAStar<S,C>::SearchStep()
 {
   if(fringe.empty()) return false;
 
-  Node* n = fringe.top().second;
+  Node* n = GetNode(fringe.top());
   fringe.pop();
 
   //give the subclass optional feedback
@@ -295,21 +373,21 @@ bool GeneralizedAStar<S,C>::SearchStep()
 	visited->g = n->g + costs[i];
 	visited->f = visited->g + Heuristic(successors[i]);
 	visited->parent = n;
-	fringe.refresh(visited,std::pair<C,C>(visited->f,-visited->g));
+	//if visited was already expanded, this puts it back on the fringe
+	fringe.adjust(visited->index,Priority(visited->f,visited->g));
       }
     }
     else {
       //add successors[i] to the child list
-      numNodes ++;
-      n->children.push_back(new Node);
-      Node* child = n->children.back();
+      Node* child = NewNode();
+      n->children.push_back(child);
       child->data = successors[i];
       child->parent = n;
       child->g = n->g + costs[i];
       child->f = child->g + Heuristic(successors[i]);
 
       //add successors[i] to the fringe and mark as visited
-      fringe.insert(child,std::pair<C,C>(child->f,-child->g));
+      fringe.push(child->index,Priority(child->f,child->g));
       Visit(successors[i],child);
     }
   }
@@ -348,7 +426,7 @@ template <class S,class C>
 C GeneralizedAStar<S,C>::TopPriority() const
 {
   if(fringe.empty()) return zero;
-  return fringe.top().first.first;
+  return GetNode(fringe.top())->f;
 }
 
 } //namespace AI
@@ -6,6 +6,7 @@
 #include <utils/arrayutils.h>
 #include <GLdraw/drawextra.h>
 #include "EdgePlanner.h"
+#include <string.h>
 using namespace GLDraw;
 
 void Geometric2DCollection::Clear()
@@ -619,6 +620,7 @@ bool Geometric2DCSpace::IsFeasible(const Config& x)
 {
   Vector2 p(x(0),x(1));
   if(!domain.contains(p)) return false;
+  if(obstacleGrid.Matches(*this)) return !obstacleGrid.Collides(p);
   return !Geometric2DCollection::Collides(p);
 }
 
@@ -705,3 +707,322 @@ void Geometric2DCSpace::Properties(PropertyMap& map) const
   map.setArray("minimum",bmin);
   map.setArray("maximum",bmax);
 }
+
+
+
+//the grid is capped at this many cells along each axis
+const static int kMaxCellsPerAxis = 1024;
+//bounding boxes are rejected this many slots at a time
+const static int kBlockSize = 32;
+
+static void GetPrimitiveBounds(const Geometric2DCollection& geom,vector<AABB2D>& bbs)
+{
+  bbs.resize(0);
+  bbs.reserve(geom.NumObstacles());
+  //same order as Geometric2DCollection::ObstacleType
+  for(size_t i=0;i<geom.aabbs.size();i++)
+    bbs.push_back(geom.aabbs[i]);
+  AABB2D bb;
+  for(size_t i=0;i<geom.boxes.size();i++) {
+    geom.boxes[i].getAABB(bb);
+    bbs.push_back(bb);
+  }
+  for(size_t i=0;i<geom.triangles.size();i++) {
+    geom.triangles[i].getAABB(bb);
+    bbs.push_back(bb);
+  }
+  for(size_t i=0;i<geom.circles.size();i++) {
+    geom.circles[i].getAABB(bb);
+    bbs.push_back(bb);
+  }
+}
+
+void Geometric2DCollectionGrid::GetBounds(const Geometric2DCollection& geom,AABB2D& bb)
+{
+  bb.minimize();
+  AABB2D temp;
+  for(size_t i=0;i<geom.aabbs.size();i++)
+    bb.setUnion(geom.aabbs[i]);
+  for(size_t i=0;i<geom.boxes.size();i++) {
+    geom.boxes[i].getAABB(temp);
+    bb.setUnion(temp);
+  }
+  for(size_t i=0;i<geom.triangles.size();i++) {
+    geom.triangles[i].getAABB(temp);
+    bb.setUnion(temp);
+  }
+  for(size_t i=0;i<geom.circles.size();i++) {
+    geom.circles[i].getAABB(temp);
+    bb.setUnion(temp);
+  }
+}
+
+Geometric2DCollectionGrid::Geometric2DCollectionGrid()
+  :numPrimitives(-1),cellSize(0),nx(0),ny(0),firstCircle(0)
+{}
+
+void Geometric2DCollectionGrid::Clear()
+{
+  geometry.Clear();
+  numPrimitives = -1;
+  cellSize = 0;
+  nx = ny = 0;
+  cellStart.resize(0);
+  slotPrimitive.resize(0);
+  slotMinX.resize(0);
+  slotMinY.resize(0);
+  slotMaxX.resize(0);
+  slotMaxY.resize(0);
+  circleX.resize(0);
+  circleY.resize(0);
+  circleR.resize(0);
+}
+
+//the primitives hold only Reals, so equal data means equal bytes
+template <class T>
+static bool SamePrimitives(const vector<T>& a,const vector<T>& b)
+{
+  if(a.size() != b.size()) return false;
+  if(a.empty()) return true;
+  return memcmp(&a[0],&b[0],a.size()*sizeof(T)) == 0;
+}
+
+bool Geometric2DCollectionGrid::Matches(const Geometric2DCollection& geom) const
+{
+  if(numPrimitives != geom.NumObstacles()) return false;
+  return SamePrimitives(geometry.aabbs,geom.aabbs) &&
+    SamePrimitives(geometry.boxes,geom.boxes) &&
+    SamePrimitives(geometry.circles,geom.circles) &&
+    SamePrimitives(geometry.triangles,geom.triangles);
+}
+
+int Geometric2DCollectionGrid::CellX(Real x) const
+{
+  int i = (int)Floor((x-bounds.bmin.x)/cellSize);
+  if(i < 0) return 0;
+  if(i >= nx) return nx-1;
+  return i;
+}
+
+int Geometric2DCollectionGrid::CellY(Real y) const
+{
+  int j = (int)Floor((y-bounds.bmin.y)/cellSize);
+  if(j < 0) return 0;
+  if(j >= ny) return ny-1;
+  return j;
+}
+
+void Geometric2DCollectionGrid::Build(const Geometric2DCollection& geom,Real _cellSize)
+{
+  Clear();
+  geometry = geom;
+  numPrimitives = geom.NumObstacles();
+  firstCircle = numPrimitives - (int)geom.circles.size();
+  circleX.resize(geom.circles.size());
+  circleY.resize(geom.circles.size());
+  circleR.resize(geom.circles.size());
+  for(size_t i=0;i<geom.circles.size();i++) {
+    circleX[i] = geom.circles[i].center.x;
+    circleY[i] = geom.circles[i].center.y;
+    circleR[i] = geom.circles[i].radius;
+  }
+  if(numPrimitives == 0) return;
+
+  vector<AABB2D> bbs;
+  GetPrimitiveBounds(geom,bbs);
+  bounds.minimize();
+  Real sizeSum = 0;
+  for(size_t i=0;i<bbs.size();i++) {
+    bounds.setUnion(bbs[i]);
+    sizeSum += Max(bbs[i].bmax.x-bbs[i].bmin.x,bbs[i].bmax.y-bbs[i].bmin.y);
+  }
+  Real w = bounds.bmax.x-bounds.bmin.x;
+  Real h = bounds.bmax.y-bounds.bmin.y;
+  cellSize = _cellSize;
+  if(cellSize <= 0) cellSize = 2.0*sizeSum/bbs.size();
+  cellSize = Max(cellSize,Max(w,h)/kMaxCellsPerAxis);
+  if(cellSize <= 0) cellSize = 1;
+  nx = Max(1,Min(kMaxCellsPerAxis,(int)Ceil(w/cellSize)));
+  ny = Max(1,Min(kMaxCellsPerAxis,(int)Ceil(h/cellSize)));
+
+  //count, then fill the slots of each cell
+  cellStart.assign(nx*ny+1,0);
+  for(size_t k=0;k<bbs.size();k++) {
+    int i0=CellX(bbs[k].bmin.x),i1=CellX(bbs[k].bmax.x);
+    int j0=CellY(bbs[k].bmin.y),j1=CellY(bbs[k].bmax.y);
+    for(int j=j0;j<=j1;j++)
+      for(int i=i0;i<=i1;i++)
+        cellStart[i+j*nx+1]++;
+  }
+  for(int c=0;c<nx*ny;c++)
+    cellStart[c+1] += cellStart[c];
+  int numSlots = cellStart.back();
+  slotPrimitive.resize(numSlots);
+  slotMinX.resize(numSlots);
+  slotMinY.resize(numSlots);
+  slotMaxX.resize(numSlots);
+  slotMaxY.resize(numSlots);
+  vector<int> fill(cellStart.begin(),cellStart.end()-1);
+  for(size_t k=0;k<bbs.size();k++) {
+    int i0=CellX(bbs[k].bmin.x),i1=CellX(bbs[k].bmax.x);
+    int j0=CellY(bbs[k].bmin.y),j1=CellY(bbs[k].bmax.y);
+    for(int j=j0;j<=j1;j++)
+      for(int i=i0;i<=i1;i++) {
+        int s = fill[i+j*nx]++;
+        slotPrimitive[s] = (int)k;
+        slotMinX[s] = bbs[k].bmin.x;
+        slotMinY[s] = bbs[k].bmin.y;
+        slotMaxX[s] = bbs[k].bmax.x;
+        slotMaxY[s] = bbs[k].bmax.y;
+      }
+  }
+}
+
+//Calls test(k) on each primitive k whose bounds overlap bb, once per
+//primitive, until it returns true
+template <class Test>
+static bool Scan(const Geometric2DCollectionGrid& grid,const AABB2D& bb,Test& test)
+{
+  if(grid.numPrimitives <= 0) return false;
+  if(!grid.bounds.intersects(bb)) return false;
+  int i0=grid.CellX(bb.bmin.x),i1=grid.CellX(bb.bmax.x);
+  int j0=grid.CellY(bb.bmin.y),j1=grid.CellY(bb.bmax.y);
+  bool multiCell = (i0 != i1 || j0 != j1);
+  const Real* minx = &grid.slotMinX[0];
+  const Real* miny = &grid.slotMinY[0];
+  const Real* maxx = &grid.slotMaxX[0];
+  const Real* maxy = &grid.slotMaxY[0];
+  unsigned char hit[kBlockSize];
+  for(int j=j0;j<=j1;j++) {
+    for(int i=i0;i<=i1;i++) {
+      int c = i+j*grid.nx;
+      int end = grid.cellStart[c+1];
+      for(int b=grid.cellStart[c];b<end;b+=kBlockSize) {
+        int m = Min(kBlockSize,end-b);
+        for(int k=0;k<m;k++)
+          hit[k] = (minx[b+k] <= bb.bmax.x) & (maxx[b+k] >= bb.bmin.x) & (miny[b+k] <= bb.bmax.y) & (maxy[b+k] >= bb.bmin.y);
+        for(int k=0;k<m;k++) {
+          if(!hit[k]) continue;
+          if(multiCell) {
+            //a primitive may be in several of the visited cells; only test
+            //it in the one holding the lower corner of the boxes' overlap
+            if(grid.CellX(Max(minx[b+k],bb.bmin.x)) != i) continue;
+            if(grid.CellY(Max(miny[b+k],bb.bmin.y)) != j) continue;
+          }
+          if(test(grid.slotPrimitive[b+k])) return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+struct PointTest
+{
+  const Geometric2DCollectionGrid* grid;
+  Vector2 p;
+  bool operator () (int k) const {
+    if(k >= grid->firstCircle) {
+      int c = k-grid->firstCircle;
+      return Sqr(p.x-grid->circleX[c])+Sqr(p.y-grid->circleY[c]) <= Sqr(grid->circleR[c]);
+    }
+    return grid->geometry.Collides(p,k);
+  }
+};
+
+struct CircleTest
+{
+  const Geometric2DCollectionGrid* grid;
+  Circle2D circle;
+  bool operator () (int k) const {
+    if(k >= grid->firstCircle) {
+      int c = k-grid->firstCircle;
+      Real r = grid->circleR[c]+circle.radius;
+      return r >= 0 && Sqr(circle.center.x-grid->circleX[c])+Sqr(circle.center.y-grid->circleY[c]) <= Sqr(r);
+    }
+    return grid->geometry.Collides(circle,k);
+  }
+};
+
+struct BoxTest
+{
+  const Geometric2DCollectionGrid* grid;
+  const Box2D* box;
+  bool operator () (int k) const { return grid->geometry.Collides(*box,k); }
+};
+
+struct TriangleTest
+{
+  const Geometric2DCollectionGrid* grid;
+  const Triangle2D* tri;
+  bool operator () (int k) const { return grid->geometry.Collides(*tri,k); }
+};
+
+struct ListTest
+{
+  vector<int>* primitives;
+  bool operator () (int k) const { primitives->push_back(k); return false; }
+};
+
+bool Geometric2DCollectionGrid::Collides(const Vector2& p) const
+{
+  AABB2D bb;
+  bb.bmin = bb.bmax = p;
+  PointTest test;
+  test.grid = this;
+  test.p = p;
+  return Scan(*this,bb,test);
+}
+
+bool Geometric2DCollectionGrid::Collides(const Circle2D& circle) const
+{
+  AABB2D bb;
+  circle.getAABB(bb);
+  CircleTest test;
+  test.grid = this;
+  test.circle = circle;
+  return Scan(*this,bb,test);
+}
+
+bool Geometric2DCollectionGrid::Collides(const Box2D& box) const
+{
+  AABB2D bb;
+  box.getAABB(bb);
+  BoxTest test;
+  test.grid = this;
+  test.box = &box;
+  return Scan(*this,bb,test);
+}
+
+bool Geometric2DCollectionGrid::Collides(const Triangle2D& tri) const
+{
+  AABB2D bb;
+  tri.getAABB(bb);
+  TriangleTest test;
+  test.grid = this;
+  test.tri = &tri;
+  return Scan(*this,bb,test);
+}
+
+bool Geometric2DCollectionGrid::Collides(const Geometric2DCollection& geom) const
+{
+  for(size_t i=0;i<geom.aabbs.size();i++) {
+    Box2D box; box.set(geom.aabbs[i]);
+    if(Collides(box)) return true;
+  }
+  for(size_t i=0;i<geom.boxes.size();i++)
+    if(Collides(geom.boxes[i])) return true;
+  for(size_t i=0;i<geom.circles.size();i++)
+    if(Collides(geom.circles[i])) return true;
+  for(size_t i=0;i<geom.triangles.size();i++)
+    if(Collides(geom.triangles[i])) return true;
+  return false;
+}
+
+void Geometric2DCollectionGrid::Query(const AABB2D& bb,vector<int>& primitives) const
+{
+  primitives.resize(0);
+  ListTest test;
+  test.primitives = &primitives;
+  Scan(*this,bb,test);
+}
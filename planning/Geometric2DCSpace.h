@@ -62,6 +62,67 @@ class Geometric2DCollection
   vector<Triangle2D> triangles;
 };
 
+/** @brief A static Geometric2DCollection packed for fast collision queries.
+ *
+ * The primitives are binned into a uniform grid over their bounding box, so
+ * a query only visits the primitives near it.  Each cell stores its
+ * primitives' indices and bounding boxes in separate coordinate arrays,
+ * and the bounding boxes are rejected a block at a time with a branch-free
+ * loop that the compiler can vectorize.  Circles are also packed as
+ * center/radius arrays and tested inline against points and circles.  All
+ * other exact tests are the ones of Geometric2DCollection, so the results
+ * match it exactly.
+ *
+ * Primitives are indexed as in Geometric2DCollection::ObstacleType(), and
+ * the grid holds its own copy of the collection.  Matches() compares that
+ * copy with a collection, so a grid that is stale because primitives were
+ * added, removed, moved, or resized is detected, and the spaces that use
+ * the grid fall back to the exact checks until it is rebuilt.  Queries do
+ * not modify the grid and are thread-safe.
+ */
+class Geometric2DCollectionGrid
+{
+ public:
+  Geometric2DCollectionGrid();
+  ///Packs geom and bins it.  If cellSize <= 0, the cells are about twice
+  ///the average primitive size.
+  void Build(const Geometric2DCollection& geom,Real cellSize=0);
+  void Clear();
+  ///Returns true if the grid was built from a collection with the same
+  ///primitives as geom.  Takes time linear in the number of primitives,
+  ///but is much cheaper than checking against all of them.
+  bool Matches(const Geometric2DCollection& geom) const;
+
+  bool Collides(const Vector2& p) const;
+  bool Collides(const Circle2D& circle) const;
+  bool Collides(const Box2D& box) const;
+  bool Collides(const Triangle2D& tri) const;
+  bool Collides(const Geometric2DCollection& geom) const;
+  ///Returns the primitives whose bounding boxes overlap bb
+  void Query(const AABB2D& bb,std::vector<int>& primitives) const;
+
+  ///Helper: the bounding box of all of geom's primitives
+  static void GetBounds(const Geometric2DCollection& geom,AABB2D& bb);
+
+  int CellX(Real x) const;
+  int CellY(Real y) const;
+
+  Geometric2DCollection geometry;
+  ///-1 if not built
+  int numPrimitives;
+  AABB2D bounds;
+  Real cellSize;
+  int nx,ny;
+  ///The slots of cell (i,j) are cellStart[c] to cellStart[c+1]-1, with
+  ///c=i+j*nx
+  std::vector<int> cellStart;
+  std::vector<int> slotPrimitive;
+  std::vector<Real> slotMinX,slotMinY,slotMaxX,slotMaxY;
+  ///Index of the first circle primitive
+  int firstCircle;
+  std::vector<Real> circleX,circleY,circleR;
+};
+
 /** @brief a 2D cspace whose obstacles are geometric primitives.
  *
  * The C-space obstacles are explicitly given as aabbs, boxes, triangles,
@@ -72,6 +133,9 @@ class Geometric2DCSpace : public ExplicitCSpace, public Geometric2DCollection
 public:
   Geometric2DCSpace();
   void DrawGL() const;
+  ///Builds obstacleGrid, which IsFeasible(x) then uses.  Call again after
+  ///changing the obstacles; until then IsFeasible(x) uses the exact checks.
+  void BuildObstacleGrid(Real cellSize=0) { obstacleGrid.Build(*this,cellSize); }
 
   Real ObstacleDistance(const Vector2& x) const;
   Real ObstacleDistance(const Circle2D& circle) const;
@@ -96,6 +160,7 @@ public:
   bool euclideanSpace;
   Real visibilityEpsilon;
   AABB2D domain;
+  Geometric2DCollectionGrid obstacleGrid;
 };
 
 #endif
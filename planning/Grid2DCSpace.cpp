@@ -4,6 +4,84 @@
 #include <meshing/Rasterize.h>
 #include <GLdraw/GL.h>
 #include "EdgePlanner.h"
+#include "GeneralizedAStar.h"
+#include <Timer.h>
+#include <stdio.h>
+using namespace AI;
+
+//A* over the cells of an occupancy grid.  States are cell indices i*n+j.
+//Base determines how visited cells are stored.
+template <class Base>
+struct GridAStar : public Base
+{
+  const Array2D<bool>& occupied;
+  int goal;
+
+  GridAStar(const Array2D<bool>& _occupied,const IntPair& _goal)
+    :occupied(_occupied),goal(_goal.a*_occupied.n+_goal.b)
+  {
+    this->zero = 0.0;
+  }
+  virtual int StateIndex(const int& s) { return s; }
+  virtual bool IsGoal(const int& s) { return s == goal; }
+  virtual void Successors(const int& s,std::vector<int>& successors,std::vector<double>& costs)
+  {
+    int i=s/occupied.n, j=s%occupied.n;
+    for(int di=-1;di<=1;di++) {
+      int ni=i+di;
+      if(ni < 0 || ni >= occupied.m) continue;
+      for(int dj=-1;dj<=1;dj++) {
+        int nj=j+dj;
+        if((di==0 && dj==0) || nj < 0 || nj >= occupied.n) continue;
+        if(occupied(ni,nj)) continue;
+        if(di != 0 && dj != 0) {
+          if(occupied(i,nj) || occupied(ni,j)) continue;
+          costs.push_back(Sqrt2);
+        }
+        else
+          costs.push_back(1.0);
+        successors.push_back(ni*occupied.n+nj);
+      }
+    }
+  }
+  //octile distance
+  virtual double Heuristic(const int& s)
+  {
+    int di=s/occupied.n-goal/occupied.n, dj=s%occupied.n-goal%occupied.n;
+    if(di < 0) di=-di;
+    if(dj < 0) dj=-dj;
+    return double(Max(di,dj)) + (Sqrt2-1.0)*double(Min(di,dj));
+  }
+};
+
+struct ArrayGridAStar : public GridAStar<GeneralizedAStarWithArray<int,double> >
+{
+  ArrayGridAStar(const Array2D<bool>& occupied,const IntPair& goal)
+    :GridAStar<GeneralizedAStarWithArray<int,double> >(occupied,goal)
+  {
+    SetNumStates(occupied.m*occupied.n);
+  }
+};
+
+static bool IsFreeCell(const Array2D<bool>& occupied,const IntPair& c)
+{
+  if(c.a < 0 || c.a >= occupied.m || c.b < 0 || c.b >= occupied.n) return false;
+  return !occupied(c.a,c.b);
+}
+
+template <class Search>
+bool RunGridAStar(Search& search,const Array2D<bool>& occupied,const IntPair& start,std::vector<IntPair>& path)
+{
+  path.resize(0);
+  if(!IsFreeCell(occupied,start)) return false;
+  search.SetStart(start.a*occupied.n+start.b);
+  if(!search.Search()) return false;
+  const std::vector<int>& cells = search.GoalPath();
+  path.resize(cells.size());
+  for(size_t k=0;k<cells.size();k++)
+    path[k].set(cells[k]/occupied.n,cells[k]%occupied.n);
+  return true;
+}
 
 Grid2DCSpace::Grid2DCSpace(int m,int n)
 {
@@ -153,3 +231,38 @@ Real Grid2DCSpace::Distance(const Config& x, const Config& y)
   if(euclideanSpace) return Distance_L2(x,y);
   else return Distance_LInf(x,y);
 }
+
+bool Grid2DCSpace::ShortestPath(const IntPair& start,const IntPair& goal,std::vector<IntPair>& path)
+{
+  path.resize(0);
+  if(!IsFreeCell(occupied,goal)) return false;
+  ArrayGridAStar search(occupied,goal);
+  return RunGridAStar(search,occupied,start,path);
+}
+
+template <class Search>
+void TimeGridAStar(const char* name,Search& search,const Array2D<bool>& occupied,const IntPair& start,int numTrials)
+{
+  std::vector<IntPair> path;
+  bool res = false;
+  Timer timer;
+  for(int i=0;i<numTrials;i++)
+    res = RunGridAStar(search,occupied,start,path);
+  Real t = timer.ElapsedTime()/numTrials;
+  printf("  %-10s %s, cost %g, %d expanded, %d nodes, %g ms per search\n",name,(res?"solved":"no path"),(res?search.GoalCost():0.0),search.NumExpanded(),search.NumNodes(),t*1000.0);
+}
+
+void Grid2DCSpace::BenchmarkShortestPath(const IntPair& start,const IntPair& goal,int numTrials)
+{
+  if(!IsFreeCell(occupied,start) || !IsFreeCell(occupied,goal)) {
+    fprintf(stderr,"Grid2DCSpace::BenchmarkShortestPath: start or goal is not a free cell\n");
+    return;
+  }
+  printf("A* on %d x %d grid, %d trials:\n",occupied.m,occupied.n,numTrials);
+  GridAStar<GeneralizedAStarWithMap<int,double> > mapSearch(occupied,goal);
+  TimeGridAStar("map",mapSearch,occupied,start,numTrials);
+  GridAStar<GeneralizedAStarWithHashMap<int,double> > hashSearch(occupied,goal);
+  TimeGridAStar("hash map",hashSearch,occupied,start,numTrials);
+  ArrayGridAStar arraySearch(occupied,goal);
+  TimeGridAStar("array",arraySearch,occupied,start,numTrials);
+}
@@ -6,6 +6,8 @@
 #include <KrisLibrary/math3d/Triangle2D.h>
 #include <KrisLibrary/math3d/AABB2D.h>
 #include <KrisLibrary/structs/array2d.h>
+#include <KrisLibrary/utils/IntPair.h>
+#include <vector>
 using namespace Math3D;
 
 class Grid2DCSpace : public CSpace
@@ -27,6 +29,14 @@ public:
   virtual EdgePlanner* LocalPlanner(const Config& a,const Config& b);
   virtual Real Distance(const Config& x, const Config& y);
 
+  ///Finds a shortest 8-connected path of free cells from start to goal with
+  ///A*.  Diagonal moves may not cut the corners of occupied cells.
+  ///Returns false if no path exists.
+  bool ShortestPath(const IntPair& start,const IntPair& goal,std::vector<IntPair>& path);
+  ///Times numTrials runs of the A* grid search of ShortestPath with
+  ///std::map, hash map, and array visited sets, and prints the results
+  void BenchmarkShortestPath(const IntPair& start,const IntPair& goal,int numTrials=10);
+
   bool euclideanSpace;
   AABB2D domain;
   Array2D<bool> occupied;
@@ -1,5 +1,4 @@
 #include "KinodynamicCSpace.h"
-#include <math/diffeq.h>
 #include <math/random.h>
 #include <Timer.h>
 using namespace std;
@@ -223,47 +222,68 @@ IntegratedKinodynamicCSpace::IntegratedKinodynamicCSpace(Integrator _type)
   :type(_type)
 {}
 
-//hooks for the math library integrators
-struct IntegrationFunction : public DiffEqFunction
+//Takes one integration step of size h from x to xnext.  k1,...,k4 and
+//temp are scratch space, passed in so that they are only allocated once
+//per simulation.  x and xnext must be different vectors.
+static void IntegrationStep(IntegratedKinodynamicCSpace* space,const State& x,const ControlInput& u,Real h,State& xnext,
+			    Vector& k1,Vector& k2,Vector& k3,Vector& k4,Vector& temp)
 {
-  IntegrationFunction(IntegratedKinodynamicCSpace* _space,const ControlInput& _u)
-    :space(_space),u(_u)
-  {}
-
-  virtual void Eval(Real t,const Vector& y,Vector& dy) {
-    space->XDerivative(y,u,dy);
+  switch(space->type) {
+  case IntegratedKinodynamicCSpace::Euler:
+    space->XDerivative(x,u,k1);
+    xnext = x;
+    xnext.madd(k1,h);
+    break;
+  case IntegratedKinodynamicCSpace::RK4:
+    space->XDerivative(x,u,k1);
+    temp = x;
+    temp.madd(k1,h*Half);
+    space->XDerivative(temp,u,k2);
+    temp = x;
+    temp.madd(k2,h*Half);
+    space->XDerivative(temp,u,k3);
+    temp = x;
+    temp.madd(k3,h);
+    space->XDerivative(temp,u,k4);
+    xnext = x;
+    xnext.madd(k1,h/6.0);
+    xnext.madd(k2,h/3.0);
+    xnext.madd(k3,h/3.0);
+    xnext.madd(k4,h/6.0);
+    break;
+  default:
+    FatalError("Unknown integrator type!");
+    break;
   }
-
-  IntegratedKinodynamicCSpace* space;
-  const ControlInput& u;
-};
+}
 
 void IntegratedKinodynamicCSpace::Simulate(const State& x0, const ControlInput& u,vector<State>& p)
 {
-  IntegrationFunction func(this,u);
   Real dt,h;
-  int i,numSteps;
+  int numSteps;
   Parameters(x0,u,dt,numSteps);
   h = dt/numSteps;
-  State temp;
-  p.push_back(x0);
-  switch(type) {
-  case Euler:
-    for(i=0;i<numSteps;i++) {
-      Euler_step(&func,0,h,p.back(),temp);
-      p.push_back(temp);
-    }
-    break;
-  case RK4:
-    for(i=0;i<numSteps;i++) {
-      RungeKutta4_step(&func,0,h,p.back(),temp);
-      p.push_back(temp);
-    }
-    break;
-  default:
-    FatalError("Unknown integrator type!");
-    break;
+  //entries of p are assigned in place, so a reused trace is not reallocated
+  p.resize(numSteps+1);
+  p[0] = x0;
+  Vector k1,k2,k3,k4,temp;
+  for(int i=0;i<numSteps;i++)
+    IntegrationStep(this,p[i],u,h,p[i+1],k1,k2,k3,k4,temp);
+}
+
+void IntegratedKinodynamicCSpace::SimulateEndpoint(const State& x0, const ControlInput& u,State& x1)
+{
+  Real dt,h;
+  int numSteps;
+  Parameters(x0,u,dt,numSteps);
+  h = dt/numSteps;
+  Vector k1,k2,k3,k4,temp;
+  State x = x0;
+  for(int i=0;i<numSteps;i++) {
+    IntegrationStep(this,x,u,h,x1,k1,k2,k3,k4,temp);
+    if(i+1 < numSteps) x = x1;
   }
+  if(numSteps <= 0) x1 = x0;
 }
 
 
@@ -338,3 +358,10 @@ void KinematicCSpaceAdaptor::SampleReverseControl(const State& x,ControlInput& u
 void KinematicCSpaceAdaptor::BiasedSampleReverseControl(const State& x1,const State& xDest,ControlInput& u) { BiasedSampleControl(x1,xDest,u); }
 
 void KinematicCSpaceAdaptor::Properties(PropertyMap& map) const { base->Properties(map); map.set("dynamic",1); }
+
+KinodynamicCSpace* KinematicCSpaceAdaptor::Clone()
+{
+  KinematicCSpaceAdaptor* res = new KinematicCSpaceAdaptor(base);
+  res->maxNeighborhoodRadius = maxNeighborhoodRadius;
+  return res;
+}
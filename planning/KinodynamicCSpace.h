@@ -87,7 +87,10 @@ public:
   virtual EdgePlanner* LocalPlanner(const Config& a,const Config& b) { FatalError("Visibility not checked using LocalPlanner for kinodynamic planning"); return NULL; }
 
   ///Executes the simulation function f(x0,u) and records its trace in p.
-  ///The trace is a vector containing all intermediate states.
+  ///The trace is a vector containing all intermediate states.  Any prior
+  ///contents of p are replaced; implementations should assign to p's
+  ///existing entries so that a trace buffer reused between calls is not
+  ///reallocated.
   virtual void Simulate(const State& x0, const ControlInput& u,std::vector<State>& p)=0;
 
   ///Executes the simulation function x1 = f(x0,u)
@@ -144,6 +147,14 @@ public:
   ///are chosen uniformly at random, and the best one is picked
   void ChoiceBiasedSampleReverseControl(const State& x1,const State& xDest,ControlInput& u,int numSamples);
 
+  ///Returns a copy of this space for use from another thread, or NULL if
+  ///copying is not supported (the default).  The copy must be safe to use
+  ///concurrently with this space and any other copies.  It may share
+  ///read-only data, such as obstacle geometry, with this space.  The caller
+  ///owns the copy.  Used by KinodynamicPropagator to simulate controls in
+  ///parallel.
+  virtual KinodynamicCSpace* Clone() { return NULL; }
+
   ///If the trajectory from x0 controlled by u is feasible, sets x1 to
   ///the end state and returns true.
   ///(implementation calls Simulate() and  TrajectoryChecker()->IsVisible())
@@ -171,6 +182,8 @@ class IntegratedKinodynamicCSpace : public KinodynamicCSpace
 
   IntegratedKinodynamicCSpace(Integrator type=Euler);
   virtual void Simulate(const State& x0, const ControlInput& u,std::vector<State>& p);
+  ///Integrates without recording the trace
+  virtual void SimulateEndpoint(const State& x0, const ControlInput& u,State& x1);
 
   //subclasses must override the following:
 
@@ -220,6 +233,9 @@ class KinematicCSpaceAdaptor : public KinodynamicCSpace
   virtual void SampleReverseControl(const State& x,ControlInput& u);
   virtual void BiasedSampleReverseControl(const State& x1,const State& xDest,ControlInput& u);
   virtual void Properties(PropertyMap& map) const;
+  ///The copy shares the base space, so the base space's methods must be
+  ///safe to call concurrently
+  virtual KinodynamicCSpace* Clone();
 
   CSpace* base;
   Real maxNeighborhoodRadius;
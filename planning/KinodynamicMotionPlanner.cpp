@@ -4,6 +4,7 @@
 #include <errors.h>
 #include <utils/EZTrace.h>
 #include <math/random.h>
+#include <utils/threadutils.h>
 using namespace std;
 
 typedef KinodynamicTree::Node Node;
@@ -60,7 +61,7 @@ struct VectorizeCallback : public Node::Callback
 
 
 KinodynamicTree::KinodynamicTree(KinodynamicCSpace* s)
-  :space(s),root(NULL),Nreach(0)
+  :Nreach(0),space(s),root(NULL),propagator(NULL)
 {
 }
 
@@ -93,6 +94,15 @@ void KinodynamicTree::AddReachableSet(Node* milestone)
   if(Nreach<=0) return;
 
   milestone->edgeFromParent().reach.clear();
+  milestone->edgeFromParent().ureach.clear();
+  if(propagator) {
+    propagator->SampleAndPropagate(*milestone,*milestone,(int)Nreach,false,KinodynamicPropagator::NoCheck);
+    for(int i=0;i<propagator->numCandidates;i++) {
+      milestone->edgeFromParent().reach.push_back(propagator->candidates[i].path.back());
+      milestone->edgeFromParent().ureach.push_back(propagator->candidates[i].u);
+    }
+    return;
+  }
   //uint Nreach = milestone->edgeFromParent().Nreach;
   for(uint i = 0; i < Nreach; i++){
     State xreach;
@@ -290,8 +300,124 @@ void KinodynamicTree::DeleteSubTree(Node* n)
 
 
 
+KinodynamicPropagator::KinodynamicPropagator(KinodynamicCSpace* s)
+  :space(s),numThreads(1),numCandidates(0),cloneFailed(false),numBatches(0),numSimulations(0)
+{}
+
+KinodynamicPropagator::~KinodynamicPropagator()
+{
+  //the edge planners may refer to the clones
+  candidates.clear();
+  for(size_t i=0;i<clones.size();i++)
+    delete clones[i];
+}
+
+void KinodynamicPropagator::SampleAndPropagate(const State& x,const State& xDest,int numControls,bool reverse,CheckLevel check)
+{
+  numCandidates = numControls;
+  if((int)candidates.size() < numCandidates)
+    candidates.resize(numCandidates);
+  for(int i=0;i<numCandidates;i++) {
+    if(reverse) space->SampleReverseControl(x,candidates[i].u);
+    else space->SampleControl(x,candidates[i].u);
+  }
+  Propagate(x,xDest,reverse,check);
+}
+
+static void PropagateCandidate(KinodynamicCSpace* space,const State& x,const State& xDest,bool reverse,int check,KinodynamicPropagator::Candidate& c)
+{
+  c.feasible = false;
+  c.distance = Inf;
+  c.e = NULL;
+  if(reverse) {
+    if(!space->ReverseSimulate(x,c.u,c.path) || c.path.empty()) return;
+  }
+  else
+    space->Simulate(x,c.u,c.path);
+  const State& xend = (reverse ? c.path.front() : c.path.back());
+  c.distance = space->Distance(xend,xDest);
+  if(check != KinodynamicPropagator::NoCheck) {
+    if(!space->IsFeasible(xend)) return;
+    if(check == KinodynamicPropagator::CheckTrajectory) {
+      c.e = space->TrajectoryChecker(c.path);
+      if(!c.e->IsVisible()) {
+        c.e = NULL;
+        return;
+      }
+    }
+  }
+  c.feasible = true;
+}
+
+struct PropagateThreadData
+{
+  KinodynamicCSpace* space;
+  KinodynamicPropagator* propagator;
+  const State* x;
+  const State* xDest;
+  bool reverse;
+  int check;
+  int index,stride;
+};
+
+static void* PropagateThreadFunc(void* vdata)
+{
+  PropagateThreadData* data = (PropagateThreadData*)vdata;
+  for(int i=data->index;i<data->propagator->numCandidates;i+=data->stride)
+    PropagateCandidate(data->space,*data->x,*data->xDest,data->reverse,data->check,data->propagator->candidates[i]);
+  return NULL;
+}
+
+void KinodynamicPropagator::Propagate(const State& x,const State& xDest,bool reverse,CheckLevel check)
+{
+  Assert(numCandidates <= (int)candidates.size());
+  int numWorkers = Max(Min(numThreads,numCandidates),1);
+  while(!cloneFailed && (int)clones.size()+1 < numWorkers) {
+    KinodynamicCSpace* clone = space->Clone();
+    if(!clone) {
+      fprintf(stderr,"KinodynamicPropagator: the space can't be cloned, simulating on one thread\n");
+      cloneFailed = true;
+    }
+    else clones.push_back(clone);
+  }
+  numWorkers = Min(numWorkers,(int)clones.size()+1);
+
+  vector<PropagateThreadData> data(numWorkers);
+  vector<Thread> threads;
+  threads.reserve(numWorkers);
+  for(int w=0;w<numWorkers;w++) {
+    data[w].space = (w == 0 ? space : clones[w-1]);
+    data[w].propagator = this;
+    data[w].x = &x;
+    data[w].xDest = &xDest;
+    data[w].reverse = reverse;
+    data[w].check = check;
+    data[w].index = w;
+    data[w].stride = numWorkers;
+    if(w > 0) threads.push_back(ThreadStart(PropagateThreadFunc,&data[w]));
+  }
+  PropagateThreadFunc(&data[0]);
+  for(size_t i=0;i<threads.size();i++)
+    ThreadJoin(threads[i]);
+  numBatches++;
+  numSimulations += numCandidates;
+}
+
+int KinodynamicPropagator::Best() const
+{
+  int best = -1;
+  for(int i=0;i<numCandidates;i++)
+    if(candidates[i].feasible && (best < 0 || candidates[i].distance < candidates[best].distance))
+      best = i;
+  return best;
+}
+
+
+
+
+
 RRTKinodynamicPlanner::RRTKinodynamicPlanner(KinodynamicCSpace* s)
-  :space(s),goalSeekProbability(0.1),goalSet(NULL),tree(s),goalNode(NULL)
+  :space(s),goalSeekProbability(0.1),goalSet(NULL),numControlSamples(0),propagator(s),tree(s),goalNode(NULL)
 {}
 
 Node* RRTKinodynamicPlanner::Plan(int maxIters)
@@ -355,6 +481,13 @@ Node* RRTKinodynamicPlanner::ExtendToward(const State& xdest)
   //std::cout << "[RRT] Extend towards "<< xdest << std::endl;
   Node* n=tree.FindClosest(xdest);
   if(!n) return NULL;
+  if(numControlSamples > 0) {
+    propagator.SampleAndPropagate(*n,xdest,numControlSamples);
+    int best = propagator.Best();
+    if(best < 0) return NULL;
+    const KinodynamicPropagator::Candidate& c = propagator.candidates[best];
+    return tree.AddMilestone(n,c.u,c.path,c.e);
+  }
   ControlInput u;
   if(DEBUG) std::cout << std::string(80, '-') << std::endl;
   if(DEBUG) std::cout << "[RRT] Extend towards "<< xdest << std::endl;
@@ -435,6 +568,15 @@ Node* LazyRRTKinodynamicPlanner::ExtendToward(const State& xdest)
   EZCallTrace tr("LazyRRTKinodynamicPlanner::Extend()");
   //Node* n=tree.FindClosest(xdest);
   Node* n=tree.ApproximateRandomClosest(xdest,10);
+  if(numControlSamples > 0) {
+    //the trajectory is checked later, in CheckPath
+    propagator.SampleAndPropagate(*n,xdest,numControlSamples,false,KinodynamicPropagator::CheckEndpoint);
+    int best = propagator.Best();
+    if(best < 0) return NULL;
+    const KinodynamicPropagator::Candidate& c = propagator.candidates[best];
+    EdgePlanner* e=space->TrajectoryChecker(c.path);
+    return tree.AddMilestone(n,c.u,c.path,e);
+  }
   ControlInput u;
   PickControl(*n,xdest,u);
   Assert(space->IsValidControl(*n,u));
@@ -490,7 +632,7 @@ bool LazyRRTKinodynamicPlanner::CheckPath(Node* n)
 
 
 BidirectionalRRTKP::BidirectionalRRTKP(KinodynamicCSpace* s)
-  :space(s),start(s),goal(s),connectionTolerance(1.0)
+  :space(s),numControlSamples(0),propagator(s),start(s),goal(s),connectionTolerance(1.0)
 {
   bridge.nStart=NULL;
   bridge.nGoal=NULL;
@@ -547,6 +689,13 @@ Node* BidirectionalRRTKP::ExtendStart()
   State xdest;
   space->Sample(xdest);
   Node* n=start.FindClosest(xdest);
+  if(numControlSamples > 0) {
+    propagator.SampleAndPropagate(*n,xdest,numControlSamples);
+    int best = propagator.Best();
+    if(best < 0) return NULL;
+    const KinodynamicPropagator::Candidate& c = propagator.candidates[best];
+    return start.AddMilestone(n,c.u,c.path,c.e);
+  }
   ControlInput u;
   PickControl(*n,xdest,u);
   Assert(space->IsValidControl(*n,u));
@@ -569,6 +718,13 @@ Node* BidirectionalRRTKP::ExtendGoal()
   State xdest;
   space->Sample(xdest);
   Node* n=goal.FindClosest(xdest);
+  if(numControlSamples > 0) {
+    propagator.SampleAndPropagate(*n,xdest,numControlSamples,true);
+    int best = propagator.Best();
+    if(best < 0) return NULL;
+    const KinodynamicPropagator::Candidate& c = propagator.candidates[best];
+    return goal.AddMilestone(n,c.u,c.path,c.e);
+  }
   ControlInput u;
   PickReverseControl(*n,xdest,u);
   Assert(space->IsValidReverseControl(*n,u));
@@ -667,9 +823,10 @@ bool UnidirectionalRRTKP::Plan(int maxIters)
 }
 
 RGRRT::RGRRT(KinodynamicCSpace* s, uint Nreach)
-  :space(s),goalSeekProbability(0.1),tree(s),goalNode(NULL)
+  :space(s),goalSeekProbability(0.1),goalSet(NULL),propagator(s),tree(s),goalNode(NULL)
 {
   tree.EnableReachableSet(Nreach);
+  tree.propagator = &propagator;
 }
 
 
@@ -8,6 +8,8 @@
 typedef Vector State;
 typedef Vector ControlInput;
 
+class KinodynamicPropagator;
+
 /** @brief Data structure for a kinodynamic planning tree.
  *
  * The planning tree has nodes that are states and edges that store
@@ -17,6 +19,9 @@ typedef Vector ControlInput;
  * This data can be retrieved using x2->getEdgeFromParent().
  *
  * Potential improvement can speed up point location using Kd trees.
+ *
+ * If propagator is set, the reachable sets are simulated with it in
+ * one batch per milestone.
  */
 class KinodynamicTree
 {
@@ -52,6 +57,79 @@ public:
   KinodynamicCSpace* space;
   Node* root;
   std::vector<Node*> index;
+  ///If not NULL, used to simulate the reachable set (default NULL)
+  KinodynamicPropagator* propagator;
+};
+
+/** @brief Samples and simulates batches of candidate controls from a
+ * state, optionally in parallel threads.
+ *
+ * SampleAndPropagate() draws numControls controls from the space's
+ * SampleControl() (or SampleReverseControl()), simulates each one, and
+ * computes the distance from the end of its trace to a destination state.
+ * Depending on the check level, it also tests the feasibility of the end
+ * state and of the whole trace.  Best() returns the candidate closest to
+ * the destination that passed the checks, i.e., a best-of-k control
+ * choice like KinodynamicCSpace::ChoiceBiasedSampleControl().
+ *
+ * With numThreads > 1 the candidates are split between threads.  Each
+ * thread uses its own copy of the space from KinodynamicCSpace::Clone(), so
+ * the space's copies must be safe to use concurrently.  If the space
+ * can't be cloned, all candidates are processed on the calling thread.
+ * Controls are always sampled on the calling thread, so the result for a
+ * given seed doesn't depend on thread timing.  Threads are started for
+ * each batch, so parallelism only pays off when simulating and checking a
+ * batch takes much longer than starting a thread (tens of microseconds).
+ *
+ * The candidates' control and trace buffers are kept between batches, so
+ * spaces whose Simulate() assigns to the trace in place, e.g.,
+ * IntegratedKinodynamicCSpace, don't allocate states on every step.
+ *
+ * When the trace is checked, the candidate's edge planner is created by the
+ * space copy that checked it.  Copies are kept until the propagator is
+ * destroyed, so the propagator must outlive any tree holding these edge
+ * planners.
+ */
+class KinodynamicPropagator
+{
+public:
+  enum CheckLevel { NoCheck, CheckEndpoint, CheckTrajectory };
+  struct Candidate
+  {
+    ControlInput u;
+    std::vector<State> path;
+    ///Distance from the end of the trace (the start, if reverse) to the
+    ///destination
+    Real distance;
+    ///True if the candidate passed the checks
+    bool feasible;
+    ///The trajectory checker, if checked with CheckTrajectory
+    SmartPointer<EdgePlanner> e;
+  };
+
+  KinodynamicPropagator(KinodynamicCSpace* space);
+  ~KinodynamicPropagator();
+  ///Samples numControls controls from x and simulates them.  If reverse is
+  ///true, the controls are reverse controls ending at x.
+  void SampleAndPropagate(const State& x,const State& xDest,int numControls,bool reverse=false,CheckLevel check=CheckTrajectory);
+  ///Simulates the controls of candidates 0,...,numCandidates-1 from x
+  void Propagate(const State& x,const State& xDest,bool reverse=false,CheckLevel check=CheckTrajectory);
+  ///Returns the index of the feasible candidate closest to the destination,
+  ///or -1 if none is feasible
+  int Best() const;
+
+  KinodynamicCSpace* space;
+  ///Number of threads (default 1)
+  int numThreads;
+  ///Candidate buffers.  Only the first numCandidates are in use; the rest
+  ///are kept for reuse.
+  std::vector<Candidate> candidates;
+  int numCandidates;
+  ///Copies of space used by threads 1,2,...
+  std::vector<KinodynamicCSpace*> clones;
+  bool cloneFailed;
+  ///Statistics
+  int numBatches,numSimulations;
 };
 
 
@@ -78,6 +156,12 @@ public:
   KinodynamicCSpace* space;
   Real goalSeekProbability;
   CSpace* goalSet;
+  ///If > 0, each extension simulates this many random controls as a batch
+  ///with propagator and keeps the feasible one that gets closest to the
+  ///destination, instead of calling PickControl() (default 0)
+  int numControlSamples;
+  ///Set propagator.numThreads to simulate the batch in parallel
+  KinodynamicPropagator propagator;
   KinodynamicTree tree;
 
   //temporary output
@@ -121,6 +205,12 @@ public:
   virtual void PickReverseControl(const State& x1, const State& xDest, ControlInput& u);
 
   KinodynamicCSpace* space;
+  ///If > 0, each extension simulates this many random controls as a batch
+  ///with propagator and keeps the feasible one that gets closest to the
+  ///destination, instead of calling PickControl() or PickReverseControl()
+  ///(default 0)
+  int numControlSamples;
+  KinodynamicPropagator propagator;
   KinodynamicTree start,goal;
   Real connectionTolerance;
 
@@ -171,6 +261,9 @@ public:
   KinodynamicCSpace* space;
   Real goalSeekProbability;
   CSpace* goalSet;
+  ///Simulates the reachable set of each new milestone.  Set
+  ///propagator.numThreads to simulate it in parallel.
+  KinodynamicPropagator propagator;
   KinodynamicTree tree;
 
   //temporary output
@@ -0,0 +1,52 @@
+#include "LazyEdgeChecker.h"
+using namespace std;
+
+LazyEdgeChecker::LazyEdgeChecker()
+  :failed(-1),numSteps(0),numEdgesChecked(0)
+{}
+
+void LazyEdgeChecker::Clear()
+{
+  while(!q.empty()) q.pop();
+  queued.clear();
+}
+
+void LazyEdgeChecker::Add(const SmartPointer<EdgePlanner>& e,int id)
+{
+  if(!queued.insert((const EdgePlanner*)e).second) return;
+  Item item;
+  item.id = id;
+  item.e = e;
+  //finished edges go first, so a known collision is reported without
+  //refining anything else
+  if(e->Done()) item.priority = Inf;
+  else item.priority = e->Priority();
+  q.push(item);
+}
+
+bool LazyEdgeChecker::Check()
+{
+  completed.resize(0);
+  failed = -1;
+  while(!q.empty()) {
+    Item item = q.top(); q.pop();
+    if(!item.e->Done()) {
+      item.e->Plan();
+      numSteps++;
+    }
+    if(item.e->Done() || item.e->Failed()) {
+      numEdgesChecked++;
+      if(item.e->Failed()) {
+        failed = item.id;
+        Clear();
+        return false;
+      }
+      completed.push_back(item.id);
+      continue;
+    }
+    item.priority = item.e->Priority();
+    q.push(item);
+  }
+  queued.clear();
+  return true;
+}
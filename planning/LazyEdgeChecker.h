@@ -0,0 +1,64 @@
+#ifndef LAZY_EDGE_CHECKER_H
+#define LAZY_EDGE_CHECKER_H
+
+#include "EdgePlanner.h"
+#include <KrisLibrary/utils/SmartPointer.h>
+#include <vector>
+#include <queue>
+#include <set>
+
+/** @ingroup MotionPlanning
+ * @brief Checks the unchecked edges of one or more candidate paths
+ * together, refining the longest unchecked span among all of them first.
+ *
+ * The edges must be incremental planners (Priority(), Plan(), Done(), and
+ * Failed()), such as StraightLineEpsilonPlanner or
+ * BisectionEpsilonEdgePlanner, where Priority() is the length of the
+ * longest segment that has not been checked.  These keep their checked
+ * resolution between calls, so an edge that was partly checked for a
+ * candidate path that failed somewhere else resumes where it stopped when
+ * it is queued again for a later candidate.
+ *
+ * Usage:
+ *   checker.Add(e1,id1);
+ *   ...
+ *   checker.Add(en,idn);
+ *   if(checker.Check()) //all edges are feasible
+ *   else //checker.failed is the id of the edge in collision
+ *
+ * Check() stops at the first collision.  In either case the ids of the
+ * edges that were found feasible are listed in completed, in the order
+ * they were finished.
+ */
+class LazyEdgeChecker
+{
+public:
+  LazyEdgeChecker();
+  ///Empties the queue
+  void Clear();
+  ///Queues an edge under the caller's identifier id.  An edge that is
+  ///already queued is ignored.
+  void Add(const SmartPointer<EdgePlanner>& e,int id);
+  ///Refines the queued edges until they are all done or one fails, and
+  ///empties the queue.  Returns true if all queued edges are feasible.
+  bool Check();
+
+  struct Item
+  {
+    bool operator < (const Item& rhs) const { return priority < rhs.priority; }
+    Real priority;
+    int id;
+    SmartPointer<EdgePlanner> e;
+  };
+  std::priority_queue<Item> q;
+  std::set<const EdgePlanner*> queued;
+
+  ///Results of the last call to Check()
+  std::vector<int> completed;
+  int failed;
+
+  ///Statistics: number of refinement steps and edges finished
+  int numSteps,numEdgesChecked;
+};
+
+#endif
@@ -3,7 +3,9 @@
 #include <math/random.h>
 #include <structs/FixedSizeHeap.h>
 #include <structs/Heap.h>
+#include <structs/IndexedPriorityQueue.h>
 #include <graph/Path.h>
+#include <utils/unionfind.h>
 #include <Timer.h>
 #include <algorithm>
 using namespace AI;
@@ -44,11 +46,152 @@ Subset Violations(ExplicitCSpace* space,const Config& a,const Config& b)
   return Subset(vis);
 }
 
+MCRLabelCache::MCRLabelCache()
+  :numObstacles(0),obstaclesRemoved(false),numConfigChecks(0),numEdgeChecks(0)
+{}
+
+void MCRLabelCache::Clear(int _numObstacles)
+{
+  numObstacles = _numObstacles;
+  changed.assign(numObstacles,false);
+  obstaclesRemoved = false;
+  nodeLabels.resize(0);
+  edges.resize(0);
+}
+
+void MCRLabelCache::SetNode(int i,const Subset& violations)
+{
+  if(i >= (int)nodeLabels.size()) nodeLabels.resize(i+1);
+  nodeLabels[i].assign(numObstacles,false);
+  for(size_t k=0;k<violations.items.size();k++)
+    nodeLabels[i][violations.items[k]] = true;
+}
+
+void MCRLabelCache::AddEdge(int a,int b,const Subset& violations)
+{
+  edges.resize(edges.size()+1);
+  EdgeLabel& e = edges.back();
+  e.a = a;
+  e.b = b;
+  e.checked = true;
+  e.violations.assign(numObstacles,false);
+  for(size_t k=0;k<violations.items.size();k++)
+    e.violations[violations.items[k]] = true;
+}
+
+void MCRLabelCache::AddEdge(int a,int b)
+{
+  edges.resize(edges.size()+1);
+  EdgeLabel& e = edges.back();
+  e.a = a;
+  e.b = b;
+  e.checked = false;
+  e.violations.assign(numObstacles,false);
+}
+
+void MCRLabelCache::MoveNode(int from,int to)
+{
+  if(to >= (int)nodeLabels.size()) nodeLabels.resize(to+1);
+  nodeLabels[to].swap(nodeLabels[from]);
+  nodeLabels[from].assign(numObstacles,false);
+  for(size_t i=0;i<edges.size();i++) {
+    if(edges[i].a == from) edges[i].a = to;
+    if(edges[i].b == from) edges[i].b = to;
+  }
+}
+
+void MCRLabelCache::ObstacleChanged(int k)
+{
+  assert(k >= 0 && k < numObstacles);
+  changed[k] = true;
+}
+
+void MCRLabelCache::ObstacleAdded()
+{
+  numObstacles++;
+  changed.push_back(true);
+  for(size_t i=0;i<nodeLabels.size();i++)
+    nodeLabels[i].push_back(false);
+  for(size_t i=0;i<edges.size();i++)
+    edges[i].violations.push_back(false);
+}
+
+void MCRLabelCache::ObstacleRemoved(int k)
+{
+  assert(k >= 0 && k < numObstacles);
+  numObstacles--;
+  changed.erase(changed.begin()+k);
+  obstaclesRemoved = true;
+  for(size_t i=0;i<nodeLabels.size();i++)
+    nodeLabels[i].erase(nodeLabels[i].begin()+k);
+  for(size_t i=0;i<edges.size();i++)
+    edges[i].violations.erase(edges[i].violations.begin()+k);
+}
+
+void MCRLabelCache::Update(ExplicitCSpace* space,const vector<const Config*>& qs)
+{
+  assert(space->NumObstacles() == numObstacles);
+  assert(qs.size() == nodeLabels.size());
+  vector<int> dirty;
+  for(int k=0;k<numObstacles;k++)
+    if(changed[k]) dirty.push_back(k);
+  if(!dirty.empty()) {
+    for(size_t i=0;i<nodeLabels.size();i++) {
+      for(size_t k=0;k<dirty.size();k++)
+	nodeLabels[i][dirty[k]] = !space->IsFeasible(*qs[i],dirty[k]);
+    }
+    numConfigChecks += (int)(nodeLabels.size()*dirty.size());
+  }
+  for(size_t i=0;i<edges.size();i++) {
+    EdgeLabel& e = edges[i];
+    const Config& a = *qs[e.a];
+    const Config& b = *qs[e.b];
+    if(!e.checked) {
+      for(int k=0;k<numObstacles;k++) {
+	EdgePlanner* ep=space->LocalPlanner(a,b,k);
+	e.violations[k] = !ep->IsVisible();
+	delete ep;
+      }
+      numEdgeChecks += numObstacles;
+      e.checked = true;
+    }
+    else {
+      for(size_t k=0;k<dirty.size();k++) {
+	EdgePlanner* ep=space->LocalPlanner(a,b,dirty[k]);
+	e.violations[dirty[k]] = !ep->IsVisible();
+	delete ep;
+      }
+      numEdgeChecks += (int)dirty.size();
+    }
+  }
+  changed.assign(numObstacles,false);
+  obstaclesRemoved = false;
+}
+
+bool MCRLabelCache::NeedsUpdate() const
+{
+  if(obstaclesRemoved) return true;
+  for(int k=0;k<numObstacles;k++)
+    if(changed[k]) return true;
+  for(size_t i=0;i<edges.size();i++)
+    if(!edges[i].checked) return true;
+  return false;
+}
+
+bool MCRLabelCache::Consistent(const EdgeLabel& e) const
+{
+  const vector<bool>& la = nodeLabels[e.a];
+  const vector<bool>& lb = nodeLabels[e.b];
+  for(int k=0;k<numObstacles;k++)
+    if(e.violations[k] && !la[k] && !lb[k]) return false;
+  return true;
+}
+
 
 
 
 MCRPlanner::MCRPlanner(ExplicitCSpace* _space)
-  :space(_space),
+  :space(_space),incremental(false),maxReuseMilestones(0),
    updatePathsComplete(false),updatePathsDynamic(true),updatePathsMax(INT_MAX),
    numExpands(0),numRefinementAttempts(0),numRefinementSuccesses(0),numExplorationAttempts(0),
    numEdgeChecks(0),numConfigChecks(0),
@@ -72,8 +215,13 @@ Real MCRPlanner::Cost(const Subset& s) const
 
 void MCRPlanner::Init(const Config& _start,const Config& _goal)
 {
-  roadmap.Cleanup();
-  modeGraph.Cleanup();
+  bool reuse = (incremental && roadmap.nodes.size() >= 2 && labels.nodeLabels.size() == roadmap.nodes.size());
+  if(reuse && maxReuseMilestones > 0 && (int)roadmap.nodes.size() > maxReuseMilestones) reuse = false;
+  if(!reuse) {
+    roadmap.Cleanup();
+    modeGraph.Cleanup();
+    labels.Clear(space->NumObstacles());
+  }
   numExpands=0;
   numExplorationAttempts=0;
   numRefinementAttempts=0;
@@ -85,12 +233,107 @@ void MCRPlanner::Init(const Config& _start,const Config& _goal)
 
   start=_start;
   goal=_goal;
-  AddNode(start);
-  AddNode(goal);
+  if(reuse) {
+    //an old start or goal that moved becomes an ordinary milestone
+    bool moved[2] = { !(roadmap.nodes[0].q == start), !(roadmap.nodes[1].q == goal) };
+    for(int k=0;k<2;k++) {
+      if(!moved[k]) continue;
+      Milestone m = roadmap.nodes[k];
+      int index = roadmap.AddNode(m);
+      labels.MoveNode(k,index);
+      roadmap.nodes[k].q = (k==0 ? start : goal);
+      numConfigChecks++;
+      labels.SetNode(k,Violations(space,roadmap.nodes[k].q));
+    }
+    if(moved[0] || moved[1] || labels.NeedsUpdate())
+      RebuildFromLabels();
+    //connect the new start and goal to their neighbors
+    for(int k=0;k<2;k++) {
+      if(!moved[k]) continue;
+      vector<int> neighbors;
+      vector<Real> distances;
+      KNN(roadmap.nodes[k].q,numConnections,neighbors,distances);
+      for(size_t n=0;n<neighbors.size();n++) {
+        if(neighbors[n] == k || distances[n] > expandDistance) continue;
+        if(roadmap.HasEdge(k,neighbors[n])) continue;
+        AddEdge(k,neighbors[n]);
+      }
+    }
+  }
+  else {
+    AddNode(start);
+    AddNode(goal);
+  }
   if(updatePathsComplete) UpdatePathsComplete();
   else UpdatePathsGreedy();
 }
 
+void MCRPlanner::ObstacleChanged(int k)
+{
+  if(!labels.nodeLabels.empty()) labels.ObstacleChanged(k);
+}
+
+void MCRPlanner::ObstacleAdded(Real weight)
+{
+  if(!labels.nodeLabels.empty()) labels.ObstacleAdded();
+  if(!obstacleWeights.empty()) obstacleWeights.push_back(weight);
+}
+
+void MCRPlanner::ObstacleRemoved(int k)
+{
+  if(!labels.nodeLabels.empty()) labels.ObstacleRemoved(k);
+  if(!obstacleWeights.empty()) obstacleWeights.erase(obstacleWeights.begin()+k);
+}
+
+void MCRPlanner::RebuildFromLabels()
+{
+  int n = (int)roadmap.nodes.size();
+  vector<Milestone> nodes = roadmap.nodes;
+  vector<const Config*> qs(n);
+  for(int i=0;i<n;i++) qs[i] = &nodes[i].q;
+  labels.Update(space,qs);
+
+  roadmap.Cleanup();
+  modeGraph.Cleanup();
+  for(int i=0;i<n;i++)
+    roadmap.AddNode(nodes[i]);
+  //modes are the connected components of the valid edges between milestones
+  //with equal labels
+  UnionFind sets(n);
+  for(size_t i=0;i<labels.edges.size();i++) {
+    const MCRLabelCache::EdgeLabel& e = labels.edges[i];
+    if(labels.nodeLabels[e.a] == labels.nodeLabels[e.b] && labels.Consistent(e))
+      sets.Union(e.a,e.b);
+  }
+  vector<int> setMode(n,-1);
+  for(int i=0;i<n;i++) {
+    int s = sets.FindSet(i);
+    if(setMode[s] < 0) {
+      setMode[s] = (int)modeGraph.nodes.size();
+      modeGraph.AddNode(Mode());
+      modeGraph.nodes.back().subset = labels.NodeSubset(i);
+      modeGraph.nodes.back().minCost = DBL_MAX;
+    }
+    roadmap.nodes[i].mode = setMode[s];
+    modeGraph.nodes[setMode[s]].roadmapNodes.push_back(i);
+  }
+  for(size_t i=0;i<labels.edges.size();i++) {
+    const MCRLabelCache::EdgeLabel& e = labels.edges[i];
+    if(!labels.Consistent(e) || roadmap.HasEdge(e.a,e.b)) continue;
+    int ma = roadmap.nodes[e.a].mode;
+    int mb = roadmap.nodes[e.b].mode;
+    if(ma != mb) {
+      Transition* t=modeGraph.FindEdge(ma,mb);
+      if(!t) t=&modeGraph.AddEdge(ma,mb);
+      t->connections.push_back(pair<int,int>(e.a,e.b));
+    }
+    Edge edge;
+    edge.e = space->LocalPlanner(roadmap.nodes[e.a].q,roadmap.nodes[e.b].q);
+    edge.mode = (Cost(modeGraph.nodes[ma].subset) > Cost(modeGraph.nodes[mb].subset) ? ma : mb);
+    roadmap.AddEdge(e.a,e.b,edge);
+  }
+}
+
 void MCRPlanner::UpdateMinCost(Mode& m)
 {
   if(m.pathCovers.empty())
@@ -546,7 +789,7 @@ int MCRPlanner::AddNode(const Config& q,int parent)
   return AddNode(q,Subset(subsetbits),parent);
 }
 
-int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent)
+int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent,const Subset* edgeViolations)
 {
 #if DO_TIMING
   Timer timer;
@@ -554,6 +797,7 @@ int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent)
   int index=(int)roadmap.nodes.size();
   roadmap.AddNode(Milestone());
   roadmap.nodes[index].q = q;
+  if(incremental) labels.SetNode(index,subset);
 
   /*
   //Sanity check?
@@ -576,7 +820,7 @@ int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent)
     roadmap.nodes[index].mode = mode;
 
     if(parent >= 0) {
-      AddEdgeRaw(parent,index);
+      AddEdgeRaw(parent,index,edgeViolations);
 
       //initialize this mode's path cover
       int pmode = roadmap.nodes[parent].mode;
@@ -597,6 +841,10 @@ int MCRPlanner::AddNode(const Config& q,const Subset& subset,int parent)
     e.e = space->LocalPlanner(roadmap.nodes[parent].q,roadmap.nodes[index].q);
     e.mode = mode;
     roadmap.AddEdge(parent,index,e);
+    if(incremental) {
+      if(edgeViolations) labels.AddEdge(parent,index,*edgeViolations);
+      else labels.AddEdge(parent,index);
+    }
   }
 
 
@@ -630,7 +878,7 @@ bool MCRPlanner::AddEdge(int i,int j,int depth)
     if(!AddEdge(k,j,depth+1)) return false;
   }
   else {
-    AddEdgeRaw(i,j);
+    AddEdgeRaw(i,j,&ev);
   }
   return true;
 }
@@ -680,13 +928,13 @@ int MCRPlanner::AddEdge(int i,const Config& q,Real maxExplanationCost)
   else {
     //int j=AddNode(q,ev);
     //AddEdgeRaw(i,j);
-    int j=AddNode(q,qv,i);
+    int j=AddNode(q,qv,i,&ev);
     return j;
   }
 }
 
 
-void MCRPlanner::AddEdgeRaw(int i,int j)
+void MCRPlanner::AddEdgeRaw(int i,int j,const Subset* edgeViolations)
 {
 #if DO_TIMING
   Timer timer;
@@ -843,6 +1091,10 @@ void MCRPlanner::AddEdgeRaw(int i,int j)
   e.e = space->LocalPlanner(roadmap.nodes[i].q,roadmap.nodes[j].q);
   e.mode = (Cost(modeGraph.nodes[mi].subset) > Cost(modeGraph.nodes[mj].subset) ? mi : mj);
   roadmap.AddEdge(i,j,e);
+  if(incremental) {
+    if(edgeViolations) labels.AddEdge(i,j,*edgeViolations);
+    else labels.AddEdge(i,j);
+  }
 #if DO_TIMING
   timeOverhead += timer.ElapsedTime();
 #endif //DO_TIMING
@@ -879,7 +1131,7 @@ int MCRPlanner::ExtendToward(int i,const Config& qdest,Real maxExplorationCost)
     return AddEdge(j,qdest,maxExplorationCost);
   }
   //done
-  int j = AddNode(qdest,qv,i);
+  int j = AddNode(qdest,qv,i,&ev);
   //int j = AddNode(qdest,ev);
   //AddEdgeRaw(i,j);
   return j;
@@ -1301,7 +1553,7 @@ void MCRPlanner::Plan(int initialLimit,const vector<int>& expansionSchedule,vect
     if(i<wsorted.size()) {
       costEpsilon = wsorted[i];
       i++;
-      for(;i<wsorted.size();i++)
+      for(;i+1<wsorted.size();i++)
 	costEpsilon = Min(costEpsilon,wsorted[i+1]-wsorted[i]);
     }
   }
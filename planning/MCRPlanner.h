@@ -5,6 +5,63 @@
 #include "ExplicitCSpace.h"
 #include <KrisLibrary/utils/Subset.h>
 
+/** @brief Obstacle labels of the milestones and edges of an MCR roadmap,
+ * cached so the roadmap can be reused across queries while the obstacles
+ * change.
+ *
+ * A label is a bitset with one entry per obstacle, set if the milestone or
+ * the straight-line edge violates that obstacle.  When an obstacle changes,
+ * it is only marked here, and the next Update() rechecks that obstacle
+ * alone for every milestone and edge.  Edges that cross an obstacle that
+ * neither endpoint violates are kept even though the planner leaves them
+ * out of its roadmap, so they come back if that obstacle later moves away.
+ */
+class MCRLabelCache
+{
+ public:
+  struct EdgeLabel {
+    int a,b;
+    ///False if the edge still needs to be checked against every obstacle
+    bool checked;
+    std::vector<bool> violations;
+  };
+
+  MCRLabelCache();
+  ///Removes all labels and sets the current number of obstacles
+  void Clear(int numObstacles);
+  ///Sets the label of node i, which must be up to date
+  void SetNode(int i,const Subset& violations);
+  ///Adds an edge with up-to-date violations
+  void AddEdge(int a,int b,const Subset& violations);
+  ///Adds an edge that is checked against every obstacle at the next Update()
+  void AddEdge(int a,int b);
+  ///Moves node from's label and edges to node to, which must be unused
+  void MoveNode(int from,int to);
+  ///Marks obstacle k as changed
+  void ObstacleChanged(int k);
+  ///Appends a new obstacle, which is checked at the next Update()
+  void ObstacleAdded();
+  ///Deletes obstacle k.  Obstacles k+1,... are renumbered k,...
+  void ObstacleRemoved(int k);
+  ///Rechecks the changed obstacles.  qs[i] is the configuration of node i.
+  void Update(ExplicitCSpace* space,const std::vector<const Config*>& qs);
+  ///Returns true if some obstacle or edge must be rechecked by Update(), or
+  ///an obstacle was removed since the last Update()
+  bool NeedsUpdate() const;
+  ///Returns true if the edge violates no obstacle besides those of its
+  ///endpoints, i.e., it may be a roadmap edge
+  bool Consistent(const EdgeLabel& e) const;
+  Subset NodeSubset(int i) const { return Subset(nodeLabels[i]); }
+
+  int numObstacles;
+  std::vector<bool> changed;
+  bool obstaclesRemoved;
+  std::vector<std::vector<bool> > nodeLabels;
+  std::vector<EdgeLabel> edges;
+  ///Statistics: number of single-obstacle checks done by Update()
+  int numConfigChecks,numEdgeChecks;
+};
+
 /** @brief A planner that minimizes the the number of violated constraints
  * using a RRT-like strategy.
  * 
@@ -25,6 +82,19 @@
  *   //output best path
  *   MilestonePath path;
  *   planner.GetMilestonePath(bestPlan,path);
+ *
+ * If incremental is true, the roadmap and its obstacle labels are kept
+ * across calls to Init() and only the new start and goal are connected, so
+ * later queries start from the explored roadmap.  Changes to the obstacles
+ * of the space between queries must be reported with ObstacleChanged(),
+ * ObstacleAdded(), and ObstacleRemoved().  A start or goal that differs
+ * from the previous query's is connected as a new milestone, and the old
+ * one is kept as an ordinary milestone, so the roadmap grows by up to two
+ * milestones per query.  After a moved endpoint or an obstacle change,
+ * Init() rebuilds the modes and recreates the local planners of all
+ * edges, which takes time linear in the roadmap size.  Set
+ * maxReuseMilestones to start over with a fresh roadmap once it grows past
+ * that size.
  */
 class MCRPlanner
 {
@@ -52,6 +122,16 @@ class MCRPlanner
 
   MCRPlanner(ExplicitCSpace* space);
   void Init(const Config& start,const Config& goal);
+  ///In incremental mode, notifies the planner that obstacle k has moved
+  void ObstacleChanged(int k);
+  ///In incremental mode, notifies the planner that an obstacle was appended
+  ///to the space.  If obstacleWeights is used, weight is appended to it.
+  void ObstacleAdded(Real weight=1);
+  ///In incremental mode, notifies the planner that obstacle k was deleted
+  ///from the space and the later obstacles were renumbered
+  void ObstacleRemoved(int k);
+  ///Rebuilds the roadmap and mode graph from the updated labels
+  void RebuildFromLabels();
   ///Performs one iteration of planning given a limit on the explanation size
   void Expand(Real maxExplanationCost,vector<int>& newNodes);
   void Expand2(Real maxExplanationCost,vector<int>& newNodes);
@@ -76,10 +156,11 @@ class MCRPlanner
   //helpers
   Real Cost(const Subset& s) const;
   int AddNode(const Config& q,int parent=-1);
-  int AddNode(const Config& q,const Subset& subset,int parent=-1);
+  ///edgeViolations, if given, are the violations of the edge from parent
+  int AddNode(const Config& q,const Subset& subset,int parent=-1,const Subset* edgeViolations=NULL);
   bool AddEdge(int i,int j,int depth=0);
   int AddEdge(int i,const Config& q,Real maxExplanationCost);  //returns index of q
-  void AddEdgeRaw(int i,int j);
+  void AddEdgeRaw(int i,int j,const Subset* edgeViolations=NULL);
   int ExtendToward(int i,const Config& qdest,Real maxExplanationCost);
   void KNN(const Config& q,int k,vector<int>& neighbors,vector<Real>& distances);
   void KNN(const Config& q,Real maxExplanationCost,int k,vector<int>& neighbors,vector<Real>& distances);
@@ -118,6 +199,14 @@ class MCRPlanner
   Real goalBiasProbability;  //probability of expanding toward the goal
   bool bidirectional;        //not functional yet
   
+  ///If true, keep the roadmap across queries (default false)
+  bool incremental;
+  ///In incremental mode, a roadmap with more milestones than this is
+  ///discarded at the next Init().  If <= 0, the roadmap is always kept
+  ///(default 0)
+  int maxReuseMilestones;
+  MCRLabelCache labels;
+
   //settings for path update
   ///If true: use the slower complete, exact cover update.
   ///If false: use the faster greedy one.
@@ -3,7 +3,9 @@
 #include <math/random.h>
 #include <structs/FixedSizeHeap.h>
 #include <structs/Heap.h>
+#include <structs/IndexedPriorityQueue.h>
 #include <graph/Path.h>
+#include <utils/unionfind.h>
 #include <Timer.h>
 #include <algorithm>
 using namespace AI;
@@ -50,7 +52,7 @@ bool WithinThreshold(const MCRPlannerGoalSet::Mode& mode,const Subset& extra,Rea
 
 
 MCRPlannerGoalSet::MCRPlannerGoalSet(ExplicitCSpace* _space)
-  :goalSetProjector(NULL),space(_space),
+  :goalSetProjector(NULL),space(_space),incremental(false),maxReuseMilestones(0),
    updatePathsComplete(false),updatePathsDynamic(true),updatePathsMax(INT_MAX),
    numExpands(0),numRefinementAttempts(0),numRefinementSuccesses(0),numExplorationAttempts(0),
    numEdgeChecks(0),numConfigChecks(0),
@@ -74,8 +76,13 @@ Real MCRPlannerGoalSet::Cost(const Subset& s) const
 
 void MCRPlannerGoalSet::Init(const Config& _start,SubsetProjector* _goalProjector)
 {
-  roadmap.Cleanup();
-  modeGraph.Cleanup();
+  bool reuse = (incremental && !roadmap.nodes.empty() && labels.nodeLabels.size() == roadmap.nodes.size());
+  if(reuse && maxReuseMilestones > 0 && (int)roadmap.nodes.size() > maxReuseMilestones) reuse = false;
+  if(!reuse) {
+    roadmap.Cleanup();
+    modeGraph.Cleanup();
+    labels.Clear(space->NumObstacles());
+  }
   numExpands=0;
   numExplorationAttempts=0;
   numRefinementAttempts=0;
@@ -88,11 +95,106 @@ void MCRPlannerGoalSet::Init(const Config& _start,SubsetProjector* _goalProjecto
   start=_start; 
   goalSetProjector = _goalProjector;
   goalNodes.resize(0);
-  AddNode(start);
+  if(reuse) {
+    //an old start that moved becomes an ordinary milestone
+    bool moved = !(roadmap.nodes[0].q == start);
+    if(moved) {
+      Milestone m = roadmap.nodes[0];
+      int index = roadmap.AddNode(m);
+      labels.MoveNode(0,index);
+      roadmap.nodes[0].q = start;
+      numConfigChecks++;
+      labels.SetNode(0,Violations(space,start));
+    }
+    if(moved || labels.NeedsUpdate())
+      RebuildFromLabels();
+    for(size_t i=1;i<roadmap.nodes.size();i++)
+      if(goalSetProjector->Distance(roadmap.nodes[i].q)==0)
+        goalNodes.push_back((int)i);
+    //connect the new start to its neighbors
+    if(moved) {
+      vector<int> neighbors;
+      vector<Real> distances;
+      KNN(start,numConnections,neighbors,distances);
+      for(size_t n=0;n<neighbors.size();n++) {
+        if(neighbors[n] == 0 || distances[n] > expandDistance) continue;
+        if(roadmap.HasEdge(0,neighbors[n])) continue;
+        AddEdge(0,neighbors[n]);
+      }
+    }
+  }
+  else
+    AddNode(start);
   if(updatePathsComplete) UpdatePathsComplete();
   else UpdatePathsGreedy();
 }
 
+void MCRPlannerGoalSet::ObstacleChanged(int k)
+{
+  if(!labels.nodeLabels.empty()) labels.ObstacleChanged(k);
+}
+
+void MCRPlannerGoalSet::ObstacleAdded(Real weight)
+{
+  if(!labels.nodeLabels.empty()) labels.ObstacleAdded();
+  if(!obstacleWeights.empty()) obstacleWeights.push_back(weight);
+}
+
+void MCRPlannerGoalSet::ObstacleRemoved(int k)
+{
+  if(!labels.nodeLabels.empty()) labels.ObstacleRemoved(k);
+  if(!obstacleWeights.empty()) obstacleWeights.erase(obstacleWeights.begin()+k);
+}
+
+void MCRPlannerGoalSet::RebuildFromLabels()
+{
+  int n = (int)roadmap.nodes.size();
+  vector<Milestone> nodes = roadmap.nodes;
+  vector<const Config*> qs(n);
+  for(int i=0;i<n;i++) qs[i] = &nodes[i].q;
+  labels.Update(space,qs);
+
+  roadmap.Cleanup();
+  modeGraph.Cleanup();
+  for(int i=0;i<n;i++)
+    roadmap.AddNode(nodes[i]);
+  //modes are the connected components of the valid edges between milestones
+  //with equal labels
+  UnionFind sets(n);
+  for(size_t i=0;i<labels.edges.size();i++) {
+    const MCRLabelCache::EdgeLabel& e = labels.edges[i];
+    if(labels.nodeLabels[e.a] == labels.nodeLabels[e.b] && labels.Consistent(e))
+      sets.Union(e.a,e.b);
+  }
+  vector<int> setMode(n,-1);
+  for(int i=0;i<n;i++) {
+    int s = sets.FindSet(i);
+    if(setMode[s] < 0) {
+      setMode[s] = (int)modeGraph.nodes.size();
+      modeGraph.AddNode(Mode());
+      modeGraph.nodes.back().subset = labels.NodeSubset(i);
+      modeGraph.nodes.back().minCost = DBL_MAX;
+    }
+    roadmap.nodes[i].mode = setMode[s];
+    modeGraph.nodes[setMode[s]].roadmapNodes.push_back(i);
+  }
+  for(size_t i=0;i<labels.edges.size();i++) {
+    const MCRLabelCache::EdgeLabel& e = labels.edges[i];
+    if(!labels.Consistent(e) || roadmap.HasEdge(e.a,e.b)) continue;
+    int ma = roadmap.nodes[e.a].mode;
+    int mb = roadmap.nodes[e.b].mode;
+    if(ma != mb) {
+      Transition* t=modeGraph.FindEdge(ma,mb);
+      if(!t) t=&modeGraph.AddEdge(ma,mb);
+      t->connections.push_back(pair<int,int>(e.a,e.b));
+    }
+    Edge edge;
+    edge.e = space->LocalPlanner(roadmap.nodes[e.a].q,roadmap.nodes[e.b].q);
+    edge.mode = (Cost(modeGraph.nodes[ma].subset) > Cost(modeGraph.nodes[mb].subset) ? ma : mb);
+    roadmap.AddEdge(e.a,e.b,edge);
+  }
+}
+
 void MCRPlannerGoalSet::UpdateMinCost(Mode& m)
 {
   if(m.pathCovers.empty())
@@ -556,7 +658,7 @@ int MCRPlannerGoalSet::AddNode(const Config& q,int parent)
   return AddNode(q,Subset(subsetbits),parent);
 }
 
-int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent)
+int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent,const Subset* edgeViolations)
 {
 #if DO_TIMING
   Timer timer;
@@ -564,6 +666,7 @@ int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent)
   int index=(int)roadmap.nodes.size();
   roadmap.AddNode(Milestone());
   roadmap.nodes[index].q = q;
+  if(incremental) labels.SetNode(index,subset);
 
   /*
   //Sanity check?
@@ -586,7 +689,7 @@ int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent)
     roadmap.nodes[index].mode = mode;
 
     if(parent >= 0) {
-      AddEdgeRaw(parent,index);
+      AddEdgeRaw(parent,index,edgeViolations);
 
       //initialize this mode's path cover
       int pmode = roadmap.nodes[parent].mode;
@@ -607,6 +710,10 @@ int MCRPlannerGoalSet::AddNode(const Config& q,const Subset& subset,int parent)
     e.e = space->LocalPlanner(roadmap.nodes[parent].q,roadmap.nodes[index].q);
     e.mode = mode;
     roadmap.AddEdge(parent,index,e);
+    if(incremental) {
+      if(edgeViolations) labels.AddEdge(parent,index,*edgeViolations);
+      else labels.AddEdge(parent,index);
+    }
   }
 
 
@@ -640,7 +747,7 @@ bool MCRPlannerGoalSet::AddEdge(int i,int j,int depth)
     if(!AddEdge(k,j,depth+1)) return false;
   }
   else {
-    AddEdgeRaw(i,j);
+    AddEdgeRaw(i,j,&ev);
   }
   return true;
 }
@@ -675,13 +782,13 @@ int MCRPlannerGoalSet::AddEdge(int i,const Config& q,Real maxExplanationCost)
   else {
     //int j=AddNode(q,ev);
     //AddEdgeRaw(i,j);
-    int j=AddNode(q,qv,i);
+    int j=AddNode(q,qv,i,&ev);
     return j;
   }
 }
 
 
-void MCRPlannerGoalSet::AddEdgeRaw(int i,int j)
+void MCRPlannerGoalSet::AddEdgeRaw(int i,int j,const Subset* edgeViolations)
 {
 #if DO_TIMING
   Timer timer;
@@ -838,6 +945,10 @@ void MCRPlannerGoalSet::AddEdgeRaw(int i,int j)
   e.e = space->LocalPlanner(roadmap.nodes[i].q,roadmap.nodes[j].q);
   e.mode = (Cost(modeGraph.nodes[mi].subset) > Cost(modeGraph.nodes[mj].subset) ? mi : mj);
   roadmap.AddEdge(i,j,e);
+  if(incremental) {
+    if(edgeViolations) labels.AddEdge(i,j,*edgeViolations);
+    else labels.AddEdge(i,j);
+  }
 #if DO_TIMING
   timeOverhead += timer.ElapsedTime();
 #endif //DO_TIMING
@@ -874,7 +985,7 @@ int MCRPlannerGoalSet::ExtendToward(int i,const Config& qdest,Real maxExploratio
     return AddEdge(j,qdest,maxExplorationCost);
   }
   //done
-  int j = AddNode(qdest,qv,i);
+  int j = AddNode(qdest,qv,i,&ev);
   //int j = AddNode(qdest,ev);
   //AddEdgeRaw(i,j);
   return j;
@@ -1292,7 +1403,7 @@ void MCRPlannerGoalSet::Plan(int initialLimit,const vector<int>& expansionSchedu
     if(i<wsorted.size()) {
       costEpsilon = wsorted[i];
       i++;
-      for(;i<wsorted.size();i++)
+      for(;i+1<wsorted.size();i++)
 	costEpsilon = Min(costEpsilon,wsorted[i+1]-wsorted[i]);
     }
   }
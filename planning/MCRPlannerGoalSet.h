@@ -3,6 +3,7 @@
 
 #include "MotionPlanner.h"
 #include "ExplicitCSpace.h"
+#include "MCRPlanner.h"
 #include <KrisLibrary/utils/Subset.h>
 
 /** @brief A subset of a configuration space equipped with a projection
@@ -52,6 +53,13 @@ class SingletonSetProjector : public SubsetProjector
  *   //output best path
  *   MilestonePath path;
  *   planner.GetMilestonePath(bestPlan,path);
+ *
+ * Incremental mode works as in MCRPlanner: the roadmap is kept across calls
+ * to Init(), and obstacle changes must be reported with ObstacleChanged(),
+ * ObstacleAdded(), and ObstacleRemoved().  The goal nodes are recomputed
+ * with the new goal projector.  A start that differs from the previous
+ * query's is kept as an ordinary milestone, and maxReuseMilestones bounds
+ * the size of the reused roadmap.
  */
 class MCRPlannerGoalSet
 {
@@ -79,6 +87,16 @@ class MCRPlannerGoalSet
 
   MCRPlannerGoalSet(ExplicitCSpace* space);
   void Init(const Config& start,SubsetProjector* goalProjector);
+  ///In incremental mode, notifies the planner that obstacle k has moved
+  void ObstacleChanged(int k);
+  ///In incremental mode, notifies the planner that an obstacle was appended
+  ///to the space.  If obstacleWeights is used, weight is appended to it.
+  void ObstacleAdded(Real weight=1);
+  ///In incremental mode, notifies the planner that obstacle k was deleted
+  ///from the space and the later obstacles were renumbered
+  void ObstacleRemoved(int k);
+  ///Rebuilds the roadmap and mode graph from the updated labels
+  void RebuildFromLabels();
   ///Performs one iteration of planning given a limit on the explanation size
   void Expand(Real maxExplanationCost,vector<int>& newNodes);
   void Expand2(Real maxExplanationCost,vector<int>& newNodes);
@@ -103,10 +121,11 @@ class MCRPlannerGoalSet
   //helpers
   Real Cost(const Subset& s) const;
   int AddNode(const Config& q,int parent=-1);
-  int AddNode(const Config& q,const Subset& subset,int parent=-1);
+  ///edgeViolations, if given, are the violations of the edge from parent
+  int AddNode(const Config& q,const Subset& subset,int parent=-1,const Subset* edgeViolations=NULL);
   bool AddEdge(int i,int j,int depth=0);
   int AddEdge(int i,const Config& q,Real maxExplanationCost);  //returns index of q
-  void AddEdgeRaw(int i,int j);
+  void AddEdgeRaw(int i,int j,const Subset* edgeViolations=NULL);
   int ExtendToward(int i,const Config& qdest,Real maxExplanationCost);
   void KNN(const Config& q,int k,vector<int>& neighbors,vector<Real>& distances);
   void KNN(const Config& q,Real maxExplanationCost,int k,vector<int>& neighbors,vector<Real>& distances);
@@ -147,6 +166,14 @@ class MCRPlannerGoalSet
   Real goalBiasProbability;  //probability of expanding toward the goal
   bool bidirectional;        //not functional yet
   
+  ///If true, keep the roadmap across queries (default false)
+  bool incremental;
+  ///In incremental mode, a roadmap with more milestones than this is
+  ///discarded at the next Init().  If <= 0, the roadmap is always kept
+  ///(default 0)
+  int maxReuseMilestones;
+  MCRLabelCache labels;
+
   //settings for path update
   ///If true: use the slower complete, exact cover update.
   ///If false: use the faster greedy one.
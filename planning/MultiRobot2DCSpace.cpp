@@ -4,6 +4,8 @@
 #include <math/angle.h>
 #include <math/random.h>
 #include <math/sample.h>
+#include <Timer.h>
+#include <algorithm>
 
 MultiRobot2DCSpace::MultiRobot2DCSpace()
 {
@@ -153,26 +155,74 @@ bool MultiRobot2DCSpace::IsFeasible(const Config& x)
 {
   int stride = (allowRotation ? 3 : 2);
   Assert(x.n==stride*(int)robots.size());
+  bool useGrid = obstacleGrid.Matches(obstacles);
+  //place each robot once, and check it against the domain and obstacles
+  vector<Geometric2DCollection> placed(robots.size());
+  vector<AABB2D> bbs(robots.size());
   int k=0;
   for(size_t i=0;i<robots.size();i++,k+=stride) {
     if(!domain.contains(Vector2(x(k),x(k+1)))) return false;
-    RigidTransform2D T=GetRobotTransform(i,x);
-    Geometric2DCollection temp = robots[i];
-    temp.Transform(T);
-    if(obstacles.Collides(temp)) return false;
-
-    //check self collisions
-    int m=0;
-    for(size_t j=0;j<i;j++,m+=stride) {
-      T=GetRobotTransform(j,x);
-      Geometric2DCollection temp2 = robots[j];
-      temp2.Transform(T);
-      if(temp.Collides(temp2)) return false;
+    placed[i] = robots[i];
+    placed[i].Transform(GetRobotTransform(i,x));
+    if(useGrid) {
+      if(obstacleGrid.Collides(placed[i])) return false;
+    }
+    else {
+      if(obstacles.Collides(placed[i])) return false;
+    }
+    Geometric2DCollectionGrid::GetBounds(placed[i],bbs[i]);
+  }
+
+  //check self collisions: sweep the robots' bounding boxes along x, and
+  //only test the pairs whose boxes overlap
+  vector<pair<Real,int> > order(robots.size());
+  for(size_t i=0;i<robots.size();i++)
+    order[i] = pair<Real,int>(bbs[i].bmin.x,(int)i);
+  sort(order.begin(),order.end());
+  for(size_t a=0;a<order.size();a++) {
+    int i=order[a].second;
+    for(size_t b=a+1;b<order.size();b++) {
+      if(order[b].first > bbs[i].bmax.x) break;
+      int j=order[b].second;
+      if(bbs[j].bmin.y > bbs[i].bmax.y || bbs[j].bmax.y < bbs[i].bmin.y) continue;
+      if(placed[Max(i,j)].Collides(placed[Min(i,j)])) return false;
     }
   }
   return true;
 }
 
+void MultiRobot2DCSpace::BenchmarkFeasibility(const Config& x,Real r,int numSamples)
+{
+  vector<Config> samples(numSamples);
+  for(int i=0;i<numSamples;i++)
+    SampleNeighborhood(x,r,samples[i]);
+
+  Geometric2DCollectionGrid saved = obstacleGrid, grid = obstacleGrid;
+  if(!grid.Matches(obstacles)) grid.Build(obstacles);
+  vector<bool> feasible(numSamples);
+  int numFeasible=0;
+  Timer timer;
+  obstacleGrid.Clear();
+  for(int i=0;i<numSamples;i++)
+    feasible[i] = IsFeasible(samples[i]);
+  Real tScalar = timer.ElapsedTime();
+
+  obstacleGrid = grid;
+  int numMismatches=0;
+  timer.Reset();
+  for(int i=0;i<numSamples;i++) {
+    bool res = IsFeasible(samples[i]);
+    if(res) numFeasible++;
+    if(res != feasible[i]) numMismatches++;
+  }
+  Real tGrid = timer.ElapsedTime();
+  obstacleGrid = saved;
+  printf("MultiRobot2DCSpace: %d robots, %d obstacles, %d samples (%d feasible)\n",(int)robots.size(),obstacles.NumObstacles(),numSamples,numFeasible);
+  printf("  Without grid %gs, with grid %gs (%d x %d cells)\n",tScalar,tGrid,grid.nx,grid.ny);
+  if(numMismatches != 0)
+    fprintf(stderr,"MultiRobot2DCSpace::BenchmarkFeasibility: %d samples differ between the grid and the direct test!\n",numMismatches);
+}
+
 EdgePlanner* MultiRobot2DCSpace::LocalPlanner(const Config& a,const Config& b)
 {
   return new BisectionEpsilonEdgePlanner(this,a,b,visibilityEpsilon);
@@ -16,6 +16,12 @@ public:
   void DrawRobotGL(int index,const Config& q) const;
   void DrawGL(const Config& q) const;
   RigidTransform2D GetRobotTransform(int index,const Config& q) const;
+  ///Builds obstacleGrid, which IsFeasible(x) then uses.  Call again after
+  ///changing the obstacles; until then IsFeasible(x) uses the exact checks.
+  void BuildObstacleGrid(Real cellSize=0) { obstacleGrid.Build(obstacles,cellSize); }
+  ///Times IsFeasible on numSamples configurations sampled within radius r
+  ///of x, with and without the obstacle grid, and prints the results.
+  void BenchmarkFeasibility(const Config& x,Real r,int numSamples=1000);
 
   /* TODO: implement these
   void GetSingleRobotConfig(const Config& q,int index,Config& qrobot) const;
@@ -37,6 +43,7 @@ public:
   Real visibilityEpsilon;
   AABB2D domain;
   Geometric2DCollection obstacles;
+  Geometric2DCollectionGrid obstacleGrid;
   vector<Geometric2DCollection> robots;
 };
 
@@ -13,6 +13,15 @@
 //is greater than the current goal cost
 #define ELLIPSOID_PRUNING 1
 
+//Number of tries when sampling the informed set by rejection, after which
+//an uninformed sample is used
+#define INFORMED_SAMPLING_TRIES 50
+
+//Relative tolerance of the pruning test, so that milestones whose
+//heuristic cost equals the solution cost (e.g., on a straight-line path)
+//are kept
+#define PRUNE_TOLERANCE 1e-6
+
 //TEST: An incremental version of FMT*
 #define TEST_FMT 0
 
@@ -24,11 +33,10 @@
 //regular distance function used in shortest paths update
 #define DISTANCE_FUNC EdgeDistance()
 
-//if 1, the path checking is done adaptively so that edges are placed in a priority queue
-//and bisected until an infeasible solution is found.  If 0, the path checking is done by
-//walking along the path and calling IsVisible() along each unchecked edge
+//if 1, the path checking is done adaptively by a LazyEdgeChecker, which bisects the
+//longest unchecked segment on the path until an infeasible one is found.  If 0, the path
+//checking is done by walking along the path and calling IsVisible() along each unchecked edge
 #define ADAPTIVE_SUBDIVISION 1
-#define ADAPTIVE_SUBDIVISION_CHECK_COUNT 10
 
 #if TEST_EDGE_DISCOUNTING
   #if TEST_FMT
@@ -97,7 +105,7 @@ bool connectedToStartFilter(int n)
 }
 
 PRMStarPlanner::PRMStarPlanner(CSpace* space)
-  :RoadmapPlanner(space),lazy(false),rrg(false),bidirectional(true),connectByRadius(false),connectRadiusConstant(1),connectNeighborsConstant(1.1),connectionThreshold(Inf),lazyCheckThreshold(Inf),suboptimalityFactor(0),spp(roadmap),sppGoal(roadmap),sppLB(LBroadmap),sppLBGoal(LBroadmap)
+  :RoadmapPlanner(space),lazy(false),rrg(false),bidirectional(true),connectByRadius(false),connectRadiusConstant(1),connectNeighborsConstant(1.1),connectionThreshold(Inf),lazyCheckThreshold(Inf),suboptimalityFactor(0),informedSampling(false),pruning(false),pruneThreshold(0.05),spp(roadmap),sppGoal(roadmap),sppLB(LBroadmap),sppLBGoal(LBroadmap),informedEllipsoid(false),pruneCost(Inf)
 {
   start = goal = -1;
 }
@@ -135,8 +143,146 @@ void PRMStarPlanner::Init(const Config& qstart,const Config& qgoal)
   numPlanSteps = 0;
   numEdgeChecks = 0;
   numEdgePrechecks = 0;
+  numPrunes = 0;
+  numMilestonesPruned = 0;
+  pruneCost = Inf;
   tCheck=tKnn=tConnect=tLazy=tLazyCheck=tShortestPaths=0;
+
+  //the ellipsoid can be sampled directly in unweighted Euclidean spaces
+  informedEllipsoid = false;
+  PropertyMap props;
+  space->Properties(props);
+  string metric;
+  int cartesian=0, euclidean=1;
+  vector<Real> weights,bmin,bmax;
+  props.get("euclidean",euclidean);
+  if(props.get("cartesian",cartesian) && cartesian && euclidean && props.get("metric",metric) && metric == "euclidean" && !props.getArray("metricWeights",weights)) {
+    if(props.getArray("minimum",bmin) && props.getArray("maximum",bmax) && (int)bmin.size() == qstart.n && (int)bmax.size() == qstart.n) {
+      informedEllipsoid = true;
+      domainMin = bmin;
+      domainMax = bmax;
+    }
+  }
+}
+
+void PRMStarPlanner::SampleInformed(Real cost,Config& x)
+{
+  const Config& a = roadmap.nodes[start];
+  const Config& b = roadmap.nodes[goal];
+  if(informedEllipsoid) {
+    int n = a.n;
+    Real cmin = a.distance(b);
+    if(cost <= cmin) {
+      x.add(a,b);
+      x.inplaceMul(Half);
+      return;
+    }
+    //axis 0 of the ellipsoid is mapped to the start-goal direction by the
+    //Householder reflection with vector w = e0 - (b-a)/cmin
+    Vector w;
+    w.sub(a,b);
+    w /= cmin;
+    w[0] += One;
+    Real wnorm2 = w.normSquared();
+    Real r1 = cost*Half, r2 = Sqrt(cost*cost-cmin*cmin)*Half;
+    Vector y(n);
+    for(int tries=0;tries<INFORMED_SAMPLING_TRIES;tries++) {
+      //uniform point in the unit ball, scaled to the ellipsoid radii
+      for(int i=0;i<n;i++) y[i] = RandGaussian();
+      Real ynorm = y.norm();
+      if(ynorm == 0) continue;
+      y *= Pow(Rand(),One/Real(n))/ynorm;
+      y[0] *= r1;
+      for(int i=1;i<n;i++) y[i] *= r2;
+      if(wnorm2 > Epsilon)
+        y.madd(w,-2.0*w.dot(y)/wnorm2);
+      x.add(a,b);
+      x.inplaceMul(Half);
+      x += y;
+      bool inside = true;
+      for(int i=0;i<n;i++)
+        if(x[i] < domainMin[i] || x[i] > domainMax[i]) { inside = false; break; }
+      if(inside) return;
+    }
+    //the ellipsoid is mostly outside the domain, fall back to rejection
+  }
+  for(int tries=0;tries<INFORMED_SAMPLING_TRIES;tries++) {
+    GenerateConfig(x);
+    if(space->Distance(a,x)+space->Distance(x,b) < cost) return;
+  }
+}
+
+int PRMStarPlanner::Prune()
+{
+  Real cost = spp.d[goal];
+  if(IsInf(cost)) return 0;
+  pruneCost = cost;
+  Real fudgeFactor = 1.0+suboptimalityFactor;
+  bool useSppLB = (lazy || (rrg && suboptimalityFactor > 0));
+  bool useSppGoal = (bidirectional || (lazy && PRECHECK_OPTIMAL_EDGES));
+  //the milestones on the current solution path are always kept
+  vector<bool> onPath(roadmap.nodes.size(),false);
+  for(int n=goal;n >= 0 && !onPath[n];n=spp.p[n])
+    onPath[n] = true;
+  if(useSppLB) {
+    vector<bool> onLBPath(roadmap.nodes.size(),false);
+    for(int n=goal;n >= 0 && !onLBPath[n];n=sppLB.p[n])
+      onLBPath[n] = onPath[n] = true;
+  }
+  vector<int> deleted;
+  for(int i=0;i<(int)roadmap.nodes.size();i++) {
+    if(i == start || i == goal || onPath[i]) continue;
+    const Config& x = roadmap.nodes[i];
+    if((space->Distance(roadmap.nodes[start],x)+space->Distance(x,roadmap.nodes[goal]))*fudgeFactor > cost*(1.0+PRUNE_TOLERANCE))
+      deleted.push_back(i);
+  }
+  if(deleted.empty()) return 0;
+  numPrunes++;
+  numMilestonesPruned += (int)deleted.size();
+
+  //the start and goal are never deleted, so they keep indices 0 and 1
+  vector<int> mapping = deleted;
+  roadmap.DeleteNodes(mapping);
+  if(useSppLB) {
+    vector<int> lbmapping = deleted;
+    LBroadmap.DeleteNodes(lbmapping);
+    Assert(lbmapping == mapping);
+  }
+
+  //rebuild the point locator on the remaining nodes
+  Timer timer;
+  vector<Config> nodes;
+  swap(nodes,roadmap.nodes);
+  if(!pointLocator->OnClear()) {
+    fprintf(stderr,"PRMStarPlanner::Prune: point locator does not support clearing, switching to naive point location\n");
+    pointLocator = new NaivePointLocation(roadmap.nodes,space);
+  }
+  for(size_t i=0;i<nodes.size();i++) {
+    roadmap.nodes.push_back(nodes[i]);
+    pointLocator->OnAppend();
+  }
+  tKnn += timer.ElapsedTime();
+
+  //deleted nodes may have been on shortest paths to other nodes
+  timer.Reset();
+  spp.InitializeSource(start);
+  spp.FindAllPaths_Undirected(DISTANCE_FUNC);
+  if(useSppGoal) {
+    sppGoal.InitializeSource(goal);
+    sppGoal.FindAllPaths_Undirected(DISTANCE_FUNC);
+  }
+  if(useSppLB) {
+    sppLB.InitializeSource(start);
+    sppLB.FindAllPaths_Undirected(LB_DISTANCE_FUNC);
+    if(useSppGoal) {
+      sppLBGoal.InitializeSource(goal);
+      sppLBGoal.FindAllPaths_Undirected(LB_DISTANCE_FUNC);
+    }
+  }
+  tShortestPaths += timer.ElapsedTime();
+  return (int)deleted.size();
 }
+
 void PRMStarPlanner::PlanMore()
 {
   if(start < 0 || goal < 0) {
@@ -152,12 +298,19 @@ void PRMStarPlanner::PlanMore()
 
   Real goalDist = spp.d[goal];
   Real fudgeFactor = 1.0+suboptimalityFactor;
+  if(pruning && !IsInf(goalDist) && goalDist < pruneCost*(1.0-pruneThreshold)) {
+    Prune();
+    goalDist = spp.d[goal];
+  }
 
   Timer timer;
   int m = -1;
   if(!rrg) {
     //PRM* expansion strategy
-    GenerateConfig(x);
+    if(informedSampling && !IsInf(goalDist))
+      SampleInformed(goalDist/fudgeFactor,x);
+    else
+      GenerateConfig(x);
 #if ELLIPSOID_PRUNING
     if((space->Distance(roadmap.nodes[start],x)+space->Distance(x,roadmap.nodes[goal]))*fudgeFactor >= goalDist) {
       return;
@@ -172,7 +325,10 @@ void PRMStarPlanner::PlanMore()
   }
   else {
     //RRT/RRG expansion strategy
-    GenerateConfig(x);
+    if(informedSampling && !IsInf(goalDist))
+      SampleInformed(goalDist/fudgeFactor,x);
+    else
+      GenerateConfig(x);
 #if ELLIPSOID_PRUNING
     if((space->Distance(roadmap.nodes[start],x)+space->Distance(x,roadmap.nodes[goal]))*fudgeFactor >= goalDist) {
       //printf("Ellipsoid pruned, distance %g\n",space->Distance(roadmap.nodes[start],x)+space->Distance(x,roadmap.nodes[goal]));
@@ -487,7 +643,7 @@ int PRMStarPlanner::AddMilestone(const Config& x)
 
 void PRMStarPlanner::ConnectEdge(int i,int j,const SmartPointer<EdgePlanner>& e)
 {
-  bool useSpp = (rrg || lazy);
+  bool useSpp = (rrg || lazy || informedSampling || pruning);
   bool useSppLB = (lazy || (rrg && suboptimalityFactor > 0));
   bool useSppGoal = (bidirectional || (lazy && PRECHECK_OPTIMAL_EDGES));
 
@@ -607,7 +763,7 @@ bool PRMStarPlanner::GetPath(MilestonePath& path)
 
 bool PRMStarPlanner::HasPath() const
 {
-  bool useSpp = (rrg || lazy);
+  bool useSpp = (rrg || lazy || informedSampling || pruning);
   if(!useSpp) {
     ShortestPathProblem spptemp(roadmap);
     spptemp.InitializeSource(start);
@@ -621,7 +777,7 @@ bool PRMStarPlanner::HasPath() const
 
 bool PRMStarPlanner::GetPath(int a,int b,vector<int>& nodes,MilestonePath& path)
 {
-  bool useSpp = (rrg || lazy);
+  bool useSpp = (rrg || lazy || informedSampling || pruning);
   if(!useSpp) {
     spp.InitializeSource(a);
     spp.FindPath_Undirected(b,DISTANCE_FUNC);
@@ -668,25 +824,10 @@ bool PRMStarPlanner::GetPath(int a,int b,vector<int>& nodes,MilestonePath& path)
 
 struct RoadmapEdgeInfo
 {
-  Real Priority() const { return e->Priority(); }
-  //Real Priority() const { return e->Priority()/(1.0+distanceFromEndpoint); }
-  //Real Priority() const { return e->Priority()*(1.0+distanceFromEndpoint); }
-  //Real Priority() const { return Exp(-e->Priority()*distanceFromEndpoint); }
-  //Real Priority() const { return -distanceFromEndpoint; }
   int s,t;
-  Real distanceFromEndpoint;
   SmartPointer<EdgePlanner> e;
 };
 
-struct LessEdgePriority
-{
-  typedef RoadmapEdgeInfo EdgeInfo;
-  bool operator() (EdgeInfo& a,EdgeInfo& b) const
-  {
-    return a.Priority() < b.Priority();
-  }
-};
-
 class FMTAStar : public AI::GeneralizedAStar<int,double>
 {
 public:
@@ -772,48 +913,42 @@ bool PRMStarPlanner::CheckPath(int a,int b)
     }
     Assert(npath[0] == a);
     Timer timer;
-    bool feas = true;
-#if ADAPTIVE_SUBDIVISION
-    priority_queue<RoadmapEdgeInfo,vector<RoadmapEdgeInfo>,LessEdgePriority> q;
+    vector<RoadmapEdgeInfo> edges;
     for(size_t i=0;i+1<npath.size();i++) {
       if(roadmap.HasEdge(npath[i],npath[i+1])) continue;
       RoadmapEdgeInfo e;
       e.s = npath[i];
       e.t = npath[i+1];
-      e.distanceFromEndpoint = (int)i;
-      if(bidirectional && ((int)npath.size()-(int)i-1 < e.distanceFromEndpoint))
-	e.distanceFromEndpoint = (int)npath.size()-(int)i-1;
       e.e = *LBroadmap.FindEdge(npath[i],npath[i+1]);
-      q.push(e);
-    }
-    //adaptive division of path
-    while(!q.empty()) {
-      RoadmapEdgeInfo temp=q.top(); q.pop();
-      int cnt = ADAPTIVE_SUBDIVISION_CHECK_COUNT;
-      if(!temp.e->Done() && cnt-- > 0) 
-	temp.e->Plan(); 
-      if(!temp.e->Done()) {
-	q.push(temp);
-	continue;
-      }
-      bool edgeInfeasible = temp.e->Failed();
+      edges.push_back(e);
+    }
+    //edges in the order they finished checking; if the path is infeasible,
+    //the last one is in collision
+    vector<int> checked;
+    bool feas = true;
+#if ADAPTIVE_SUBDIVISION
+    for(size_t i=0;i<edges.size();i++)
+      edgeChecker.Add(edges[i].e,(int)i);
+    feas = edgeChecker.Check();
+    checked = edgeChecker.completed;
+    if(!feas) checked.push_back(edgeChecker.failed);
 #else
     //non-adaptive subdivision -- just march along path
-    for(size_t i=0;i+1<npath.size();i++) {
-      if(roadmap.HasEdge(npath[i],npath[i+1])) continue;
-      RoadmapEdgeInfo temp;
-      temp.s = npath[i];
-      temp.t = npath[i+1];
-      temp.e = *LBroadmap.FindEdge(npath[i],npath[i+1]);
-      bool edgeInfeasible = !temp.e->IsVisible();
+    for(size_t i=0;i<edges.size();i++) {
+      checked.push_back((int)i);
+      if(!edges[i].e->IsVisible()) {
+	feas = false;
+	break;
+      }
+    }
 #endif //ADAPTIVE_SUBDIVISION
-
-      //it's done planning
+    for(size_t k=0;k<checked.size();k++) {
+      const RoadmapEdgeInfo& temp = edges[checked[k]];
       numEdgeChecks++;
-      if(edgeInfeasible) {
+      if(!feas && k+1 == checked.size()) {
 	tLazyCheck += timer.ElapsedTime();
 	//delete edge from lazy roadmap
-	//printf("Deleting edge %d %d...\n",npath[i],npath[i+1]);
+	//printf("Deleting edge %d %d...\n",temp.s,temp.t);
 	LBroadmap.DeleteEdge(temp.s,temp.t);
 
 	//update shortest paths
@@ -823,7 +958,6 @@ bool PRMStarPlanner::CheckPath(int a,int b)
 	  sppLBGoal.DeleteUpdate_Undirected(temp.s,temp.t,LB_DISTANCE_FUNC);
 	tShortestPaths += timer.ElapsedTime();
 	//Assert(sppLB.HasShortestPaths_Undirected(0,distanceWeightFunc));
-	feas = false;
       }
       else {
 	roadmap.AddEdge(temp.s,temp.t,temp.e);
@@ -2,6 +2,7 @@
 #define OPTIMAL_MOTION_PLANNER_H
 
 #include "MotionPlanner.h"
+#include "LazyEdgeChecker.h"
 #include <KrisLibrary/graph/ShortestPaths.h>
 
 class PRMStarPlanner : public RoadmapPlanner
@@ -32,6 +33,15 @@ class PRMStarPlanner : public RoadmapPlanner
   virtual void ConnectEdge(int i,int j,const SmartPointer<EdgePlanner>& e);
   ///Helper: add an unchecked edge, and update data structures
   void ConnectEdgeLazy(int i,int j,const SmartPointer<EdgePlanner>& e);
+  ///Helper: samples a configuration from the informed set, i.e., the
+  ///configurations x with d(start,x)+d(x,goal) < cost.  Samples the
+  ///ellipsoid directly if the space is Euclidean with known bounds,
+  ///otherwise uses rejection sampling with a bounded number of tries.
+  void SampleInformed(Real cost,Config& x);
+  ///Helper: deletes the milestones that are outside the informed set of
+  ///the current solution, so they cannot lie on an improved path.  Returns
+  ///the number of milestones deleted.  Milestone indices are changed.
+  int Prune();
 
   //configuration variables
   ///Set lazy to true if you wish to do lazy planning (default false)
@@ -57,17 +67,40 @@ class PRMStarPlanner : public RoadmapPlanner
   Real lazyCheckThreshold;
   ///For suboptimal planning (like LBT-RRT*), default 0
   Real suboptimalityFactor;
+  ///If true, once a solution is found, new samples are drawn from its
+  ///informed set (see SampleInformed).  Default false
+  bool informedSampling;
+  ///If true, milestones that cannot improve the solution are deleted each
+  ///time the solution cost drops by more than the fraction pruneThreshold
+  ///since the last pruning (see Prune).  This keeps the roadmap size
+  ///bounded during long anytime runs.  Milestones on the current solution
+  ///path are never deleted.  Default false, threshold 0.05
+  ///
+  ///Either option makes plain PRM* maintain the start's shortest paths
+  ///incrementally, as RRG* and lazy planning do, so the solution cost is
+  ///known while planning.
+  bool pruning;
+  Real pruneThreshold;
 
   int start,goal;
   typedef Graph::ShortestPathProblem<Config,SmartPointer<EdgePlanner> > ShortestPathProblem;
   ShortestPathProblem spp,sppGoal,sppLB,sppLBGoal;
   Roadmap LBroadmap;
+  ///Set up in Init: true if the informed set can be sampled directly as an
+  ///ellipsoid in the bounds [domainMin,domainMax]
+  bool informedEllipsoid;
+  Vector domainMin,domainMax;
+  ///Solution cost at the last pruning
+  Real pruneCost;
+  ///Checks the candidate paths in lazy planning
+  LazyEdgeChecker edgeChecker;
 
   //statistics
   int numPlanSteps;
   Real tCheck, tKnn, tConnect, tLazy, tLazyCheck, tShortestPaths;
   int numEdgeChecks;
   int numEdgePrechecks;
+  int numPrunes,numMilestonesPruned;
 };
 
 
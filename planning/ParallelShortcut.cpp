@@ -0,0 +1,224 @@
+#include "ParallelShortcut.h"
+#include <utils/threadutils.h>
+#include <errors.h>
+#include <algorithm>
+using namespace std;
+
+struct ShortcutCandidate
+{
+  int i1,i2;
+  Real t1,t2;
+  ///The configuration entries moved by a partial shortcut, empty if the
+  ///shortcut is a straight line
+  vector<int> dofs;
+  bool feasible;
+  Real gain;
+  ///Replacement for edges i1,...,i2
+  vector<SmartPointer<EdgePlanner> > edges;
+};
+
+//Checks a candidate against the path, filling out feasible, gain, and edges
+static void EvaluateCandidate(const MilestonePath& path,ShortcutCandidate& c)
+{
+  c.feasible = false;
+  c.gain = 0;
+  CSpace* space = path.Space();
+  Config x1,x2;
+  path.edges[c.i1]->Eval(c.t1,x1);
+  path.edges[c.i2]->Eval(c.t2,x2);
+  const Config& a = path.edges[c.i1]->Start();
+  const Config& b = path.edges[c.i2]->Goal();
+  Real oldLength = 0;
+  for(int k=c.i1;k<=c.i2;k++)
+    oldLength += space->Distance(path.edges[k]->Start(),path.edges[k]->Goal());
+
+  vector<Config> pts;
+  pts.push_back(a);
+  pts.push_back(x1);
+  if(!c.dofs.empty()) {
+    //intermediate milestones keep their other entries, and the chosen
+    //entries are interpolated by arc length along the original section
+    int n = c.i2-c.i1;
+    vector<Real> s(n+1);
+    s[0] = 0;
+    for(int k=1;k<=n;k++) {
+      const Config& prev = (k==1 ? x1 : path.edges[c.i1+k-1]->Start());
+      s[k] = s[k-1] + space->Distance(prev,path.edges[c.i1+k]->Start());
+    }
+    Real total = s[n] + space->Distance(path.edges[c.i2]->Start(),x2);
+    if(total <= 0) return;
+    for(int k=1;k<=n;k++) {
+      Config y = path.edges[c.i1+k]->Start();
+      Real u = s[k]/total;
+      for(size_t d=0;d<c.dofs.size();d++)
+        y(c.dofs[d]) = x1(c.dofs[d]) + u*(x2(c.dofs[d])-x1(c.dofs[d]));
+      pts.push_back(y);
+    }
+  }
+  pts.push_back(x2);
+  pts.push_back(b);
+
+  //drop repeated points, e.g., when x1 = a
+  vector<Config> chain;
+  chain.push_back(pts[0]);
+  for(size_t k=1;k<pts.size();k++)
+    if(space->Distance(chain.back(),pts[k]) > 0) chain.push_back(pts[k]);
+  if(chain.size() < 2) return;
+  Real newLength = 0;
+  for(size_t k=0;k+1<chain.size();k++)
+    newLength += space->Distance(chain[k],chain[k+1]);
+  c.gain = oldLength - newLength;
+  if(c.gain <= oldLength*1e-8) return;
+
+  //the shortcut segments are the most likely to fail, so check them first
+  //and the pieces of the original edges last
+  c.edges.resize(chain.size()-1);
+  for(size_t k=0;k<c.edges.size();k++)
+    c.edges[k] = space->LocalPlanner(chain[k],chain[k+1]);
+  int m = (int)c.edges.size();
+  for(int k=1;k<m-1;k++)
+    if(!c.edges[k]->IsVisible()) { c.edges.clear(); return; }
+  if(!c.edges[0]->IsVisible() || (m > 1 && !c.edges[m-1]->IsVisible())) {
+    c.edges.clear();
+    return;
+  }
+  c.feasible = true;
+}
+
+struct ShortcutThreadData
+{
+  const MilestonePath* path;
+  vector<ShortcutCandidate>* candidates;
+  int index,stride;
+};
+
+static void* ShortcutThreadFunc(void* vdata)
+{
+  ShortcutThreadData* data = (ShortcutThreadData*)vdata;
+  for(size_t i=data->index;i<data->candidates->size();i+=data->stride)
+    EvaluateCandidate(*data->path,(*data->candidates)[i]);
+  return NULL;
+}
+
+struct HigherGain
+{
+  const vector<ShortcutCandidate>* candidates;
+  bool operator () (int a,int b) const {
+    if((*candidates)[a].gain != (*candidates)[b].gain) return (*candidates)[a].gain > (*candidates)[b].gain;
+    return a < b;
+  }
+};
+
+struct LaterStart
+{
+  const vector<ShortcutCandidate>* candidates;
+  bool operator () (int a,int b) const { return (*candidates)[a].i1 > (*candidates)[b].i1; }
+};
+
+ParallelShortcutter::ParallelShortcutter()
+  :numThreads(4),candidatesPerThread(4),partialDOFProbability(0),
+   numRounds(0),numCandidates(0),numShortcuts(0)
+{}
+
+void ParallelShortcutter::ResetTrace()
+{
+  traceTimes.resize(0);
+  traceLengths.resize(0);
+  traceTimer.Reset();
+}
+
+int ParallelShortcutter::Round(MilestonePath& path)
+{
+  if(traceTimes.empty()) {
+    traceTimes.push_back(traceTimer.ElapsedTime());
+    traceLengths.push_back(path.Length());
+  }
+  int n = (int)path.edges.size();
+  if(n < 2) return 0;
+  if(numThreads < 1) numThreads = 1;
+  int numDofs = path.edges[0]->Start().n;
+
+  //draw the candidates on the calling thread
+  vector<ShortcutCandidate> candidates(BatchSize());
+  for(size_t i=0;i<candidates.size();i++) {
+    ShortcutCandidate& c = candidates[i];
+    c.i1 = rng.randInt(n);
+    c.i2 = rng.randInt(n-1);
+    if(c.i2 >= c.i1) c.i2++;
+    if(c.i2 < c.i1) swap(c.i1,c.i2);
+    c.t1 = rng.randDouble();
+    c.t2 = rng.randDouble();
+    if(partialDOFProbability > 0 && numDofs > 1 && rng.randDouble() < partialDOFProbability) {
+      //a nonempty, proper subset of the entries
+      while(c.dofs.empty() || (int)c.dofs.size() == numDofs) {
+        c.dofs.resize(0);
+        for(int d=0;d<numDofs;d++)
+          if(rng.randInt()%2) c.dofs.push_back(d);
+      }
+    }
+  }
+
+  int numWorkers = Min(numThreads,(int)candidates.size());
+  vector<ShortcutThreadData> data(numWorkers);
+  vector<Thread> threads;
+  threads.reserve(numWorkers);
+  for(int w=0;w<numWorkers;w++) {
+    data[w].path = &path;
+    data[w].candidates = &candidates;
+    data[w].index = w;
+    data[w].stride = numWorkers;
+    if(w > 0) threads.push_back(ThreadStart(ShortcutThreadFunc,&data[w]));
+  }
+  ShortcutThreadFunc(&data[0]);
+  for(size_t i=0;i<threads.size();i++)
+    ThreadJoin(threads[i]);
+  numRounds++;
+  numCandidates += (int)candidates.size();
+
+  //greedily accept the best non-overlapping shortcuts
+  vector<int> order;
+  for(size_t i=0;i<candidates.size();i++)
+    if(candidates[i].feasible) order.push_back((int)i);
+  if(order.empty()) return 0;
+  HigherGain higherGain;
+  higherGain.candidates = &candidates;
+  sort(order.begin(),order.end(),higherGain);
+  vector<int> accepted;
+  for(size_t i=0;i<order.size();i++) {
+    const ShortcutCandidate& c = candidates[order[i]];
+    bool overlap = false;
+    for(size_t j=0;j<accepted.size();j++) {
+      const ShortcutCandidate& d = candidates[accepted[j]];
+      if(c.i1 <= d.i2 && d.i1 <= c.i2) { overlap = true; break; }
+    }
+    if(!overlap) accepted.push_back(order[i]);
+  }
+  //splice from the back so earlier edge indices stay valid
+  LaterStart laterStart;
+  laterStart.candidates = &candidates;
+  sort(accepted.begin(),accepted.end(),laterStart);
+  for(size_t j=0;j<accepted.size();j++) {
+    const ShortcutCandidate& c = candidates[accepted[j]];
+    path.edges.erase(path.edges.begin()+c.i1,path.edges.begin()+c.i2+1);
+    path.edges.insert(path.edges.begin()+c.i1,c.edges.begin(),c.edges.end());
+  }
+  numShortcuts += (int)accepted.size();
+  traceTimes.push_back(traceTimer.ElapsedTime());
+  traceLengths.push_back(path.Length());
+  return (int)accepted.size();
+}
+
+int ParallelShortcutter::Run(MilestonePath& path,Real timeLimit,int maxCandidates,int maxFailedRounds)
+{
+  Timer timer;
+  int num = 0, candidates = 0, failedRounds = 0;
+  while(timer.ElapsedTime() < timeLimit && candidates < maxCandidates && failedRounds < maxFailedRounds) {
+    if(path.edges.size() < 2) break;
+    int n = Round(path);
+    candidates += BatchSize();
+    num += n;
+    if(n == 0) failedRounds++;
+    else failedRounds = 0;
+  }
+  return num;
+}
@@ -0,0 +1,70 @@
+#ifndef PARALLEL_SHORTCUT_H
+#define PARALLEL_SHORTCUT_H
+
+#include "Path.h"
+#include <KrisLibrary/utils/random.h>
+#include <KrisLibrary/Timer.h>
+#include <vector>
+
+/** @ingroup MotionPlanning
+ * @brief Shortcuts a MilestonePath by testing batches of random shortcuts
+ * in parallel threads.
+ *
+ * Each call to Round() draws numThreads*candidatesPerThread random
+ * shortcuts between two points on different edges of the path, and checks
+ * them concurrently.  Of the feasible candidates that shorten the path,
+ * the ones with the largest length reduction are applied first, and any
+ * candidate that overlaps an already-applied one is dropped, so all applied
+ * shortcuts come from the same version of the path.
+ *
+ * With probability partialDOFProbability, a candidate is a partial
+ * shortcut: only a random subset of the configuration entries is moved
+ * along the straight line between the two points, while the others keep
+ * following the original path through its intermediate milestones.  This
+ * helps when some DOFs are constrained by obstacles and others are free.
+ * Partial shortcuts treat configuration entries as independent Cartesian
+ * coordinates, so they should only be enabled for such spaces.
+ *
+ * The candidates are drawn from rng on the calling thread, so the result
+ * for a given seed does not depend on thread timing.  The path's space
+ * must be safe to call concurrently (see ParallelBidirectionalPlanner).
+ *
+ * The length of the path after each round that changes it is recorded in
+ * traceTimes / traceLengths, with times measured from the first round
+ * since ResetTrace().
+ */
+class ParallelShortcutter
+{
+public:
+  ParallelShortcutter();
+  ///Reseeds the candidate generator
+  void Seed(unsigned long seed) { rng.seed(seed); }
+  ///Tests one batch of candidates and applies the compatible ones.
+  ///Returns the number of shortcuts applied.
+  int Round(MilestonePath& path);
+  ///Runs rounds until timeLimit seconds have elapsed, at least maxCandidates
+  ///candidates have been tested, or a round applies no shortcut after
+  ///maxFailedRounds consecutive tries.  Returns the number of shortcuts
+  ///applied.
+  int Run(MilestonePath& path,Real timeLimit,int maxCandidates,int maxFailedRounds=10);
+  ///Clears the convergence trace and restarts its clock
+  void ResetTrace();
+  ///Number of candidates tested per round
+  int BatchSize() const { return numThreads*candidatesPerThread; }
+
+  ///Number of threads (default 4).  If 1, candidates are tested on the
+  ///calling thread
+  int numThreads;
+  ///Candidates tested by each thread per round (default 4)
+  int candidatesPerThread;
+  ///Probability that a candidate is a partial-DOF shortcut (default 0)
+  Real partialDOFProbability;
+  RNG64 rng;
+
+  ///Statistics
+  int numRounds,numCandidates,numShortcuts;
+  std::vector<Real> traceTimes,traceLengths;
+  Timer traceTimer;
+};
+
+#endif
@@ -0,0 +1,296 @@
+#include "ParallelTreePlanner.h"
+#include <graph/Callback.h>
+#include <utils/threadutils.h>
+#include <errors.h>
+#include <stdio.h>
+using namespace std;
+
+struct WorkerThreadData
+{
+  ParallelBidirectionalPlanner* planner;
+  int index;
+};
+
+static void* WorkerThreadFunc(void* vdata)
+{
+  WorkerThreadData* data = (WorkerThreadData*)vdata;
+  data->planner->RunWorker(data->index);
+  return NULL;
+}
+
+ParallelBidirectionalPlanner::ParallelBidirectionalPlanner(CSpace* _space)
+  :space(_space),numThreads(4),itersPerRound(50),seed(0),
+   numIters(0),numRounds(0),solvedWorker(-1),solvedStartWorker(-1),solvedGoalWorker(-1)
+{}
+
+void ParallelBidirectionalPlanner::Cleanup()
+{
+  DeleteWorkers();
+  rngs.clear();
+  workerIters.clear();
+  workerSolved.clear();
+  numIters = numRounds = 0;
+  solvedWorker = solvedStartWorker = solvedGoalWorker = -1;
+}
+
+void ParallelBidirectionalPlanner::Init(const Config& qStart,const Config& qGoal)
+{
+  Cleanup();
+  if(numThreads < 1) numThreads = 1;
+  //stream numThreads is used by the planning thread
+  rngs.resize(numThreads+1);
+  for(int i=0;i<=numThreads;i++)
+    rngs[i].seed(seed,i);
+  workerIters.assign(numThreads,0);
+  workerSolved.assign(numThreads,0);
+  RNG64* oldRng = threadRng;
+  threadRng = &rngs[numThreads];
+  CreateWorkers(qStart,qGoal);
+  threadRng = oldRng;
+}
+
+void ParallelBidirectionalPlanner::RunWorker(int i)
+{
+  RNG64* oldRng = threadRng;
+  threadRng = &rngs[i];
+  for(int k=0;k<itersPerRound;k++) {
+    workerIters[i]++;
+    if(WorkerIterate(i)) {
+      workerSolved[i] = 1;
+      break;
+    }
+  }
+  threadRng = oldRng;
+}
+
+bool ParallelBidirectionalPlanner::PlanRound()
+{
+  if(IsDone()) return true;
+  int n = (int)workerIters.size();
+  if(n == 0) {
+    fprintf(stderr,"ParallelBidirectionalPlanner::PlanRound: Init() must be called first\n");
+    return false;
+  }
+  //worker 0 runs on the calling thread
+  vector<WorkerThreadData> data(n);
+  vector<Thread> threads;
+  threads.reserve(n-1);
+  for(int i=1;i<n;i++) {
+    data[i].planner = this;
+    data[i].index = i;
+    threads.push_back(ThreadStart(WorkerThreadFunc,&data[i]));
+  }
+  RunWorker(0);
+  for(size_t i=0;i<threads.size();i++)
+    ThreadJoin(threads[i]);
+  numRounds++;
+
+  numIters = 0;
+  for(int i=0;i<n;i++) numIters += workerIters[i];
+  for(int i=0;i<n;i++) {
+    if(workerSolved[i]) {
+      solvedWorker = i;
+      return true;
+    }
+  }
+  if(n > 1) {
+    RNG64* oldRng = threadRng;
+    threadRng = &rngs[n];
+    int offset = 1 + (numRounds-1) % (n-1);
+    for(int i=0;i<n;i++) {
+      int j = (i+offset) % n;
+      if(CrossConnect(i,j)) {
+        solvedStartWorker = i;
+        solvedGoalWorker = j;
+        break;
+      }
+    }
+    threadRng = oldRng;
+  }
+  return IsDone();
+}
+
+
+
+ParallelSBLPlanner::ParallelSBLPlanner(CSpace* space)
+  :ParallelBidirectionalPlanner(space),maxExtendDistance(0.2),maxExtendIters(10),edgeConnectionThreshold(Inf),
+   useGrid(true),gridDivision(0.1),numItersPerRandomize(50)
+{}
+
+ParallelSBLPlanner::~ParallelSBLPlanner()
+{
+  Cleanup();
+}
+
+void ParallelSBLPlanner::CreateWorkers(const Config& qStart,const Config& qGoal)
+{
+  workers.resize(numThreads);
+  for(int i=0;i<numThreads;i++) {
+    if(useGrid) {
+      SBLPlannerWithGrid* sbl = new SBLPlannerWithGrid(space);
+      sbl->gridDivision = gridDivision;
+      sbl->numItersPerRandomize = numItersPerRandomize;
+      workers[i] = sbl;
+    }
+    else
+      workers[i] = new SBLPlanner(space);
+    workers[i]->maxExtendDistance = maxExtendDistance;
+    workers[i]->maxExtendIters = maxExtendIters;
+    workers[i]->edgeConnectionThreshold = edgeConnectionThreshold;
+    workers[i]->Init(qStart,qGoal);
+  }
+}
+
+void ParallelSBLPlanner::DeleteWorkers()
+{
+  for(size_t i=0;i<workers.size();i++)
+    delete workers[i];
+  workers.clear();
+  outputPath.clear();
+}
+
+bool ParallelSBLPlanner::WorkerIterate(int i)
+{
+  if(workers[i]->IsDone()) return true;
+  workers[i]->Extend();
+  return workers[i]->IsDone();
+}
+
+bool ParallelSBLPlanner::CrossConnect(int i,int j)
+{
+  SBLTree* ts = workers[i]->tStart;
+  SBLTree* tg = workers[j]->tGoal;
+  SBLTree::Node* ns = ts->PickExpand();
+  if(!ns) return false;
+  SBLTree::Node* ng = workers[j]->PickConnection(tg,*ns);
+  if(!ng) return false;
+  if(!IsInf(edgeConnectionThreshold)) {
+    if(space->Distance(*ns,*ng) > edgeConnectionThreshold) return false;
+  }
+  return SBLTree::CheckPath(ts,ns,tg,ng,outputPath);
+}
+
+void ParallelSBLPlanner::CreatePath(MilestonePath& path)
+{
+  Assert(IsDone());
+  if(solvedWorker >= 0)
+    workers[solvedWorker]->CreatePath(path);
+  else
+    CreateMilestonePath(outputPath,path);
+}
+
+int ParallelSBLPlanner::NumMilestones() const
+{
+  int n = 0;
+  for(size_t i=0;i<workers.size();i++) {
+    Graph::CountCallback<SBLTree::Node*> cb1,cb2;
+    if(workers[i]->tStart && workers[i]->tStart->root)
+      workers[i]->tStart->root->DFS(cb1);
+    if(workers[i]->tGoal && workers[i]->tGoal->root)
+      workers[i]->tGoal->root->DFS(cb2);
+    n += cb1.count+cb2.count;
+  }
+  return n;
+}
+
+
+
+ParallelRRTPlanner::ParallelRRTPlanner(CSpace* space)
+  :ParallelBidirectionalPlanner(space),delta(1),connectionThreshold(Inf),connectStart(NULL),connectGoal(NULL)
+{}
+
+ParallelRRTPlanner::~ParallelRRTPlanner()
+{
+  Cleanup();
+}
+
+void ParallelRRTPlanner::CreateWorkers(const Config& qStart,const Config& qGoal)
+{
+  workers.resize(numThreads);
+  for(int i=0;i<numThreads;i++) {
+    workers[i] = new BidirectionalRRTPlanner(space);
+    workers[i]->delta = delta;
+    workers[i]->connectionThreshold = connectionThreshold;
+    workers[i]->Init(qStart,qGoal);
+  }
+}
+
+void ParallelRRTPlanner::DeleteWorkers()
+{
+  for(size_t i=0;i<workers.size();i++)
+    delete workers[i];
+  workers.clear();
+  connectStart = connectGoal = NULL;
+  connectEdge = NULL;
+}
+
+bool ParallelRRTPlanner::WorkerIterate(int i)
+{
+  return workers[i]->Plan();
+}
+
+bool ParallelRRTPlanner::CrossConnect(int i,int j)
+{
+  BidirectionalRRTPlanner* a = workers[i];
+  BidirectionalRRTPlanner* b = workers[j];
+  int goalComponent = b->milestones[1]->connectedComponent;
+  //pick a random node on b's goal tree, falling back to its root
+  TreeRoadmapPlanner::Node* ng = NULL;
+  for(int k=0;k<10 && !ng;k++) {
+    TreeRoadmapPlanner::Node* n = b->milestones[RandInt(b->milestones.size())];
+    if(n->connectedComponent == goalComponent) ng = n;
+  }
+  if(!ng) ng = b->milestones[1];
+  TreeRoadmapPlanner::Node* ns = a->ClosestMilestoneInComponent(a->milestones[0]->connectedComponent,ng->x);
+  if(!ns) return false;
+  if(!(space->Distance(ns->x,ng->x) < connectionThreshold)) return false;
+  EdgePlanner* e = space->LocalPlanner(ns->x,ng->x);
+  if(!e->IsVisible()) {
+    delete e;
+    return false;
+  }
+  connectStart = ns;
+  connectGoal = ng;
+  connectEdge = e;
+  return true;
+}
+
+//Appends the edges from the root of n's tree to n (if toRoot=false), or
+//from n to the root (if toRoot=true), oriented along the path
+static void AppendTreePath(TreeRoadmapPlanner::Node* n,bool toRoot,MilestonePath& path)
+{
+  vector<SmartPointer<EdgePlanner> > edges;
+  while(n->getParent() != NULL) {
+    const SmartPointer<EdgePlanner>& e = n->edgeFromParent();
+    //edges may be oriented either way after rerooting
+    bool towardParent = (e->Start() == n->x);
+    if(towardParent == toRoot) edges.push_back(e);
+    else edges.push_back(e->ReverseCopy());
+    n = n->getParent();
+  }
+  if(toRoot)
+    path.edges.insert(path.edges.end(),edges.begin(),edges.end());
+  else
+    path.edges.insert(path.edges.end(),edges.rbegin(),edges.rend());
+}
+
+void ParallelRRTPlanner::CreatePath(MilestonePath& path)
+{
+  Assert(IsDone());
+  if(solvedWorker >= 0) {
+    workers[solvedWorker]->CreatePath(path);
+    return;
+  }
+  path.edges.resize(0);
+  AppendTreePath(connectStart,false,path);
+  path.edges.push_back(connectEdge);
+  AppendTreePath(connectGoal,true,path);
+}
+
+int ParallelRRTPlanner::NumMilestones() const
+{
+  int n = 0;
+  for(size_t i=0;i<workers.size();i++)
+    n += (int)workers[i]->milestones.size();
+  return n;
+}
@@ -0,0 +1,142 @@
+#ifndef PARALLEL_TREE_PLANNER_H
+#define PARALLEL_TREE_PLANNER_H
+
+#include "MotionPlanner.h"
+#include "SBL.h"
+#include <KrisLibrary/math/random.h>
+#include <vector>
+
+/** @ingroup MotionPlanning
+ * @brief Base class for planners that grow several pairs of start / goal
+ * trees in parallel threads, and merge them by cross-connections.
+ *
+ * Each of the numThreads workers owns a complete bidirectional planner
+ * (two trees rooted at the start and goal) and its own random number stream,
+ * seeded from (seed,worker index).  Planning proceeds in rounds.  In each
+ * round, every worker performs itersPerRound iterations on its own thread,
+ * stopping early only if it finds a solution by itself.  Between rounds,
+ * the calling thread attempts to connect each worker's start tree to
+ * another worker's goal tree, rotating the partner every round.
+ *
+ * Because the workers never touch each others' trees during a round, and
+ * the cross-connections are made in a fixed order, the result for a given
+ * seed does not depend on thread timing.  If several workers solve the
+ * problem in the same round, the lowest-index one is used.
+ *
+ * The CSpace is shared between the workers, so its Sample, IsFeasible,
+ * LocalPlanner, and Distance methods, and the edge planners that it
+ * returns, must be safe to call concurrently.  Random numbers must be drawn
+ * through the Math random functions (see Math::threadRng) rather than
+ * rand().
+ *
+ * Threads are started for each round, so itersPerRound should be large
+ * enough to amortize thread creation (a few tens of microseconds).
+ */
+class ParallelBidirectionalPlanner
+{
+public:
+  ParallelBidirectionalPlanner(CSpace* space);
+  virtual ~ParallelBidirectionalPlanner() {}
+  ///Deletes the workers.  Subclasses must call this from their destructors
+  virtual void Cleanup();
+  ///Creates numThreads workers with the given start and goal
+  void Init(const Config& qStart,const Config& qGoal);
+  ///Runs one round of planning.  Returns true if a solution was found
+  bool PlanRound();
+  bool IsDone() const { return solvedWorker >= 0 || (solvedStartWorker >= 0 && solvedGoalWorker >= 0); }
+  virtual void CreatePath(MilestonePath& path)=0;
+  virtual int NumMilestones() const=0;
+
+  //subclasses implement these
+  virtual void CreateWorkers(const Config& qStart,const Config& qGoal)=0;
+  virtual void DeleteWorkers()=0;
+  ///Performs one iteration of worker i, returns true if it has solved the
+  ///problem.  Called from worker i's thread.
+  virtual bool WorkerIterate(int i)=0;
+  ///Attempts to connect worker i's start tree to worker j's goal tree.
+  ///Called from the planning thread between rounds.
+  virtual bool CrossConnect(int i,int j)=0;
+
+  //helper: runs worker i's iterations for this round
+  void RunWorker(int i);
+
+  CSpace* space;
+  ///Number of worker threads (default 4)
+  int numThreads;
+  ///Iterations per worker per round (default 50)
+  int itersPerRound;
+  ///Seed for the random number streams (default 0)
+  unsigned long seed;
+
+  std::vector<RNG64> rngs;
+  ///Per-worker iteration counts and solved flags
+  std::vector<int> workerIters,workerSolved;
+  int numIters,numRounds;
+  ///Set to the index of a worker that solves the problem by itself
+  int solvedWorker;
+  ///Set if the problem is solved by a cross-connection
+  int solvedStartWorker,solvedGoalWorker;
+};
+
+/** @ingroup MotionPlanning
+ * @brief A parallel SBL planner.  See ParallelBidirectionalPlanner.
+ *
+ * Each worker is an SBLPlanner (or SBLPlannerWithGrid, if useGrid is true).
+ * Cross-connections use SBLTree::CheckPath, so trees may exchange subtrees
+ * just as in SBL.
+ */
+class ParallelSBLPlanner : public ParallelBidirectionalPlanner
+{
+public:
+  ParallelSBLPlanner(CSpace* space);
+  virtual ~ParallelSBLPlanner();
+  virtual void CreatePath(MilestonePath& path);
+  virtual int NumMilestones() const;
+  virtual void CreateWorkers(const Config& qStart,const Config& qGoal);
+  virtual void DeleteWorkers();
+  virtual bool WorkerIterate(int i);
+  virtual bool CrossConnect(int i,int j);
+
+  //SBL parameters, see SBLPlanner and SBLPlannerWithGrid
+  Real maxExtendDistance;
+  int maxExtendIters;
+  Real edgeConnectionThreshold;
+  bool useGrid;
+  Real gridDivision;
+  int numItersPerRandomize;
+
+  std::vector<SBLPlanner*> workers;
+  std::list<SBLPlanner::EdgeInfo> outputPath;
+};
+
+/** @ingroup MotionPlanning
+ * @brief A parallel bidirectional RRT planner.  See
+ * ParallelBidirectionalPlanner.
+ *
+ * Cross-connections are attempted between a randomly chosen node of one
+ * worker's goal tree and the closest node of another worker's start tree,
+ * if they are within connectionThreshold.
+ */
+class ParallelRRTPlanner : public ParallelBidirectionalPlanner
+{
+public:
+  ParallelRRTPlanner(CSpace* space);
+  virtual ~ParallelRRTPlanner();
+  virtual void CreatePath(MilestonePath& path);
+  virtual int NumMilestones() const;
+  virtual void CreateWorkers(const Config& qStart,const Config& qGoal);
+  virtual void DeleteWorkers();
+  virtual bool WorkerIterate(int i);
+  virtual bool CrossConnect(int i,int j);
+
+  //RRT parameters, see BidirectionalRRTPlanner
+  Real delta;
+  Real connectionThreshold;
+
+  std::vector<BidirectionalRRTPlanner*> workers;
+  ///Cross-connection nodes and edge, if solved by a cross-connection
+  TreeRoadmapPlanner::Node *connectStart,*connectGoal;
+  SmartPointer<EdgePlanner> connectEdge;
+};
+
+#endif
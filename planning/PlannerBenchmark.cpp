@@ -0,0 +1,474 @@
+#include "PlannerBenchmark.h"
+#include "ProfiledCSpace.h"
+#include <math/random.h>
+#include <utils/AnyCollection.h>
+#include <utils/fileutils.h>
+#include <errors.h>
+#include <Timer.h>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif //_WIN32
+
+static long PeakMemoryKB()
+{
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF,&usage) != 0) return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss/1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif //_WIN32
+}
+
+static void WriteFinite(AnyCollection& items,const char* name,Real value)
+{
+  //non-finite values are not valid JSON, so they are simply omitted
+  if(IsFinite(value)) items[name] = double(value);
+}
+
+static string SubCollectionToString(const AnyCollection& items)
+{
+  stringstream ss;
+  items.write_inline(ss);
+  return ss.str();
+}
+
+MotionPlanningBenchmarkResult::MotionPlanningBenchmarkResult()
+  :seed(0),timeToFirstSolution(Inf),cost(Inf),totalTime(0),numIters(0),numMilestones(0),
+   numSamples(0),numFeasibilityChecks(0),numLocalPlannerCalls(0),numEdgeChecks(0),peakMemory(0)
+{}
+
+bool MotionPlanningBenchmarkResult::LoadJSON(const string& str)
+{
+  AnyCollection items;
+  if(!items.read(str.c_str())) return false;
+  if(!items["problem"].as(problem)) return false;
+  //JSON-valued fields are stored as sub-collections rather than as escaped
+  //strings, so that the output stays readable
+  if(!items["planner"].collection()) return false;
+  planner = SubCollectionToString(items["planner"]);
+  items["seed"].as(seed);
+  items["terminationReason"].as(terminationReason);
+  if(!items["timeToFirstSolution"].as(timeToFirstSolution)) timeToFirstSolution = Inf;
+  if(!items["cost"].as(cost)) cost = Inf;
+  items["totalTime"].as(totalTime);
+  items["numIters"].as(numIters);
+  items["numMilestones"].as(numMilestones);
+  items["numSamples"].as(numSamples);
+  items["numFeasibilityChecks"].as(numFeasibilityChecks);
+  items["numLocalPlannerCalls"].as(numLocalPlannerCalls);
+  items["numEdgeChecks"].as(numEdgeChecks);
+  int mem;
+  if(items["peakMemory"].as(mem)) peakMemory = mem;
+  traceTimes.resize(0);
+  traceCosts.resize(0);
+  items["traceTimes"].asvector(traceTimes);
+  items["traceCosts"].asvector(traceCosts);
+  if(traceTimes.size() != traceCosts.size()) return false;
+  stats.clear();
+  vector<AnyKeyable> keys;
+  items["stats"].enumerate_keys(keys);
+  for(size_t i=0;i<keys.size();i++) {
+    string key,value;
+    if(!LexicalCast(keys[i].value,key)) return false;
+    if(!items["stats"][keys[i]].as(value)) return false;
+    stats[key] = value;
+  }
+  return true;
+}
+
+string MotionPlanningBenchmarkResult::SaveJSON() const
+{
+  AnyCollection items;
+  items["problem"] = problem;
+  AnyCollection plannerItems;
+  if(!plannerItems.read(planner.c_str())) plannerItems = AnyCollection();
+  items["planner"] = plannerItems;
+  items["seed"] = seed;
+  items["terminationReason"] = terminationReason;
+  WriteFinite(items,"timeToFirstSolution",timeToFirstSolution);
+  WriteFinite(items,"cost",cost);
+  items["totalTime"] = double(totalTime);
+  items["numIters"] = numIters;
+  items["numMilestones"] = numMilestones;
+  items["numSamples"] = numSamples;
+  items["numFeasibilityChecks"] = numFeasibilityChecks;
+  items["numLocalPlannerCalls"] = numLocalPlannerCalls;
+  items["numEdgeChecks"] = numEdgeChecks;
+  items["peakMemory"] = int(peakMemory);
+  vector<double> times(traceTimes.begin(),traceTimes.end()),costs(traceCosts.begin(),traceCosts.end());
+  items["traceTimes"] = times;
+  items["traceCosts"] = costs;
+  AnyCollection statItems;
+  for(PropertyMap::const_iterator i=stats.begin();i!=stats.end();i++)
+    statItems[i->first.c_str()] = i->second;
+  items["stats"] = statItems;
+  return SubCollectionToString(items);
+}
+
+MotionPlanningBenchmark::MotionPlanningBenchmark()
+  :numSeeds(10),firstSeed(0),numProcesses(1),traceResolution(0.1)
+{}
+
+void MotionPlanningBenchmark::AllPlannerTypes(vector<string>& types)
+{
+  types.resize(0);
+  types.push_back("prm");
+  types.push_back("sbl");
+  types.push_back("sblprt");
+  types.push_back("rrt");
+  types.push_back("prm*");
+  types.push_back("rrt*");
+  types.push_back("lazyprm*");
+  types.push_back("lazyrrg*");
+  types.push_back("fmm");
+  types.push_back("fmm*");
+}
+
+bool MotionPlanningBenchmark::LoadSuite(const char* fn)
+{
+  ifstream in(fn,ios::in);
+  if(!in) {
+    fprintf(stderr,"MotionPlanningBenchmark::LoadSuite: could not open %s\n",fn);
+    return false;
+  }
+  stringstream ss;
+  ss<<in.rdbuf();
+  return LoadSuiteJSON(ss.str());
+}
+
+bool MotionPlanningBenchmark::LoadSuiteJSON(const string& str)
+{
+  AnyCollection items;
+  if(!items.read(str.c_str())) {
+    fprintf(stderr,"MotionPlanningBenchmark::LoadSuiteJSON: parse error\n");
+    return false;
+  }
+  items["seeds"].as(numSeeds);
+  items["processes"].as(numProcesses);
+  items["traceResolution"].as(traceResolution);
+  const AnyCollection& pitems = items["problems"];
+  if(!pitems.isarray()) {
+    fprintf(stderr,"MotionPlanningBenchmark::LoadSuiteJSON: \"problems\" must be an array\n");
+    return false;
+  }
+  for(size_t i=0;i<pitems.size();i++) {
+    const AnyCollection& p = pitems[(int)i];
+    MotionPlanningBenchmarkProblem problem;
+    if(!p["name"].as(problem.name)) {
+      stringstream ss;
+      ss<<"problem"<<i;
+      problem.name = ss.str();
+    }
+    if(!p["space"].as(problem.spaceName)) {
+      fprintf(stderr,"MotionPlanningBenchmark::LoadSuiteJSON: problem %s does not specify a space\n",problem.name.c_str());
+      return false;
+    }
+    vector<double> start,goal;
+    if(!p["start"].asvector(start) || !p["goal"].asvector(goal)) {
+      fprintf(stderr,"MotionPlanningBenchmark::LoadSuiteJSON: problem %s needs a start and goal\n",problem.name.c_str());
+      return false;
+    }
+    problem.problem.qstart = start;
+    problem.problem.qgoal = goal;
+    if(p["termCond"].collection()) {
+      if(!problem.termCond.LoadJSON(SubCollectionToString(p["termCond"]))) {
+        fprintf(stderr,"MotionPlanningBenchmark::LoadSuiteJSON: problem %s has an invalid termCond\n",problem.name.c_str());
+        return false;
+      }
+    }
+    const AnyCollection& planners = p["planners"];
+    for(size_t j=0;j<planners.size();j++) {
+      string pstr = SubCollectionToString(planners[(int)j]);
+      MotionPlannerFactory factory;
+      if(!factory.LoadJSON(pstr)) {
+        fprintf(stderr,"MotionPlanningBenchmark::LoadSuiteJSON: problem %s, invalid planner %s\n",problem.name.c_str(),pstr.c_str());
+        return false;
+      }
+      problem.planners.push_back(pstr);
+    }
+    problems.push_back(problem);
+  }
+  return true;
+}
+
+void MotionPlanningBenchmark::RunOne(const MotionPlanningBenchmarkProblem& problem,const string& plannerString,int seed,Real traceResolution,MotionPlanningBenchmarkResult& result)
+{
+  result = MotionPlanningBenchmarkResult();
+  result.problem = problem.name;
+  result.planner = plannerString;
+  result.seed = seed;
+  Srand(seed);
+
+  MotionPlannerFactory factory;
+  if(!factory.LoadJSON(plannerString)) {
+    result.terminationReason = "error";
+    return;
+  }
+  //The factory's planners do not expose their point locators, so
+  //nearest-neighbor queries are not profiled separately; their Distance
+  //calls on the space are still counted
+  ProfiledCSpace space(problem.problem.space);
+  MotionPlanningProblem instrumented = problem.problem;
+  instrumented.space = &space;
+  MotionPlannerInterface* planner = factory.Create(instrumented);
+  if(!planner) {
+    result.terminationReason = "error";
+    return;
+  }
+
+  const HaltingCondition& cond = problem.termCond;
+  MilestonePath path;
+  bool foundPath = false;
+  Real lastCheckTime = 0, lastCheckValue = 0;
+  Real lastTraceTime = 0;
+  result.terminationReason = "maxIters";
+  Timer timer;
+  for(int iters=0;iters<cond.maxIters;iters++) {
+    Real t=timer.ElapsedTime();
+    if(t > cond.timeLimit) {
+      result.terminationReason = "timeLimit";
+      break;
+    }
+    if(foundPath && t > lastCheckTime + cond.costImprovementPeriod) {
+      planner->GetSolution(path);
+      Real len = path.Length();
+      if(len < cond.costThreshold) {
+        result.terminationReason = "costThreshold";
+        break;
+      }
+      if(lastCheckValue - len < cond.costImprovementThreshold) {
+        result.terminationReason = "costImprovementThreshold";
+        break;
+      }
+      lastCheckTime = t;
+      lastCheckValue = len;
+    }
+    planner->PlanMore();
+    if(!planner->IsSolved()) continue;
+    t = timer.ElapsedTime();
+    if(!foundPath) {
+      foundPath = true;
+      result.timeToFirstSolution = t;
+      planner->GetSolution(path);
+      lastCheckTime = lastTraceTime = t;
+      lastCheckValue = result.cost = path.Length();
+      result.traceTimes.push_back(t);
+      result.traceCosts.push_back(result.cost);
+      if(cond.foundSolution) {
+        result.terminationReason = "foundSolution";
+        break;
+      }
+    }
+    else if(t > lastTraceTime + traceResolution) {
+      //path extraction can be expensive, so only sample the cost periodically
+      planner->GetSolution(path);
+      Real len = path.Length();
+      lastTraceTime = t;
+      if(len < result.cost) {
+        result.cost = len;
+        result.traceTimes.push_back(t);
+        result.traceCosts.push_back(len);
+      }
+    }
+  }
+  result.totalTime = timer.ElapsedTime();
+  if(foundPath) {
+    planner->GetSolution(path);
+    Real len = path.Length();
+    if(len < result.cost) {
+      result.cost = len;
+      result.traceTimes.push_back(result.totalTime);
+      result.traceCosts.push_back(len);
+    }
+  }
+  result.numIters = planner->NumIterations();
+  result.numMilestones = planner->NumMilestones();
+  planner->GetStats(result.stats);
+  delete planner;
+  space.GetStats(result.stats);
+  result.numSamples = (int)(space.profiles[ProfiledCSpace::CallSample].Count()+space.profiles[ProfiledCSpace::CallSampleNeighborhood].Count());
+  result.numFeasibilityChecks = (int)space.profiles[ProfiledCSpace::CallIsFeasible].Count();
+  result.numLocalPlannerCalls = (int)space.profiles[ProfiledCSpace::CallLocalPlanner].Count();
+  result.numEdgeChecks = (int)space.profiles[ProfiledCSpace::CallIsVisible].Count();
+  result.peakMemory = PeakMemoryKB();
+}
+
+struct BenchmarkJob
+{
+  int problem;
+  string planner;
+  int seed;
+};
+
+void MotionPlanningBenchmark::Run()
+{
+  vector<BenchmarkJob> jobs;
+  vector<string> defaultPlanners;
+  AllPlannerTypes(defaultPlanners);
+  for(size_t i=0;i<defaultPlanners.size();i++) {
+    AnyCollection items;
+    items["type"] = defaultPlanners[i];
+    defaultPlanners[i] = SubCollectionToString(items);
+  }
+  for(size_t i=0;i<problems.size();i++) {
+    if(!problems[i].problem.space) {
+      if(spaces.count(problems[i].spaceName) == 0) {
+        fprintf(stderr,"MotionPlanningBenchmark::Run: space %s of problem %s is not registered, skipping\n",problems[i].spaceName.c_str(),problems[i].name.c_str());
+        continue;
+      }
+      problems[i].problem.space = spaces[problems[i].spaceName];
+    }
+    const vector<string>& planners = (problems[i].planners.empty() ? defaultPlanners : problems[i].planners);
+    for(size_t j=0;j<planners.size();j++) {
+      for(int k=0;k<numSeeds;k++) {
+        BenchmarkJob job;
+        job.problem = (int)i;
+        job.planner = planners[j];
+        job.seed = firstSeed+k;
+        jobs.push_back(job);
+      }
+    }
+  }
+
+  results.resize(jobs.size());
+#ifdef _WIN32
+  for(size_t i=0;i<jobs.size();i++)
+    RunOne(problems[jobs[i].problem],jobs[i].planner,jobs[i].seed,traceResolution,results[i]);
+#else
+  if(numProcesses <= 1) {
+    for(size_t i=0;i<jobs.size();i++)
+      RunOne(problems[jobs[i].problem],jobs[i].planner,jobs[i].seed,traceResolution,results[i]);
+    return;
+  }
+  //each child writes its result to a temp file, which the parent collects
+  map<pid_t,pair<int,string> > running;
+  size_t next = 0;
+  while(next < jobs.size() || !running.empty()) {
+    while(next < jobs.size() && (int)running.size() < numProcesses) {
+      const BenchmarkJob& job = jobs[next];
+      char fn[1024];
+      if(!FileUtils::TempName(fn,NULL,"bnch")) {
+        fprintf(stderr,"MotionPlanningBenchmark::Run: could not create temp file, running in-process\n");
+        RunOne(problems[job.problem],job.planner,job.seed,traceResolution,results[next]);
+        next++;
+        continue;
+      }
+      fflush(stdout);
+      fflush(stderr);
+      pid_t pid = fork();
+      if(pid < 0) {
+        fprintf(stderr,"MotionPlanningBenchmark::Run: error forking process, running in-process\n");
+        FileUtils::Delete(fn);
+        RunOne(problems[job.problem],job.planner,job.seed,traceResolution,results[next]);
+      }
+      else if(pid == 0) { //child process
+        MotionPlanningBenchmarkResult result;
+        RunOne(problems[job.problem],job.planner,job.seed,traceResolution,result);
+        ofstream out(fn,ios::out);
+        out<<result.SaveJSON()<<endl;
+        out.close();
+        fflush(stdout);
+        fflush(stderr);
+        _exit(out ? 0 : 1);
+      }
+      else
+        running[pid] = pair<int,string>((int)next,string(fn));
+      next++;
+    }
+    if(running.empty()) continue;
+    int status;
+    pid_t pid = wait(&status);
+    if(pid < 0) {
+      fprintf(stderr,"MotionPlanningBenchmark::Run: wait failed\n");
+      break;
+    }
+    if(running.count(pid) == 0) continue;
+    int index = running[pid].first;
+    string fn = running[pid].second;
+    running.erase(pid);
+    const BenchmarkJob& job = jobs[index];
+    MotionPlanningBenchmarkResult& result = results[index];
+    ifstream in(fn.c_str(),ios::in);
+    stringstream ss;
+    if(in) ss<<in.rdbuf();
+    in.close();
+    FileUtils::Delete(fn.c_str());
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !result.LoadJSON(ss.str())) {
+      fprintf(stderr,"MotionPlanningBenchmark::Run: run of %s on %s, seed %d crashed\n",job.planner.c_str(),problems[job.problem].name.c_str(),job.seed);
+      result = MotionPlanningBenchmarkResult();
+      result.problem = problems[job.problem].name;
+      result.planner = job.planner;
+      result.seed = job.seed;
+      result.terminationReason = "error";
+    }
+  }
+#endif //_WIN32
+}
+
+//quotes a CSV field, escaping quotes by doubling them
+static string CSVQuote(const string& str)
+{
+  string res = "\"";
+  for(size_t i=0;i<str.size();i++) {
+    if(str[i]=='"') res += '"';
+    res += str[i];
+  }
+  res += '"';
+  return res;
+}
+
+bool MotionPlanningBenchmark::SaveCSV(const char* fn) const
+{
+  ofstream out(fn,ios::out);
+  if(!out) return false;
+  out<<"run,problem,planner,seed,terminationReason,timeToFirstSolution,cost,totalTime,numIters,numMilestones,numSamples,numFeasibilityChecks,numLocalPlannerCalls,numEdgeChecks,peakMemory"<<endl;
+  for(size_t i=0;i<results.size();i++) {
+    const MotionPlanningBenchmarkResult& r = results[i];
+    out<<i<<","<<CSVQuote(r.problem)<<","<<CSVQuote(r.planner)<<","<<r.seed<<","<<r.terminationReason<<",";
+    if(IsFinite(r.timeToFirstSolution)) out<<r.timeToFirstSolution;
+    out<<",";
+    if(IsFinite(r.cost)) out<<r.cost;
+    out<<","<<r.totalTime<<","<<r.numIters<<","<<r.numMilestones<<","<<r.numSamples<<","<<r.numFeasibilityChecks<<","<<r.numLocalPlannerCalls<<","<<r.numEdgeChecks<<","<<r.peakMemory<<endl;
+  }
+  return true;
+}
+
+bool MotionPlanningBenchmark::SaveTraceCSV(const char* fn) const
+{
+  ofstream out(fn,ios::out);
+  if(!out) return false;
+  out<<"run,problem,planner,seed,time,cost"<<endl;
+  for(size_t i=0;i<results.size();i++) {
+    const MotionPlanningBenchmarkResult& r = results[i];
+    string problem = CSVQuote(r.problem), planner = CSVQuote(r.planner);
+    for(size_t j=0;j<r.traceTimes.size();j++)
+      out<<i<<","<<problem<<","<<planner<<","<<r.seed<<","<<r.traceTimes[j]<<","<<r.traceCosts[j]<<endl;
+  }
+  return true;
+}
+
+bool MotionPlanningBenchmark::SaveJSON(const char* fn) const
+{
+  ofstream out(fn,ios::out);
+  if(!out) return false;
+  out<<"["<<endl;
+  for(size_t i=0;i<results.size();i++) {
+    out<<results[i].SaveJSON();
+    if(i+1 < results.size()) out<<",";
+    out<<endl;
+  }
+  out<<"]"<<endl;
+  return true;
+}
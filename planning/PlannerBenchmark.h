@@ -0,0 +1,143 @@
+#ifndef PLANNER_BENCHMARK_H
+#define PLANNER_BENCHMARK_H
+
+#include "AnyMotionPlanner.h"
+#include <KrisLibrary/utils/PropertyMap.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/** @ingroup MotionPlanning
+ * @brief A single problem in a MotionPlanningBenchmark suite.
+ *
+ * The CSpace is referenced by name so that suites can be loaded from disk;
+ * the name is resolved against MotionPlanningBenchmark::spaces.
+ */
+struct MotionPlanningBenchmarkProblem
+{
+  std::string name;
+  std::string spaceName;
+  ///The problem to solve.  The space member is filled in from spaceName
+  ///when the suite is run, unless it is already non-NULL.
+  MotionPlanningProblem problem;
+  HaltingCondition termCond;
+  ///MotionPlannerFactory JSON strings.  If empty, all planner types are run
+  std::vector<std::string> planners;
+};
+
+/** @ingroup MotionPlanning
+ * @brief The outcome of a single (problem,planner,seed) benchmark run.
+ *
+ * The counts of Sample, IsFeasible, LocalPlanner and edge IsVisible calls are
+ * measured at the top-level CSpace given to the planner.  Feasibility checks
+ * made internally by the base space's edge planners are not included in
+ * numFeasibilityChecks, but each edge check is counted in numEdgeChecks.
+ *
+ * peakMemory is the peak resident set size in KB.  It is only per-run when
+ * the benchmark is run in multiple processes; otherwise it is the peak of
+ * the calling process.
+ */
+struct MotionPlanningBenchmarkResult
+{
+  MotionPlanningBenchmarkResult();
+  ///Conversions to/from a JSON string
+  bool LoadJSON(const std::string& str);
+  std::string SaveJSON() const;
+
+  std::string problem;
+  std::string planner;
+  int seed;
+  ///The HaltingCondition attribute that caused termination, or "error"
+  std::string terminationReason;
+  ///Time at which the first solution was found (Inf if never)
+  Real timeToFirstSolution;
+  ///Cost of the final solution (Inf if none)
+  Real cost;
+  Real totalTime;
+  int numIters;
+  int numMilestones;
+  int numSamples;
+  int numFeasibilityChecks;
+  int numLocalPlannerCalls;
+  int numEdgeChecks;
+  long peakMemory;
+  ///Solution cost over time, sampled every traceResolution seconds and
+  ///whenever the cost improves
+  std::vector<Real> traceTimes,traceCosts;
+  ///Planner-specific statistics from MotionPlannerInterface::GetStats, plus
+  ///the per-call profile from ProfiledCSpace::GetStats ("profile.*" keys).
+  ///The profile has no NearestNeighbors entry, since the factory's planners
+  ///do not expose their point locators for wrapping.
+  PropertyMap stats;
+};
+
+/** @ingroup MotionPlanning
+ * @brief Runs a suite of motion planning problems over a set of planners
+ * and random seeds, and records timing, cost, and call count statistics.
+ *
+ * Usage:
+ * @verbatim
+ * MotionPlanningBenchmark bench;
+ * bench.spaces["maze"] = &myMazeSpace;
+ * bench.LoadSuite("suite.json");
+ * bench.numSeeds = 10;
+ * bench.numProcesses = 8;
+ * bench.Run();
+ * bench.SaveCSV("results.csv");
+ * bench.SaveJSON("results.json");
+ * @endverbatim
+ *
+ * The suite file is a JSON object of the form
+ * @verbatim
+ * {"seeds":10, "processes":4,
+ *  "problems":[
+ *    {"name":"maze1", "space":"maze", "start":[0.1,0.1], "goal":[0.9,0.9],
+ *     "termCond":{"foundSolution":0,"timeLimit":5},
+ *     "planners":[{"type":"rrt"},{"type":"sbl","perturbationRadius":0.2}]}
+ *  ]}
+ * @endverbatim
+ * where "seeds", "processes", "termCond", and "planners" are optional.  If
+ * "planners" is omitted, every type returned by AllPlannerTypes() is run with
+ * default parameters.
+ *
+ * On non-Windows systems each run is executed in a forked child process so
+ * that runs are isolated from each other's crashes and memory, and up to
+ * numProcesses runs execute concurrently.  The results are always reported
+ * in a deterministic (problem,planner,seed) order.
+ */
+class MotionPlanningBenchmark
+{
+ public:
+  MotionPlanningBenchmark();
+  ///Returns the names of all non-OMPL planner types that the
+  ///MotionPlannerFactory supports
+  static void AllPlannerTypes(std::vector<std::string>& types);
+  ///Loads a problem suite from a JSON file / string
+  bool LoadSuite(const char* fn);
+  bool LoadSuiteJSON(const std::string& str);
+  ///Runs all problems, planners, and seeds, and fills out results
+  void Run();
+  ///Runs a single planner on a single problem in this process
+  static void RunOne(const MotionPlanningBenchmarkProblem& problem,const std::string& planner,int seed,Real traceResolution,MotionPlanningBenchmarkResult& result);
+  ///Saves one row per run.  The run column is the index into results
+  bool SaveCSV(const char* fn) const;
+  ///Saves one row per cost trace sample, keyed by the same run index as
+  ///SaveCSV
+  bool SaveTraceCSV(const char* fn) const;
+  ///Saves all results, including traces and planner stats
+  bool SaveJSON(const char* fn) const;
+
+  std::map<std::string,CSpace*> spaces;
+  std::vector<MotionPlanningBenchmarkProblem> problems;
+  ///Number of random seeds per (problem,planner) pair (default 10)
+  int numSeeds;
+  ///Seeds are firstSeed,...,firstSeed+numSeeds-1 (default 0)
+  int firstSeed;
+  ///Maximum number of concurrent processes (default 1)
+  int numProcesses;
+  ///Spacing of cost trace samples, in seconds (default 0.1)
+  Real traceResolution;
+  std::vector<MotionPlanningBenchmarkResult> results;
+};
+
+#endif
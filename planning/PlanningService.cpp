@@ -0,0 +1,367 @@
+#include "PlanningService.h"
+#include <math/random.h>
+#include <utils/AnyCollection.h>
+#include <utils/AsyncIO.h>
+#include <Timer.h>
+#include <sstream>
+#include <stdio.h>
+using namespace std;
+
+static string CollectionToString(const AnyCollection& items)
+{
+  stringstream ss;
+  items.write_inline(ss);
+  return ss.str();
+}
+
+static string StatusMessage(int id,const char* status)
+{
+  AnyCollection items;
+  items["id"] = id;
+  items["status"] = status;
+  return CollectionToString(items);
+}
+
+static string ErrorMessage(int id,const string& message)
+{
+  AnyCollection items;
+  items["id"] = id;
+  items["status"] = "error";
+  items["message"] = message;
+  return CollectionToString(items);
+}
+
+static void PathToCollection(const MilestonePath& path,AnyCollection& items)
+{
+  items.resize(path.NumMilestones());
+  for(int i=0;i<path.NumMilestones();i++) {
+    const Config& q = path.GetMilestone(i);
+    vector<double> v(q.n);
+    for(int j=0;j<q.n;j++) v[j] = q(j);
+    items[i] = v;
+  }
+}
+
+struct ServiceThreadData
+{
+  PlanningService* service;
+  int index;
+};
+
+static void* ServiceThreadFunc(void* vdata)
+{
+  ServiceThreadData* data = (ServiceThreadData*)vdata;
+  data->service->RunWorker(data->index);
+  delete data;
+  return NULL;
+}
+
+PlanningService::PlanningService()
+  :numWorkers(4),progressPeriod(0.5),cancelCheckPeriod(0.01),
+   running(false),serving(false),nextId(0),
+   numSubmitted(0),numCompleted(0),numCancelled(0)
+{}
+
+PlanningService::~PlanningService()
+{
+  Stop();
+}
+
+bool PlanningService::Start()
+{
+  if(running) return true;
+  if(numWorkers < 1) numWorkers = 1;
+  running = true;
+  rngs.resize(numWorkers);
+  for(int i=0;i<numWorkers;i++) {
+    ServiceThreadData* data = new ServiceThreadData;
+    data->service = this;
+    data->index = i;
+    threads.push_back(ThreadStart(ServiceThreadFunc,data));
+  }
+  return true;
+}
+
+void PlanningService::Stop()
+{
+  serving = false;
+  {
+    ScopedLock lock(mutex);
+    if(!running) return;
+    running = false;
+    for(list<Job>::iterator i=queue.begin();i!=queue.end();i++) {
+      outbox.push_back(StatusMessage(i->id,"cancelled"));
+      active.erase(i->id);
+      numCancelled++;
+    }
+    queue.clear();
+    //the running requests stop at their next cancellation check
+    cancelled = active;
+  }
+  for(size_t i=0;i<threads.size();i++)
+    ThreadJoin(threads[i]);
+  threads.resize(0);
+}
+
+int PlanningService::Submit(const string& request)
+{
+  AnyCollection items;
+  if(!items.read(request.c_str())) {
+    ScopedLock lock(mutex);
+    outbox.push_back(ErrorMessage(-1,"Unable to parse request"));
+    return -1;
+  }
+  Job job;
+  bool hasId = items["id"].as(job.id);
+  {
+    ScopedLock lock(mutex);
+    if(!hasId) job.id = nextId;
+    nextId = Max(nextId,job.id+1);
+  }
+  string error;
+  string spaceName;
+  vector<double> start,goal;
+  if(!items["space"].as(spaceName) || spaces.count(spaceName) == 0)
+    error = "Request does not name a known space";
+  else if(!items["start"].asvector(start) || !items["goal"].asvector(goal))
+    error = "Request needs a start and goal";
+  else if(items["termCond"].collection() && !job.termCond.LoadJSON(CollectionToString(items["termCond"])))
+    error = "Invalid termCond";
+  else if(items["planner"].collection()) {
+    job.planner = CollectionToString(items["planner"]);
+    MotionPlannerFactory factory;
+    if(!factory.LoadJSON(job.planner))
+      error = "Invalid planner";
+  }
+  if(!error.empty()) {
+    ScopedLock lock(mutex);
+    outbox.push_back(ErrorMessage(job.id,error));
+    return -1;
+  }
+  job.space = spaces[spaceName];
+  job.start = start;
+  job.goal = goal;
+  int seed;
+  if(items["seed"].as(seed)) job.seed = (unsigned long)seed;
+  else job.seed = (unsigned long)job.id;
+
+  ScopedLock lock(mutex);
+  if(active.count(job.id) != 0) {
+    outbox.push_back(ErrorMessage(job.id,"Request id is already in use"));
+    return -1;
+  }
+  active.insert(job.id);
+  queue.push_back(job);
+  numSubmitted++;
+  return job.id;
+}
+
+bool PlanningService::Cancel(int id)
+{
+  ScopedLock lock(mutex);
+  if(active.count(id) == 0) return false;
+  for(list<Job>::iterator i=queue.begin();i!=queue.end();i++) {
+    if(i->id == id) {
+      queue.erase(i);
+      active.erase(id);
+      outbox.push_back(StatusMessage(id,"cancelled"));
+      numCancelled++;
+      return true;
+    }
+  }
+  cancelled.insert(id);
+  return true;
+}
+
+bool PlanningService::Handle(const string& message)
+{
+  AnyCollection items;
+  if(!items.read(message.c_str())) {
+    ScopedLock lock(mutex);
+    outbox.push_back(ErrorMessage(-1,"Unable to parse request"));
+    return false;
+  }
+  int id;
+  if(items["cancel"].as(id)) {
+    if(!Cancel(id)) {
+      ScopedLock lock(mutex);
+      outbox.push_back(ErrorMessage(id,"Request to cancel is not queued or running"));
+      return false;
+    }
+    return true;
+  }
+  return Submit(message) >= 0;
+}
+
+void PlanningService::Poll(vector<string>& messages)
+{
+  ScopedLock lock(mutex);
+  messages.swap(outbox);
+  outbox.resize(0);
+}
+
+int PlanningService::NumPending()
+{
+  ScopedLock lock(mutex);
+  return (int)active.size();
+}
+
+void PlanningService::WaitIdle()
+{
+  while(NumPending() > 0)
+    ThreadSleep(0.001);
+}
+
+bool PlanningService::Serve(const char* addr,int maxClients)
+{
+  if(!Start()) return false;
+  AsyncPipeThread pipe;
+  pipe.transport = new SocketServerTransport(addr,maxClients);
+  if(!pipe.Start()) {
+    fprintf(stderr,"PlanningService::Serve: unable to start server on %s\n",addr);
+    return false;
+  }
+  serving = true;
+  vector<string> messages;
+  while(serving) {
+    messages = pipe.New();
+    for(size_t i=0;i<messages.size();i++)
+      if(!messages[i].empty()) Handle(messages[i]);
+    Poll(messages);
+    for(size_t i=0;i<messages.size();i++)
+      pipe.Send(messages[i]);
+    ThreadSleep(0.001);
+  }
+  pipe.Stop();
+  return true;
+}
+
+void PlanningService::RunWorker(int index)
+{
+  RNG64* oldRng = threadRng;
+  threadRng = &rngs[index];
+  while(true) {
+    Job job;
+    bool haveJob = false;
+    {
+      ScopedLock lock(mutex);
+      if(!running) break;
+      if(!queue.empty()) {
+        job = queue.front();
+        queue.pop_front();
+        haveJob = true;
+        AnyCollection items;
+        items["id"] = job.id;
+        items["status"] = "started";
+        items["worker"] = index;
+        outbox.push_back(CollectionToString(items));
+      }
+    }
+    if(!haveJob) {
+      ThreadSleep(0.001);
+      continue;
+    }
+
+    string message;
+    bool wasCancelled = false;
+    MotionPlannerFactory factory;
+    MotionPlannerInterface* planner = NULL;
+    if(!job.planner.empty()) factory.LoadJSON(job.planner);
+    rngs[index].seed(job.seed);
+    planner = factory.Create(job.space,job.start,job.goal);
+    if(!planner)
+      message = ErrorMessage(job.id,"Unable to create planner");
+    else {
+      //same halting rules as MotionPlannerInterface::Plan
+      const HaltingCondition& cond = job.termCond;
+      MilestonePath path;
+      bool foundPath = false;
+      Real lastCheckTime = 0, lastCheckValue = 0;
+      Real lastProgressTime = 0, lastCancelCheckTime = 0;
+      string reason = "maxIters";
+      Timer timer;
+      for(int iters=0;iters<cond.maxIters;iters++) {
+        Real t=timer.ElapsedTime();
+        if(t >= lastCancelCheckTime + cancelCheckPeriod) {
+          lastCancelCheckTime = t;
+          ScopedLock lock(mutex);
+          if(cancelled.count(job.id) != 0) {
+            wasCancelled = true;
+            break;
+          }
+        }
+        if(progressPeriod > 0 && t >= lastProgressTime + progressPeriod) {
+          lastProgressTime = t;
+          AnyCollection items;
+          items["id"] = job.id;
+          items["status"] = "progress";
+          items["numIters"] = planner->NumIterations();
+          items["numMilestones"] = planner->NumMilestones();
+          items["time"] = double(t);
+          if(foundPath) {
+            planner->GetSolution(path);
+            items["cost"] = double(path.Length());
+          }
+          ScopedLock lock(mutex);
+          outbox.push_back(CollectionToString(items));
+        }
+        if(t > cond.timeLimit) {
+          reason = "timeLimit";
+          break;
+        }
+        //check for cost improvements
+        if(foundPath && t > lastCheckTime + cond.costImprovementPeriod) {
+          planner->GetSolution(path);
+          Real len = path.Length();
+          if(len < cond.costThreshold) {
+            reason = "costThreshold";
+            break;
+          }
+          if(lastCheckValue - len < cond.costImprovementThreshold) {
+            reason = "costImprovementThreshold";
+            break;
+          }
+          lastCheckTime = t;
+          lastCheckValue = len;
+        }
+        planner->PlanMore();
+        if(!foundPath && planner->IsSolved()) {
+          foundPath = true;
+          planner->GetSolution(path);
+          if(cond.foundSolution) {
+            reason = "foundSolution";
+            break;
+          }
+          lastCheckTime = t;
+          lastCheckValue = path.Length();
+        }
+      }
+      if(wasCancelled)
+        message = StatusMessage(job.id,"cancelled");
+      else {
+        AnyCollection items;
+        items["id"] = job.id;
+        items["status"] = "done";
+        items["terminationReason"] = reason;
+        items["numIters"] = planner->NumIterations();
+        items["numMilestones"] = planner->NumMilestones();
+        items["time"] = double(timer.ElapsedTime());
+        if(foundPath) {
+          planner->GetSolution(path);
+          items["cost"] = double(path.Length());
+          PathToCollection(path,items["path"]);
+        }
+        message = CollectionToString(items);
+      }
+      delete planner;
+    }
+
+    ScopedLock lock(mutex);
+    outbox.push_back(message);
+    active.erase(job.id);
+    cancelled.erase(job.id);
+    if(wasCancelled) numCancelled++;
+    else numCompleted++;
+  }
+  threadRng = oldRng;
+}
@@ -0,0 +1,132 @@
+#ifndef PLANNING_SERVICE_H
+#define PLANNING_SERVICE_H
+
+#include "AnyMotionPlanner.h"
+#include <KrisLibrary/utils/threadutils.h>
+#include <KrisLibrary/utils/random.h>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/** @ingroup MotionPlanning
+ * @brief A long-lived pool of planning threads that serves JSON requests,
+ * so that each request does not pay for loading and preprocessing the
+ * world.
+ *
+ * The spaces are registered by name before the workers start, and are
+ * shared by all workers, so they must be safe to call concurrently (see
+ * ParallelBidirectionalPlanner).  Each request creates its planner with a
+ * MotionPlannerFactory and runs it on one worker.
+ *
+ * A request is a JSON object of the form
+ * @verbatim
+ * {"id":3, "space":"maze", "start":[0.1,0.1], "goal":[0.9,0.9],
+ *  "planner":{"type":"sbl","perturbationRadius":0.2},
+ *  "termCond":{"foundSolution":0,"timeLimit":5}, "seed":7}
+ * @endverbatim
+ * where "id", "planner", "termCond", and "seed" are optional.  If "id" is
+ * omitted a new one is assigned, and the seed defaults to the id.  The
+ * request {"cancel":3} cancels request 3, whether it is queued or running.
+ *
+ * Each request produces a stream of messages, JSON objects with "id" and
+ * "status" keys:
+ * - "started": a worker has taken the request ("worker" is its index)
+ * - "progress": sent every progressPeriod seconds while planning, with
+ *   "numIters", "numMilestones", "time", and "cost" if a solution has been
+ *   found
+ * - "done": with "terminationReason" (as in MotionPlannerInterface::Plan),
+ *   "numIters", "numMilestones", "time", and, if a solution was found,
+ *   "cost" and "path", the list of the path's milestones
+ * - "cancelled"
+ * - "error": with a "message"
+ *
+ * The planner is run by calling PlanMore() under the same halting rules as
+ * MotionPlannerInterface::Plan, so the shortcut and restart modifiers take
+ * effect through their PlanMore().  Each worker has its own random number
+ * stream (see Math::threadRng) that is reseeded for each request, so a
+ * request's result does not depend on the worker that runs it.
+ *
+ * Usage within a process:
+ * @verbatim
+ * PlanningService service;
+ * service.spaces["maze"] = &myMazeSpace;
+ * service.numWorkers = 8;
+ * service.Start();
+ * int id = service.Submit("{\"space\":\"maze\",\"start\":[0.1,0.1],\"goal\":[0.9,0.9]}");
+ * vector<string> messages;
+ * service.WaitIdle();
+ * service.Poll(messages);
+ * service.Stop();
+ * @endverbatim
+ * Serve(addr) instead accepts requests from clients over a socket (the
+ * 4-byte length-prefixed strings of SocketServerTransport) and sends them
+ * all messages, so clients should filter messages by id.
+ */
+class PlanningService
+{
+ public:
+  PlanningService();
+  ~PlanningService();
+  ///Launches the worker threads
+  bool Start();
+  ///Cancels all requests and joins the worker threads
+  void Stop();
+  ///Queues a request.  Returns its id, or -1 if the request is invalid (an
+  ///error message is then posted)
+  int Submit(const std::string& request);
+  ///Cancels a queued or running request.  Returns false if it is not
+  ///known or already finished
+  bool Cancel(int id);
+  ///Handles a request or cancellation message
+  bool Handle(const std::string& message);
+  ///Moves the messages posted since the last call into messages
+  void Poll(std::vector<std::string>& messages);
+  ///Returns the number of queued or running requests
+  int NumPending();
+  ///Blocks until no requests are queued or running
+  void WaitIdle();
+  ///Starts the workers if needed, then accepts requests from up to
+  ///maxClients socket clients on addr and sends them the messages.  Returns
+  ///when StopServing() is called.
+  bool Serve(const char* addr,int maxClients=1);
+  void StopServing() { serving = false; }
+
+  ///Worker thread body (internal use)
+  void RunWorker(int index);
+
+  struct Job
+  {
+    int id;
+    CSpace* space;
+    Config start,goal;
+    std::string planner;
+    HaltingCondition termCond;
+    unsigned long seed;
+  };
+
+  std::map<std::string,CSpace*> spaces;
+  ///Number of worker threads (default 4)
+  int numWorkers;
+  ///Seconds between progress messages (default 0.5).  If <= 0, no
+  ///progress messages are sent
+  Real progressPeriod;
+  ///Seconds between checks for cancellation while planning (default 0.01)
+  Real cancelCheckPeriod;
+
+  //internal state, protected by mutex
+  Mutex mutex;
+  bool running,serving;
+  std::list<Job> queue;
+  std::set<int> active,cancelled;
+  std::vector<std::string> outbox;
+  int nextId;
+  std::vector<Thread> threads;
+  std::vector<RNG64> rngs;
+
+  ///Statistics
+  int numSubmitted,numCompleted,numCancelled;
+};
+
+#endif
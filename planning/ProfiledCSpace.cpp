@@ -0,0 +1,344 @@
+#include "ProfiledCSpace.h"
+#include <utils/StatCollector.h>
+#include <Timer.h>
+#include <stdio.h>
+#include <math.h>
+
+//bit i is set if shard i is owned by a live thread
+static std::atomic<unsigned int> usedShards(0);
+
+CallProfile::ThreadSlot::ThreadSlot()
+  :index(NumShards-1)
+{
+  unsigned int used = usedShards.load(std::memory_order_relaxed);
+  for(int i=0;i<NumShards-1;i++) {
+    if(used & (1u<<i)) continue;
+    //acquire the writes of the shard's previous owner
+    if(usedShards.compare_exchange_weak(used,used|(1u<<i),std::memory_order_acquire)) {
+      index = i;
+      return;
+    }
+    i = -1; //used was reloaded, start over
+  }
+}
+
+CallProfile::ThreadSlot::~ThreadSlot()
+{
+  if(index < NumShards-1)
+    usedShards.fetch_and(~(1u<<index),std::memory_order_release);
+}
+
+CallProfile::CallProfile()
+  :timingPeriod(1)
+{
+  Clear();
+}
+
+void CallProfile::Clear()
+{
+  for(int k=0;k<NumShards;k++) {
+    shards[k].count = 0;
+    shards[k].timedCount = 0;
+    shards[k].totalNanos = 0;
+    for(int i=0;i<NumBuckets;i++) shards[k].buckets[i] = 0;
+  }
+}
+
+int CallProfile::Bucket(long long ns)
+{
+  if(ns <= 1) return 0;
+#if defined(__GNUC__)
+  int b = 63 - __builtin_clzll((unsigned long long)ns);
+#else
+  int b = 0;
+  while(ns > 1) { ns >>= 1; b++; }
+#endif
+  return (b < NumBuckets ? b : NumBuckets-1);
+}
+
+long long CallProfile::Count() const
+{
+  long long n = 0;
+  for(int k=0;k<NumShards;k++) n += shards[k].count.load(std::memory_order_relaxed);
+  return n;
+}
+
+long long CallProfile::TimedCount() const
+{
+  long long n = 0;
+  for(int k=0;k<NumShards;k++) n += shards[k].timedCount.load(std::memory_order_relaxed);
+  return n;
+}
+
+long long CallProfile::TotalNanos() const
+{
+  long long n = 0;
+  for(int k=0;k<NumShards;k++) n += shards[k].totalNanos.load(std::memory_order_relaxed);
+  return n;
+}
+
+double CallProfile::TotalTime() const
+{
+  long long n = TimedCount();
+  if(n == 0) return 0;
+  return double(TotalNanos())*1e-9*double(Count())/double(n);
+}
+
+double CallProfile::AverageTime() const
+{
+  long long n = TimedCount();
+  if(n == 0) return 0;
+  return double(TotalNanos())*1e-9/double(n);
+}
+
+double CallProfile::Quantile(double q) const
+{
+  std::vector<long long> counts;
+  GetHistogram(counts);
+  long long n = 0;
+  for(int i=0;i<NumBuckets;i++) n += counts[i];
+  if(n == 0) return 0;
+  double target = q*double(n);
+  long long sum = 0;
+  for(int i=0;i<NumBuckets;i++) {
+    if(counts[i] == 0) continue;
+    if(double(sum+counts[i]) >= target) {
+      //interpolate linearly within the bucket
+      double lo = (i==0 ? 0.0 : ldexp(1.0,i)), hi = ldexp(1.0,i+1);
+      double u = (target - double(sum))/double(counts[i]);
+      return (lo + u*(hi-lo))*1e-9;
+    }
+    sum += counts[i];
+  }
+  return ldexp(1.0,NumBuckets)*1e-9;
+}
+
+void CallProfile::GetHistogram(std::vector<long long>& counts) const
+{
+  counts.resize(NumBuckets);
+  for(int i=0;i<NumBuckets;i++) {
+    counts[i] = 0;
+    for(int k=0;k<NumShards;k++) counts[i] += shards[k].buckets[i].load(std::memory_order_relaxed);
+  }
+}
+
+void CallProfile::Export(StatCollector& stats) const
+{
+  std::vector<long long> counts;
+  GetHistogram(counts);
+  for(int i=0;i<NumBuckets;i++) {
+    if(counts[i] == 0) continue;
+    double mid = (i==0 ? 0.5 : 1.5*ldexp(1.0,i));
+    stats.weightedCollect(mid*1e-9,double(counts[i]));
+  }
+}
+
+ProfiledCSpace::ProfiledCSpace(CSpace* baseSpace)
+  :PiggybackCSpace(baseSpace),enabled(true)
+{
+  profiles[CallDistance].timingPeriod = 32;
+  profiles[CallInterpolate].timingPeriod = 32;
+  profiles[CallMidpoint].timingPeriod = 32;
+}
+
+const char* ProfiledCSpace::CallName(int type)
+{
+  switch(type) {
+  case CallSample: return "Sample";
+  case CallSampleNeighborhood: return "SampleNeighborhood";
+  case CallIsFeasible: return "IsFeasible";
+  case CallLocalPlanner: return "LocalPlanner";
+  case CallIsVisible: return "IsVisible";
+  case CallEdgePlan: return "EdgePlan";
+  case CallDistance: return "Distance";
+  case CallInterpolate: return "Interpolate";
+  case CallMidpoint: return "Midpoint";
+  case CallObstacleDistance: return "ObstacleDistance";
+  case CallNearestNeighbors: return "NearestNeighbors";
+  default: return "Unknown";
+  }
+}
+
+void ProfiledCSpace::Sample(Config& x)
+{
+  ScopedCallTimer timer(profiles[CallSample],enabled);
+  PiggybackCSpace::Sample(x);
+}
+
+void ProfiledCSpace::SampleNeighborhood(const Config& c,Real r,Config& x)
+{
+  ScopedCallTimer timer(profiles[CallSampleNeighborhood],enabled);
+  PiggybackCSpace::SampleNeighborhood(c,r,x);
+}
+
+bool ProfiledCSpace::IsFeasible(const Config& x)
+{
+  ScopedCallTimer timer(profiles[CallIsFeasible],enabled);
+  return PiggybackCSpace::IsFeasible(x);
+}
+
+EdgePlanner* ProfiledCSpace::LocalPlanner(const Config& a,const Config& b)
+{
+  EdgePlanner* e;
+  {
+    ScopedCallTimer timer(profiles[CallLocalPlanner],enabled);
+    e = PiggybackCSpace::LocalPlanner(a,b);
+  }
+  return new ProfiledEdgePlanner(this,e);
+}
+
+Real ProfiledCSpace::Distance(const Config& x, const Config& y)
+{
+  ScopedCallTimer timer(profiles[CallDistance],enabled);
+  return PiggybackCSpace::Distance(x,y);
+}
+
+void ProfiledCSpace::Interpolate(const Config& x,const Config& y,Real u,Config& out)
+{
+  ScopedCallTimer timer(profiles[CallInterpolate],enabled);
+  PiggybackCSpace::Interpolate(x,y,u,out);
+}
+
+void ProfiledCSpace::Midpoint(const Config& x,const Config& y,Config& out)
+{
+  ScopedCallTimer timer(profiles[CallMidpoint],enabled);
+  PiggybackCSpace::Midpoint(x,y,out);
+}
+
+Real ProfiledCSpace::ObstacleDistance(const Config& a)
+{
+  ScopedCallTimer timer(profiles[CallObstacleDistance],enabled);
+  if(baseSpace) return baseSpace->ObstacleDistance(a);
+  return CSpace::ObstacleDistance(a);
+}
+
+void ProfiledCSpace::Clear()
+{
+  for(int i=0;i<NumCallTypes;i++) profiles[i].Clear();
+}
+
+void ProfiledCSpace::GetStats(PropertyMap& stats,const std::string& prefix) const
+{
+  std::vector<long long> histogram;
+  for(int i=0;i<NumCallTypes;i++) {
+    if(profiles[i].Count() == 0) continue;
+    std::string name = prefix + CallName(i);
+    stats.set(name+".count",profiles[i].Count());
+    stats.set(name+".time",profiles[i].TotalTime());
+    stats.set(name+".average",profiles[i].AverageTime());
+    profiles[i].GetHistogram(histogram);
+    //trailing empty buckets are dropped
+    while(!histogram.empty() && histogram.back()==0) histogram.pop_back();
+    stats.setArray(name+".histogram",histogram);
+  }
+}
+
+void ProfiledCSpace::Export(StatDatabase& db,const std::string& prefix) const
+{
+  for(int i=0;i<NumCallTypes;i++) {
+    if(profiles[i].Count() == 0) continue;
+    std::string name = prefix;
+    if(!name.empty()) name += db.delim;
+    name += CallName(i);
+    StatDatabase::Data& data = db.AddData(name);
+    data.count += (int)profiles[i].Count();
+    profiles[i].Export(data.value);
+  }
+}
+
+ProfiledEdgePlanner::ProfiledEdgePlanner(ProfiledCSpace* _space,EdgePlanner* _e)
+  :PiggybackEdgePlanner(_space,_e->Start(),_e->Goal(),_e),profiledSpace(_space)
+{}
+
+ProfiledEdgePlanner::ProfiledEdgePlanner(ProfiledCSpace* _space,const SmartPointer<EdgePlanner>& _e)
+  :PiggybackEdgePlanner(_space,_e->Start(),_e->Goal(),_e),profiledSpace(_space)
+{}
+
+bool ProfiledEdgePlanner::IsVisible()
+{
+  ScopedCallTimer timer(profiledSpace->profiles[ProfiledCSpace::CallIsVisible],profiledSpace->enabled);
+  return e->IsVisible();
+}
+
+bool ProfiledEdgePlanner::Plan()
+{
+  ScopedCallTimer timer(profiledSpace->profiles[ProfiledCSpace::CallEdgePlan],profiledSpace->enabled);
+  return e->Plan();
+}
+
+ProfiledPointLocation::ProfiledPointLocation(ProfiledCSpace* _space,const SmartPointer<PointLocationBase>& _base)
+  :PointLocationBase(_base->points),space(_space),base(_base)
+{}
+
+bool ProfiledPointLocation::NN(const Vector& p,int& nn,Real& distance)
+{
+  ScopedCallTimer timer(space->profiles[ProfiledCSpace::CallNearestNeighbors],space->enabled);
+  return base->NN(p,nn,distance);
+}
+
+bool ProfiledPointLocation::KNN(const Vector& p,int k,std::vector<int>& nn,std::vector<Real>& distances)
+{
+  ScopedCallTimer timer(space->profiles[ProfiledCSpace::CallNearestNeighbors],space->enabled);
+  return base->KNN(p,k,nn,distances);
+}
+
+bool ProfiledPointLocation::Close(const Vector& p,Real r,std::vector<int>& neighbors,std::vector<Real>& distances)
+{
+  ScopedCallTimer timer(space->profiles[ProfiledCSpace::CallNearestNeighbors],space->enabled);
+  return base->Close(p,r,neighbors,distances);
+}
+
+bool ProfiledPointLocation::FilteredNN(const Vector& p,bool (*filter)(int),int& nn,Real& distance)
+{
+  ScopedCallTimer timer(space->profiles[ProfiledCSpace::CallNearestNeighbors],space->enabled);
+  return base->FilteredNN(p,filter,nn,distance);
+}
+
+bool ProfiledPointLocation::FilteredKNN(const Vector& p,int k,bool (*filter)(int),std::vector<int>& nn,std::vector<Real>& distances)
+{
+  ScopedCallTimer timer(space->profiles[ProfiledCSpace::CallNearestNeighbors],space->enabled);
+  return base->FilteredKNN(p,k,filter,nn,distances);
+}
+
+bool ProfiledPointLocation::FilteredClose(const Vector& p,Real r,bool (*filter)(int),std::vector<int>& neighbors,std::vector<Real>& distances)
+{
+  ScopedCallTimer timer(space->profiles[ProfiledCSpace::CallNearestNeighbors],space->enabled);
+  return base->FilteredClose(p,r,filter,neighbors,distances);
+}
+
+//runs the call loops used by MeasureProfilingOverhead, returns the time
+static double TimeCalls(CSpace* space,const std::vector<Config>& samples)
+{
+  Timer timer;
+  Config x;
+  int numFeasible = 0;
+  Real sumDistance = 0;
+  for(size_t i=0;i<samples.size();i++) {
+    space->Sample(x);
+    if(space->IsFeasible(samples[i])) numFeasible++;
+    const Config& b = samples[(i+1)%samples.size()];
+    sumDistance += space->Distance(samples[i],b);
+    space->Interpolate(samples[i],b,0.5,x);
+  }
+  //keeps the loop from being optimized out
+  if(numFeasible < 0 || sumDistance < 0) printf("MeasureProfilingOverhead: invalid result\n");
+  return timer.ElapsedTime();
+}
+
+Real MeasureProfilingOverhead(CSpace* space,int numCalls,int numTrials,bool verbose)
+{
+  std::vector<Config> samples(numCalls);
+  for(int i=0;i<numCalls;i++) space->Sample(samples[i]);
+  ProfiledCSpace pspace(space);
+  double tbase = Inf, tprofiled = Inf;
+  for(int k=0;k<numTrials;k++) {
+    tbase = Min(tbase,TimeCalls(space,samples));
+    tprofiled = Min(tprofiled,TimeCalls(&pspace,samples));
+  }
+  Real overhead = (tbase > 0 ? (tprofiled - tbase)/tbase : 0);
+  if(verbose) {
+    printf("MeasureProfilingOverhead: %d calls each of Sample, IsFeasible, Distance, Interpolate\n",numCalls);
+    printf("  direct %g s, profiled %g s, overhead %g%%\n",tbase,tprofiled,overhead*100.0);
+  }
+  return overhead;
+}
@@ -0,0 +1,252 @@
+#ifndef PROFILED_CSPACE_H
+#define PROFILED_CSPACE_H
+
+#include "EdgePlanner.h"
+#include "PointLocation.h"
+#include "CSpaceHelpers.h"
+#include <KrisLibrary/utils/PropertyMap.h>
+#include <KrisLibrary/utils/SmartPointer.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct StatCollector;
+struct StatDatabase;
+
+/** @ingroup MotionPlanning
+ * @brief A thread-safe call counter and log-scale histogram of call
+ * durations.
+ *
+ * Histogram bucket i holds the calls that took between 2^i and 2^(i+1)
+ * nanoseconds (bucket 0 also holds calls shorter than 1ns, and the last
+ * bucket holds all longer calls).
+ *
+ * To keep the cost of counting to a few cycles, the counters are split into
+ * per-thread shards that are written without locked instructions, and only
+ * summed when read.  Up to NumShards-1 live threads get their own shard;
+ * any further concurrent threads share the last shard, which is updated
+ * atomically.  Shards are returned when their threads exit.
+ *
+ * To bound the overhead on very cheap calls, only one out of every
+ * timingPeriod calls is timed (timingPeriod must be a power of 2); the others
+ * are only counted.  TotalTime() extrapolates from the timed calls.
+ */
+struct CallProfile
+{
+  enum { NumBuckets = 32, NumShards = 16 };
+  struct Shard
+  {
+    std::atomic<long long> count,timedCount,totalNanos;
+    std::atomic<long long> buckets[NumBuckets];
+    //keeps shards on separate cache lines
+    char padding[64-((3+NumBuckets)*sizeof(long long))%64];
+  };
+
+  ///A shard index owned by a thread.  It is claimed on the thread's first
+  ///use of any profile and released when the thread exits, so that threads
+  ///that are repeatedly created and joined (e.g., by
+  ///ParallelBidirectionalPlanner) do not run out of exclusive shards
+  struct ThreadSlot
+  {
+    ThreadSlot();
+    ~ThreadSlot();
+    int index;
+  };
+
+  CallProfile();
+  void Clear();
+  ///Shard index of the calling thread
+  static inline int ThreadIndex() {
+    static thread_local ThreadSlot slot;
+    return slot.index;
+  }
+  static inline void Add(std::atomic<long long>& value,long long inc,bool exclusive) {
+    if(exclusive) value.store(value.load(std::memory_order_relaxed)+inc,std::memory_order_relaxed);
+    else value.fetch_add(inc,std::memory_order_relaxed);
+  }
+  ///Counts a call.  Returns true if it should be timed, in which case the
+  ///time should be passed to AddTime with the returned shard
+  inline bool Increment(int& shard) {
+    shard = ThreadIndex();
+    long long index = shards[shard].count.load(std::memory_order_relaxed);
+    Add(shards[shard].count,1,shard != NumShards-1);
+    return (index & (timingPeriod-1)) == 0;
+  }
+  ///Records the duration of a timed call
+  inline void AddTime(int shard,long long ns) {
+    Shard& s = shards[shard];
+    bool exclusive = (shard != NumShards-1);
+    Add(s.timedCount,1,exclusive);
+    Add(s.totalNanos,ns,exclusive);
+    Add(s.buckets[Bucket(ns)],1,exclusive);
+  }
+  static int Bucket(long long ns);
+  long long Count() const;
+  long long TimedCount() const;
+  long long TotalNanos() const;
+  ///Estimated total time spent in the call, in seconds
+  double TotalTime() const;
+  ///Average time per call, in seconds
+  double AverageTime() const;
+  ///Approximate quantile of the call time (in seconds) from the histogram
+  double Quantile(double q) const;
+  void GetHistogram(std::vector<long long>& counts) const;
+  ///Adds the timed calls' durations (in seconds) to the collector, using
+  ///the histogram bucket midpoints
+  void Export(StatCollector& stats) const;
+
+  int timingPeriod;
+  Shard shards[NumShards];
+};
+
+/** @ingroup MotionPlanning
+ * @brief Times a call to a CallProfile within a scope.  Use as follows:
+ * @verbatim
+ * ScopedCallTimer timer(profile);
+ * ... do the call ...
+ * @endverbatim
+ */
+class ScopedCallTimer
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+  ScopedCallTimer(CallProfile& _profile,bool enabled=true)
+    :profile(_profile),timed(false)
+  {
+    if(!enabled) return;
+    timed = profile.Increment(shard);
+    if(timed) start = Clock::now();
+  }
+  ~ScopedCallTimer() {
+    if(timed) profile.AddTime(shard,std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now()-start).count());
+  }
+
+  CallProfile& profile;
+  bool timed;
+  int shard;
+  Clock::time_point start;
+};
+
+/** @ingroup MotionPlanning
+ * @brief A CSpace decorator that profiles the calls that planners make to
+ * the space and to its edges.
+ *
+ * Every CSpace call is counted and timed into a CallProfile.  Edges returned
+ * by LocalPlanner are wrapped in ProfiledEdgePlanners that profile
+ * IsVisible and incremental Plan calls.  Nearest-neighbor queries can be
+ * profiled by wrapping a planner's point locator in a ProfiledPointLocation:
+ * @verbatim
+ * ProfiledCSpace pspace(&space);
+ * RoadmapPlanner prm(&pspace);
+ * prm.pointLocator = new ProfiledPointLocation(&pspace,prm.pointLocator);
+ * ...
+ * PropertyMap stats;
+ * pspace.GetStats(stats);
+ * @endverbatim
+ *
+ * Feasibility checks that the base space's edge planners make internally
+ * go directly to the base space, so they are not counted under IsFeasible;
+ * their time is included in IsVisible.
+ *
+ * The counters are thread-safe, so the space can be shared between planning
+ * threads.  The overhead is a counter update per call and two clock reads
+ * per timed call.  Distance,
+ * Interpolate, and Midpoint are typically very cheap, so by default only
+ * one in 32 of those calls is timed.  Set enabled=false to turn off
+ * profiling altogether.
+ */
+class ProfiledCSpace : public PiggybackCSpace
+{
+public:
+  enum CallType { CallSample, CallSampleNeighborhood, CallIsFeasible, CallLocalPlanner,
+                  CallIsVisible, CallEdgePlan, CallDistance, CallInterpolate,
+                  CallMidpoint, CallObstacleDistance, CallNearestNeighbors, NumCallTypes };
+
+  ProfiledCSpace(CSpace* baseSpace=NULL);
+  static const char* CallName(int type);
+  virtual void Sample(Config& x);
+  virtual void SampleNeighborhood(const Config& c,Real r,Config& x);
+  virtual bool IsFeasible(const Config& x);
+  virtual EdgePlanner* LocalPlanner(const Config& a,const Config& b);
+  virtual Real Distance(const Config& x, const Config& y);
+  virtual void Interpolate(const Config& x,const Config& y,Real u,Config& out);
+  virtual void Midpoint(const Config& x,const Config& y,Config& out);
+  virtual Real ObstacleDistance(const Config& a);
+
+  ///Resets all profiles
+  void Clear();
+  /** @brief Writes the profile into a PropertyMap, e.g., the one returned
+   * by MotionPlannerInterface::GetStats.
+   *
+   * For each call type with a nonzero count, sets the keys
+   * [prefix][name].count, .time (estimated total seconds), .average
+   * (seconds), and .histogram (bucket counts).
+   */
+  void GetStats(PropertyMap& stats,const std::string& prefix="profile.") const;
+  ///Adds the profile to a StatDatabase under [prefix].[name]: the call
+  ///count goes into the count and the timed durations into the value
+  void Export(StatDatabase& db,const std::string& prefix="profile") const;
+
+  bool enabled;
+  CallProfile profiles[NumCallTypes];
+};
+
+/** @ingroup MotionPlanning
+ * @brief Measures the relative cost of profiling calls to the given space.
+ *
+ * Draws numCalls samples, and times Sample, IsFeasible, Distance, and
+ * Interpolate calls on them, first directly on space and then through a
+ * ProfiledCSpace.  The loops are repeated numTrials times and the fastest
+ * trial of each is used.  Returns the relative overhead, e.g., 0.02 for 2%.
+ * If verbose is true, the timings are printed to stdout.
+ */
+Real MeasureProfilingOverhead(CSpace* space,int numCalls=10000,int numTrials=5,bool verbose=true);
+
+/** @ingroup MotionPlanning
+ * @brief An edge planner that forwards to another one, profiling its
+ * IsVisible and Plan calls into a ProfiledCSpace.
+ */
+class ProfiledEdgePlanner : public PiggybackEdgePlanner
+{
+public:
+  ProfiledEdgePlanner(ProfiledCSpace* space,EdgePlanner* e);
+  ProfiledEdgePlanner(ProfiledCSpace* space,const SmartPointer<EdgePlanner>& e);
+  virtual bool IsVisible();
+  virtual bool Plan();
+  //these keep the wrapped edge's path and the profiling on copies
+  virtual void Eval(Real u,Config& x) const { e->Eval(u,x); }
+  virtual EdgePlanner* Copy() const { return new ProfiledEdgePlanner(profiledSpace,e->Copy()); }
+  virtual EdgePlanner* ReverseCopy() const { return new ProfiledEdgePlanner(profiledSpace,e->ReverseCopy()); }
+
+  ProfiledCSpace* profiledSpace;
+};
+
+/** @ingroup MotionPlanning
+ * @brief A point locator that forwards to another one, profiling all
+ * queries into the CallNearestNeighbors profile of a ProfiledCSpace.
+ *
+ * If the base locator measures distances using the profiled space, those
+ * Distance calls are profiled as well, and their time is included in the
+ * NearestNeighbors time.
+ */
+class ProfiledPointLocation : public PointLocationBase
+{
+public:
+  ProfiledPointLocation(ProfiledCSpace* space,const SmartPointer<PointLocationBase>& base);
+  virtual void OnAppend() { base->OnAppend(); }
+  virtual bool OnDelete(int id) { return base->OnDelete(id); }
+  virtual bool OnClear() { return base->OnClear(); }
+  virtual bool Exact() { return base->Exact(); }
+  virtual bool NN(const Vector& p,int& nn,Real& distance);
+  virtual bool KNN(const Vector& p,int k,std::vector<int>& nn,std::vector<Real>& distances);
+  virtual bool Close(const Vector& p,Real r,std::vector<int>& neighbors,std::vector<Real>& distances);
+  virtual bool FilteredNN(const Vector& p,bool (*filter)(int),int& nn,Real& distance);
+  virtual bool FilteredKNN(const Vector& p,int k,bool (*filter)(int),std::vector<int>& nn,std::vector<Real>& distances);
+  virtual bool FilteredClose(const Vector& p,Real r,bool (*filter)(int),std::vector<int>& neighbors,std::vector<Real>& distances);
+
+  ProfiledCSpace* space;
+  SmartPointer<PointLocationBase> base;
+};
+
+#endif
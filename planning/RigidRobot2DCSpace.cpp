@@ -114,6 +114,7 @@ bool RigidRobot2DCSpace::IsFeasible(const Config& x)
   T.R.setRotate(x(2));
   Geometric2DCollection temp = robot;
   temp.Transform(T);
+  if(obstacleGrid.Matches(obstacles)) return !obstacleGrid.Collides(temp);
   if(obstacles.Collides(temp)) return false;
   return true;
 }
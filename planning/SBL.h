@@ -49,6 +49,9 @@ public:
   std::list<EdgeInfo> outputPath;
 };
 
+///Converts the edge list produced by SBLTree::CheckPath into a path
+void CreateMilestonePath(const std::list<SBLTree::EdgeInfo>& in,MilestonePath& out);
+
 /** @brief An SBL planner whose trees use grids for point location.
  *
  * Every numItersPerRandomize Extend() iterations, the grid dimensions are
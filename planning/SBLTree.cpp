@@ -1,4 +1,5 @@
 #include "SBLTree.h"
+#include "LazyEdgeChecker.h"
 #include <math/random.h>
 #include <errors.h>
 #include <vector>
@@ -193,8 +194,6 @@ bool SBLTree::CheckPath(SBLTree* s,Node* ns,SBLTree* g,Node* ng,std::list<EdgeIn
   //start -> ns -> ng -> goal
   SmartPointer<EdgePlanner> bridge = space->LocalPlanner(*ns,*ng);  //edge from ns to ng
 
-  priority_queue<EdgeInfo,vector<EdgeInfo>,LessEdgePriority> q;
-
   //start->ns
   EdgeInfo temp;
   Node* n=ns;
@@ -232,6 +231,8 @@ bool SBLTree::CheckPath(SBLTree* s,Node* ns,SBLTree* g,Node* ng,std::list<EdgeIn
       Assert(i->t == n->s);
   }
 
+#if USE_PLAN_EXTENSIONS
+  priority_queue<EdgeInfo,vector<EdgeInfo>,LessEdgePriority> q;
   for(list<EdgeInfo>::iterator i=outputPath.begin();i!=outputPath.end();i++)
     q.push(*i);
   
@@ -241,7 +242,6 @@ bool SBLTree::CheckPath(SBLTree* s,Node* ns,SBLTree* g,Node* ng,std::list<EdgeIn
     temp=q.top(); q.pop();
     if(temp.e->Done()) continue;
     //Real len=temp.e->Priority();
-#if USE_PLAN_EXTENSIONS
     Config *a,*b;
     BisectionEpsilonEdgePlanner* bisectionEdge;
     try {
@@ -304,51 +304,57 @@ bool SBLTree::CheckPath(SBLTree* s,Node* ns,SBLTree* g,Node* ng,std::list<EdgeIn
       //cout<<"CheckPath: Failed on edge of length "<<len<<endl;
       return false;
     }
+    if(!temp.e->Done()) q.push(temp);
+  }
 #else
-    if(!temp.e->Plan()) {
-      //disconnect!
-      if(temp.e == bridge) {
-	//cout<<"Disconnecting edge between connected nodes"<<endl;
-	//no change in graph
-	bridge = NULL;
-      }
-      else if(s->HasNode(temp.s)) {
-	//cout<<"Disconnecting edge on start tree"<<endl;
-	//disconnect tree from s->t
-	temp.s->detachChild(temp.t);
-	Assert(temp.t == ns || temp.t->hasDescendent(ns));
-	ns->reRoot();
-	ns->edgeFromParent() = bridge;
-	
-	//move nodes in subtree from start arrays to goal arrays
-	ChangeTreeCallback changeCallback(s,g);
-	ns->DFS(changeCallback);
-	ng->addChild(ns);
-	Assert(ns->hasAncestor(g->root));
-	Assert(s->root->getParent()==NULL);
-      }
-      else {     //on goal tree
-	//cout<<"Disconnecting edge on goal tree"<<endl;
-	Assert(g->HasNode(temp.t));
-	//disconnect tree from s->t
-	temp.t->detachChild(temp.s);
-	Assert(temp.s == ng || temp.s->hasDescendent(ng));
-	ng->reRoot();
-	ng->edgeFromParent() = bridge;
-	
-	//move nodes in subtree from goal arrays to start arrays
-	ChangeTreeCallback changeCallback(g,s);
-	ng->DFS(changeCallback);
-	ns->addChild(ng);
-	Assert(ng->hasAncestor(s->root));
-	Assert(g->root->getParent()==NULL);
-      }
-      outputPath.clear();
-      return false;
+  //adaptive division of path, longest unchecked segment first
+  vector<EdgeInfo> edges(outputPath.begin(),outputPath.end());
+  LazyEdgeChecker checker;
+  for(size_t i=0;i<edges.size();i++)
+    checker.Add(edges[i].e,(int)i);
+  if(!checker.Check()) {
+    temp = edges[checker.failed];
+    //disconnect!
+    if(temp.e == bridge) {
+      //cout<<"Disconnecting edge between connected nodes"<<endl;
+      //no change in graph
+      bridge = NULL;
     }
-#endif //USE_PLAN_EXTENSIONS
-    if(!temp.e->Done()) q.push(temp);
+    else if(s->HasNode(temp.s)) {
+      //cout<<"Disconnecting edge on start tree"<<endl;
+      //disconnect tree from s->t
+      temp.s->detachChild(temp.t);
+      Assert(temp.t == ns || temp.t->hasDescendent(ns));
+      ns->reRoot();
+      ns->edgeFromParent() = bridge;
+      
+      //move nodes in subtree from start arrays to goal arrays
+      ChangeTreeCallback changeCallback(s,g);
+      ns->DFS(changeCallback);
+      ng->addChild(ns);
+      Assert(ns->hasAncestor(g->root));
+      Assert(s->root->getParent()==NULL);
+    }
+    else {     //on goal tree
+      //cout<<"Disconnecting edge on goal tree"<<endl;
+      Assert(g->HasNode(temp.t));
+      //disconnect tree from s->t
+      temp.t->detachChild(temp.s);
+      Assert(temp.s == ng || temp.s->hasDescendent(ng));
+      ng->reRoot();
+      ng->edgeFromParent() = bridge;
+      
+      //move nodes in subtree from goal arrays to start arrays
+      ChangeTreeCallback changeCallback(g,s);
+      ng->DFS(changeCallback);
+      ns->addChild(ng);
+      Assert(ng->hasAncestor(s->root));
+      Assert(g->root->getParent()==NULL);
+    }
+    outputPath.clear();
+    return false;
   }
+#endif //USE_PLAN_EXTENSIONS
 
   //done!
   //cout<<"Path checking success"<<endl;
@@ -374,36 +380,25 @@ bool SBLTree::CheckPath(SBLTree* t,Node* ns,Node* ng,MilestonePath& outputPath)
     std::swap(ns,ng);
   Assert(outputPath.edges.empty());
   
-  priority_queue<EdgeInfo,vector<EdgeInfo>,LessEdgePriority> q;
-
   //ns -> ng
-  EdgeInfo temp;
+  vector<Node*> children;
+  LazyEdgeChecker checker;
   Node* n=ng;
   while(n != ns) {
-    temp.s = n->getParent();
-    temp.t = n;
-    temp.e = n->edgeFromParent();
-    temp.reversed=false;
-    q.push(temp);
-
+    checker.Add(n->edgeFromParent(),(int)children.size());
+    children.push_back(n);
     outputPath.edges.push_back(n->edgeFromParent());
     n=n->getParent();
   }
   std::reverse(outputPath.edges.begin(),outputPath.edges.end());
   
-  //adaptive division of path
-  Config x;
-  while(!q.empty()) {
-    temp=q.top(); q.pop();
-    if(temp.e->Done()) continue;
-    if(!temp.e->Plan()) {
-      //disconnect!
-      //cout<<"Disconnecting edge on start tree"<<endl;
-      t->DeleteSubtree(temp.t);
-      outputPath.edges.clear();
-      return false;
-    }
-    if(!temp.e->Done()) q.push(temp);
+  //adaptive division of path, longest unchecked segment first
+  if(!checker.Check()) {
+    //disconnect!
+    //cout<<"Disconnecting edge on start tree"<<endl;
+    t->DeleteSubtree(children[checker.failed]);
+    outputPath.edges.clear();
+    return false;
   }
   //success!
   return true;
@@ -481,7 +476,7 @@ void SBLSubdivision::RandomizeSubset()
   vector<int> p(n); //make a permutation
   for(int i=0;i<n;i++) p[i]=i;
   for(size_t i=0;i<subsetToFull.mapping.size();i++) {
-    p[i] = p[i+rand()%(n-i)];
+    p[i] = p[i+RandInt(n-i)];
     subsetToFull.mapping[i] = p[i];
   }
   subsetToFull.InvMap(h,subdiv.hinv);
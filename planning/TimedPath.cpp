@@ -81,6 +81,48 @@ int TimedMilestonePath::Eval(Real t,Config& x) const
   return edges.size();
 }
 
+int TimedMilestonePath::Eval(Real t,Config& x,Cursor& cursor) const
+{
+  Assert(!edges.empty());
+  if(t < 0) {
+    x = Begin();
+    return -1;
+  }
+  if(cursor.index < 0 || cursor.index >= (int)edges.size() || t < cursor.startTime) {
+    cursor.index = 0;
+    cursor.startTime = 0;
+  }
+  for(size_t i=cursor.index;i<edges.size();i++) {
+    Real u = t-cursor.startTime;
+    if(u <= durations[i]) {
+      if(durations[i] == 0) x=edges[i]->Start();
+      else edges[i]->Eval(u/durations[i],x);
+      return (int)i;
+    }
+    if(i+1 < edges.size()) {
+      cursor.index = (int)i+1;
+      cursor.startTime += durations[i];
+    }
+  }
+  //fall through: t is longer than path
+  x = End();
+  return edges.size();
+}
+
+void TimedMilestonePath::Eval(const vector<Real>& ts,vector<Real>& out) const
+{
+  Assert(!edges.empty());
+  int n = Begin().n;
+  out.resize(ts.size()*n);
+  Cursor cursor;
+  Config x;
+  for(size_t j=0;j<ts.size();j++) {
+    Eval(ts[j],x,cursor);
+    Assert(x.n == n);
+    for(int k=0;k<n;k++) out[j*n+k] = x(k);
+  }
+}
+
 
 void TimedMilestonePath::Split(Real dt,TimedMilestonePath& before,TimedMilestonePath& after) const
 {
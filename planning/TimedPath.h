@@ -5,6 +5,14 @@
 
 struct TimedMilestonePath
 {
+  ///The edge found by a previous Eval and the time at which it starts
+  struct Cursor
+  {
+    Cursor() : index(0),startTime(0) {}
+    int index;
+    Real startTime;
+  };
+
   bool Empty() const { return edges.empty(); }
   bool IsConstant() const { return edges.size()==1 && edges[0]->Start()==edges[0]->Goal(); }
   CSpace* Space() const { return edges[0]->Space(); }
@@ -26,6 +34,13 @@ struct TimedMilestonePath
   void Concat(const TimedMilestonePath& path);
   //returns the edge index (-1 if before the path begins, or edges.size() if after the path ends)
   int Eval(Real t,Config& q) const;
+  ///Same as Eval(t,q), but the search starts at cursor, which is then moved
+  ///to the edge of t.  Evaluating increasing times, e.g. at a controller's
+  ///rate, takes O(1) amortized time each rather than O(#edges).
+  int Eval(Real t,Config& q,Cursor& cursor) const;
+  ///Evaluates the path at each of the times ts, and stores the
+  ///configurations in out, one row of Begin().n values per time.
+  void Eval(const vector<Real>& ts,vector<Real>& out) const;
   void Split(Real time,TimedMilestonePath& before,TimedMilestonePath& after) const;
 
   vector<SmartPointer<EdgePlanner> > edges;
@@ -103,6 +103,7 @@ bool TranslatingRobot2DCSpace::IsFeasible(const Config& x)
   T.R.setIdentity();
   Geometric2DCollection temp = robot;
   temp.Transform(T);
+  if(obstacleGrid.Matches(obstacles)) return !obstacleGrid.Collides(temp);
   if(obstacles.Collides(temp)) return false;
   return true;
 }
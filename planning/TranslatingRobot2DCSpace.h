@@ -12,6 +12,9 @@ public:
   void DrawWorkspaceGL() const;
   void DrawRobotGL(const Config& x) const;
   void DrawGL(const Config& q) const;
+  ///Builds obstacleGrid, which IsFeasible(x) then uses.  Call again after
+  ///changing the obstacles; until then IsFeasible(x) uses the exact checks.
+  void BuildObstacleGrid(Real cellSize=0) { obstacleGrid.Build(obstacles,cellSize); }
 
   virtual void Sample(Config& x);
   virtual void SampleNeighborhood(const Config& c,Real r,Config& x);
@@ -27,6 +30,7 @@ public:
   Real visibilityEpsilon;
   AABB2D domain;
   Geometric2DCollection obstacles;
+  Geometric2DCollectionGrid obstacleGrid;
   Geometric2DCollection robot;
 };
 
@@ -0,0 +1,313 @@
+#include "ArticulatedBody.h"
+#include "NewtonEuler.h"
+#include <math/random.h>
+#include <Timer.h>
+#include <stdio.h>
+using namespace std;
+
+//A -= s*a*b^t
+static inline void MaddOuterProduct(Matrix3& A,const Vector3& a,const Vector3& b,Real s)
+{
+  for(int i=0;i<3;i++)
+    for(int j=0;j<3;j++)
+      A(i,j) += s*a[i]*b[j];
+}
+
+ArticulatedBodySolver::ArticulatedBodySolver(RobotDynamics3D& _robot)
+  :robot(_robot)
+{
+  int n = (int)robot.links.size();
+  externalWrenches.resize(n);
+  for(int i=0;i<n;i++) {
+    externalWrenches[i].f.setZero();
+    externalWrenches[i].m.setZero();
+  }
+  T.resize(n);
+  data.resize(n);
+  ddqTemp.resize(n);
+}
+
+void ArticulatedBodySolver::SetGravityWrenches(const Vector3& gravity)
+{
+  for(size_t i=0;i<externalWrenches.size();i++) {
+    externalWrenches[i].f.mul(gravity,robot.links[i].mass);
+    externalWrenches[i].m.setZero();
+  }
+}
+
+void ArticulatedBodySolver::UpdateTransforms(const Real* q)
+{
+  RigidTransform Ti;
+  for(size_t i=0;i<robot.links.size();i++) {
+    const RobotLink3D& li = robot.links[i];
+    li.GetLocalTransform(q[i],Ti);
+    int p = robot.parents[i];
+    if(p < 0)
+      T[i].mul(li.T0_Parent,Ti);
+    else {
+      T[i].mul(T[p],li.T0_Parent);
+      T[i] *= Ti;
+    }
+  }
+}
+
+void ArticulatedBodySolver::CalcAccel(const Vector& t,Vector& ddq)
+{
+  int n = (int)robot.links.size();
+  Assert(t.n == 0 || t.n == n);
+  for(int i=0;i<n;i++)
+    T[i] = robot.links[i].T_World;
+  ddq.resize(n);
+  CalcAccel(robot.dq.getStart(),(t.n==0 ? NULL : t.getStart()),ddq.getStart());
+}
+
+void ArticulatedBodySolver::CalcAccel(const Real* q,const Real* dq,const Real* t,Real* ddq)
+{
+  UpdateTransforms(q);
+  CalcAccel(dq,t,ddq);
+}
+
+void ArticulatedBodySolver::CalcAccelBatch(int numInstances,const Real* q,const Real* dq,const Real* t,Real* ddq)
+{
+  int n = (int)robot.links.size();
+  for(int k=0;k<numInstances;k++) {
+    UpdateTransforms(q+k*n);
+    CalcAccel(dq+k*n,(t ? t+k*n : NULL),ddq+k*n);
+  }
+}
+
+void ArticulatedBodySolver::StepBatch(int numInstances,Real dt,Real* q,Real* dq,const Real* t)
+{
+  int n = (int)robot.links.size();
+  Real* ddq = ddqTemp.getStart();
+  for(int k=0;k<numInstances;k++) {
+    Real* qk = q+k*n;
+    Real* dqk = dq+k*n;
+    UpdateTransforms(qk);
+    CalcAccel(dqk,(t ? t+k*n : NULL),ddq);
+    for(int i=0;i<n;i++) {
+      dqk[i] += dt*ddq[i];
+      qk[i] += dt*dqk[i];
+    }
+  }
+}
+
+void ArticulatedBodySolver::CalcAccel(const Real* dq,const Real* t,Real* ddq)
+{
+  int n = (int)robot.links.size();
+  Matrix3 Iworld;
+  Vector3 z,com,hn,hf,temp;
+  //outward pass: velocities, velocity-product accelerations, and the rigid
+  //body inertias and bias forces
+  for(int i=0;i<n;i++) {
+    const RobotLink3D& li = robot.links[i];
+    LinkData& d = data[i];
+    z = T[i].R*li.w;
+    if(li.type == RobotLink3D::Revolute) {
+      d.Sw = z;
+      d.Sv.setCross(T[i].t,z);
+    }
+    else {
+      d.Sw.setZero();
+      d.Sv = z;
+    }
+    int p = robot.parents[i];
+    if(p < 0) {
+      d.vw.mul(d.Sw,dq[i]);
+      d.vv.mul(d.Sv,dq[i]);
+    }
+    else {
+      d.vw = data[p].vw; d.vw.madd(d.Sw,dq[i]);
+      d.vv = data[p].vv; d.vv.madd(d.Sv,dq[i]);
+    }
+    d.cw.setCross(d.vw,d.Sw);
+    d.cw *= dq[i];
+    d.cv.setCross(d.vw,d.Sv);
+    temp.setCross(d.vv,d.Sw);
+    d.cv += temp;
+    d.cv *= dq[i];
+
+    //spatial inertia about the origin: [Ic+m[c]^T[c], m[c]; m[c]^T, m*1]
+    Real m = li.mass;
+    T[i].mulPoint(li.com,com);
+    Iworld.mul(T[i].R,li.inertia);
+    d.IA.mulTransposeB(Iworld,T[i].R);
+    MaddOuterProduct(d.IA,com,com,-m);
+    Real cc = m*com.normSquared();
+    d.IA(0,0) += cc; d.IA(1,1) += cc; d.IA(2,2) += cc;
+    d.IB.setCrossProduct(com);
+    d.IB.inplaceMul(m);
+    d.IC.setZero();
+    d.IC(0,0) = d.IC(1,1) = d.IC(2,2) = m;
+
+    //momentum h = I*v, bias force p = v x* h - fext
+    hn = d.IA*d.vw;
+    hn += m*cross(com,d.vv);
+    hf.setCross(d.vw,com);
+    hf += d.vv;
+    hf *= m;
+    d.pn.setCross(d.vw,hn);
+    temp.setCross(d.vv,hf);
+    d.pn += temp;
+    d.pf.setCross(d.vw,hf);
+    const Wrench& w = externalWrenches[i];
+    d.pn -= w.m;
+    d.pn -= cross(com,w.f);
+    d.pf -= w.f;
+  }
+
+  //inward pass: articulated inertias and bias forces
+  Vector3 Icw,Icv;
+  for(int i=n-1;i>=0;i--) {
+    LinkData& d = data[i];
+    d.Un = d.IA*d.Sw;
+    d.Un += d.IB*d.Sv;
+    d.IB.mulTranspose(d.Sw,d.Uf);
+    d.Uf += d.IC*d.Sv;
+    d.D = d.Sw.dot(d.Un) + d.Sv.dot(d.Uf);
+    d.u = (t ? t[i] : 0.0) - d.Sw.dot(d.pn) - d.Sv.dot(d.pf);
+    bool frozen = false;
+    if(!(d.D > 0.0)) {
+      //check if the link is frozen.  If so, it moves rigidly with its parent
+      if(robot.qMin[i] == robot.qMax[i])
+        frozen = true;
+      else {
+        fprintf(stderr,"ArticulatedBodySolver: Warning, axis-wise inertia on link %d is invalid; %g\n",i,d.D);
+        d.D = Epsilon;
+      }
+    }
+    int p = robot.parents[i];
+    if(p < 0) continue;
+    if(!frozen) {
+      //I^a = I^A - U*U^T/D, in place since I^A is not needed afterward
+      Real s = -1.0/d.D;
+      MaddOuterProduct(d.IA,d.Un,d.Un,s);
+      MaddOuterProduct(d.IB,d.Un,d.Uf,s);
+      MaddOuterProduct(d.IC,d.Uf,d.Uf,s);
+    }
+    //p^a = p^A + I^a*c + U*u/D
+    LinkData& dp = data[p];
+    Icw = d.IA*d.cw;
+    Icw += d.IB*d.cv;
+    d.IB.mulTranspose(d.cw,Icv);
+    Icv += d.IC*d.cv;
+    dp.pn += d.pn;
+    dp.pn += Icw;
+    dp.pf += d.pf;
+    dp.pf += Icv;
+    if(!frozen) {
+      dp.pn.madd(d.Un,d.u/d.D);
+      dp.pf.madd(d.Uf,d.u/d.D);
+    }
+    dp.IA += d.IA;
+    dp.IB += d.IB;
+    dp.IC += d.IC;
+  }
+
+  //outward pass: accelerations
+  for(int i=0;i<n;i++) {
+    LinkData& d = data[i];
+    int p = robot.parents[i];
+    d.aw = d.cw;
+    d.av = d.cv;
+    if(p >= 0) {
+      d.aw += data[p].aw;
+      d.av += data[p].av;
+    }
+    if(!(d.D > 0.0)) {
+      //frozen
+      ddq[i] = 0;
+      continue;
+    }
+    ddq[i] = (d.u - d.Un.dot(d.aw) - d.Uf.dot(d.av))/d.D;
+    d.aw.madd(d.Sw,ddq[i]);
+    d.av.madd(d.Sv,ddq[i]);
+  }
+}
+
+Real BenchmarkForwardDynamics(RobotDynamics3D& robot,const Vector3& gravity,int numSamples)
+{
+  int n = (int)robot.links.size();
+  vector<Real> qs(numSamples*n),dqs(numSamples*n),ts(numSamples*n),ddqs(numSamples*n);
+  for(int k=0;k<numSamples;k++) {
+    for(int i=0;i<n;i++) {
+      Real lo = (IsFinite(robot.qMin(i)) ? robot.qMin(i) : -Pi);
+      Real hi = (IsFinite(robot.qMax(i)) ? robot.qMax(i) : Pi);
+      qs[k*n+i] = Rand(lo,hi);
+      dqs[k*n+i] = Rand(-1,1);
+      ts[k*n+i] = Rand(-1,1);
+    }
+  }
+  NewtonEulerSolver ne(robot);
+  ne.SetGravityWrenches(gravity);
+  ArticulatedBodySolver aba(robot);
+  aba.SetGravityWrenches(gravity);
+  Config q(n),dq(n);
+  Vector t(n),ddq,ddqAba(n),fext,G;
+
+  //check against the other methods
+  Real neError = 0, matrixError = 0, batchError = 0;
+  for(int k=0;k<numSamples;k++) {
+    q.copy(&qs[k*n]);
+    dq.copy(&dqs[k*n]);
+    t.copy(&ts[k*n]);
+    robot.UpdateConfig(q);
+    robot.dq = dq;
+    aba.CalcAccel(t,ddqAba);
+    ne.CalcAccel(t,ddq);
+    for(int i=0;i<n;i++) neError = Max(neError,Abs(ddq(i)-ddqAba(i)));
+    robot.UpdateDynamics();
+    robot.GetGravityTorques(gravity,G);
+    fext.sub(t,G);
+    robot.CalcAcceleration(ddq,fext);
+    for(int i=0;i<n;i++) matrixError = Max(matrixError,Abs(ddq(i)-ddqAba(i)));
+  }
+
+  Timer timer;
+  for(int k=0;k<numSamples;k++) {
+    q.copy(&qs[k*n]);
+    t.copy(&ts[k*n]);
+    robot.UpdateConfig(q);
+    robot.dq.copy(&dqs[k*n]);
+    robot.UpdateDynamics();
+    robot.GetGravityTorques(gravity,G);
+    fext.sub(t,G);
+    robot.CalcAcceleration(ddq,fext);
+  }
+  Real matrixTime = timer.ElapsedTime();
+  timer.Reset();
+  for(int k=0;k<numSamples;k++) {
+    q.copy(&qs[k*n]);
+    t.copy(&ts[k*n]);
+    robot.UpdateConfig(q);
+    robot.dq.copy(&dqs[k*n]);
+    ne.CalcAccel(t,ddq);
+  }
+  Real neTime = timer.ElapsedTime();
+  timer.Reset();
+  for(int k=0;k<numSamples;k++) {
+    q.copy(&qs[k*n]);
+    t.copy(&ts[k*n]);
+    robot.UpdateConfig(q);
+    robot.dq.copy(&dqs[k*n]);
+    aba.CalcAccel(t,ddqAba);
+  }
+  Real abaTime = timer.ElapsedTime();
+  timer.Reset();
+  aba.CalcAccelBatch(numSamples,&qs[0],&dqs[0],&ts[0],&ddqs[0]);
+  Real batchTime = timer.ElapsedTime();
+  for(int k=0;k<numSamples;k++) {
+    q.copy(&qs[k*n]);
+    robot.UpdateConfig(q);
+    robot.dq.copy(&dqs[k*n]);
+    t.copy(&ts[k*n]);
+    aba.CalcAccel(t,ddqAba);
+    for(int i=0;i<n;i++) batchError = Max(batchError,Abs(ddqs[k*n+i]-ddqAba(i)));
+  }
+  printf("Forward dynamics of %d links, %d states:\n",n,numSamples);
+  printf("  RobotDynamics3D::CalcAcceleration %gs, max difference %g\n",matrixTime,matrixError);
+  printf("  NewtonEulerSolver::CalcAccel %gs, max difference %g\n",neTime,neError);
+  printf("  ArticulatedBodySolver::CalcAccel %gs\n",abaTime);
+  printf("  ArticulatedBodySolver::CalcAccelBatch %gs, max difference %g\n",batchTime,batchError);
+  return Max(neError,matrixError,batchError);
+}
@@ -0,0 +1,83 @@
+#ifndef ROBOTICS_ARTICULATED_BODY_H
+#define ROBOTICS_ARTICULATED_BODY_H
+
+#include "RobotDynamics3D.h"
+#include "Wrench.h"
+#include <vector>
+
+/** @ingroup Kinematics
+ * @brief Forward dynamics with Featherstone's articulated-body algorithm,
+ * in O(n) time and without heap allocation.
+ *
+ * All workspaces are allocated in the constructor, so CalcAccel does no
+ * allocation, and unlike NewtonEulerSolver::CalcAccel it does not build
+ * dense 6x6 matrices.  The quantities are kept in world-frame spatial
+ * coordinates about the world origin, so no transforms are needed between
+ * parent and child, and the articulated inertias are stored as 3x3 blocks.
+ *
+ * CalcAccel(t,ddq) uses the robot's current q, dq, and frames, like
+ * NewtonEulerSolver.  CalcAccel(q,dq,t,ddq) computes the frames itself and
+ * does not touch the robot's state, and CalcAccelBatch and StepBatch apply
+ * it to many robot instances stored contiguously, instance k's state
+ * starting at element k*n of each array.
+ *
+ * externalWrenches are given about the link's center of mass, as in
+ * NewtonEulerSolver.  As there, a link with zero axis-wise inertia is
+ * treated as rigidly attached to its parent if its joint is frozen
+ * (qMin=qMax).
+ *
+ * The parent of each link must have a lower index than the link.
+ */
+struct ArticulatedBodySolver
+{
+  ArticulatedBodySolver(RobotDynamics3D& robot);
+  ///sets the external wrenches equal to gravity
+  void SetGravityWrenches(const Vector3& gravity);
+  ///forward dynamics, assuming the current state of the robot is updated
+  void CalcAccel(const Vector& t,Vector& ddq);
+  ///forward dynamics at the state (q,dq).  t may be NULL for zero torques
+  void CalcAccel(const Real* q,const Real* dq,const Real* t,Real* ddq);
+  ///forward dynamics of numInstances states
+  void CalcAccelBatch(int numInstances,const Real* q,const Real* dq,const Real* t,Real* ddq);
+  ///semi-implicit Euler step of numInstances states with the given torques
+  void StepBatch(int numInstances,Real dt,Real* q,Real* dq,const Real* t);
+
+  //helpers
+  void UpdateTransforms(const Real* q);
+  void CalcAccel(const Real* dq,const Real* t,Real* ddq);
+
+  RobotDynamics3D& robot;
+  std::vector<Wrench> externalWrenches;  ///<set these to the external wrenches on the links (moments about the CM)
+
+  //temporary: the link frames, and the per-link quantities of the
+  //algorithm.  Motion vectors are (angular,linear at the origin) and force
+  //vectors are (moment about the origin,force).
+  struct LinkData
+  {
+    Vector3 Sw,Sv;      ///<joint axis
+    Vector3 vw,vv;      ///<link velocity
+    Vector3 cw,cv;      ///<velocity-product acceleration
+    Vector3 pn,pf;      ///<articulated bias force
+    Vector3 aw,av;      ///<link acceleration
+    Vector3 Un,Uf;      ///<articulated inertia times the axis
+    Matrix3 IA,IB,IC;   ///<articulated inertia [IA IB; IB^T IC]
+    Real D,u;
+  };
+  std::vector<RigidTransform> T;
+  std::vector<LinkData> data;
+  Vector ddqTemp;
+};
+
+/** @ingroup Kinematics
+ * @brief Compares and times ArticulatedBodySolver against
+ * NewtonEulerSolver::CalcAccel and RobotDynamics3D::CalcAcceleration
+ * over numSamples random states under the given gravity, and prints the
+ * results.  Modifies the state of robot.  Returns the largest difference
+ * in ddq found.
+ *
+ * The velocity terms of the other two methods are inexact for moving
+ * prismatic joints, so differences there are expected.
+ */
+Real BenchmarkForwardDynamics(RobotDynamics3D& robot,const Vector3& gravity,int numSamples=1000);
+
+#endif
@@ -0,0 +1,186 @@
+#include "BatchKinematics3D.h"
+using namespace std;
+
+BatchKinematics3D::BatchKinematics3D()
+  :numConfigs(0)
+{}
+
+BatchKinematics3D::BatchKinematics3D(const RobotKinematics3D& robot)
+  :numConfigs(0)
+{
+  Initialize(robot);
+}
+
+void BatchKinematics3D::Initialize(const RobotKinematics3D& robot)
+{
+  int n = (int)robot.links.size();
+  parents = robot.parents;
+  types.resize(n);
+  axes.resize(n);
+  scales.resize(n);
+  T0_Parent.resize(n);
+  for(int i=0;i<n;i++) {
+    const RobotLink3D& link = robot.links[i];
+    Assert(parents[i] < i);
+    types[i] = link.type;
+    T0_Parent[i] = link.T0_Parent;
+    if(link.type == RobotLink3D::Revolute) {
+      //rotation by qi*w is a rotation by qi*|w| about w/|w|
+      scales[i] = link.w.norm();
+      if(scales[i] == 0) axes[i].setZero();
+      else axes[i] = link.w/scales[i];
+    }
+    else {
+      scales[i] = 1;
+      axes[i] = link.w;
+    }
+  }
+  numConfigs = 0;
+  data.resize(0);
+}
+
+void BatchKinematics3D::Compute(const vector<Config>& qs)
+{
+  int n = NumLinks();
+  vector<Real> packed(qs.size()*n);
+  for(size_t k=0;k<qs.size();k++) {
+    Assert(qs[k].n == n);
+    for(int i=0;i<n;i++) packed[k*n+i] = qs[k](i);
+  }
+  Compute(packed.empty() ? NULL : &packed[0],(int)qs.size(),n);
+}
+
+void BatchKinematics3D::Compute(const Real* qs,int _numConfigs,int stride)
+{
+  int n = NumLinks();
+  int N = _numConfigs;
+  numConfigs = N;
+  data.resize(n*NumComponents*N);
+  jointValues.resize(2*N);
+  if(N == 0) return;
+  Real* cs = &jointValues[0];
+  Real* sn = &jointValues[N];
+  //configurations are done in blocks, so that the parent transforms are
+  //still in cache when the children read them
+  const int blockSize = 256;
+  for(int k0=0;k0<N;k0+=blockSize) {
+    int k1 = Min(k0+blockSize,N);
+    for(int i=0;i<n;i++) {
+      Real* R[3][3];
+      for(int r=0;r<3;r++)
+        for(int c=0;c<3;c++)
+          R[r][c] = Component(i,r*3+c);
+      Real* t[3] = {Component(i,9),Component(i,10),Component(i,11)};
+      const RigidTransform& T0 = T0_Parent[i];
+
+      //T = T_World(parent)*T0_Parent
+      int p = parents[i];
+      if(p < 0) {
+        for(int r=0;r<3;r++) {
+          for(int c=0;c<3;c++) {
+            Real v = T0.R(r,c);
+            for(int k=k0;k<k1;k++) R[r][c][k] = v;
+          }
+          Real v = T0.t[r];
+          for(int k=k0;k<k1;k++) t[r][k] = v;
+        }
+      }
+      else {
+        for(int r=0;r<3;r++) {
+          const Real* P0 = Component(p,r*3);
+          const Real* P1 = Component(p,r*3+1);
+          const Real* P2 = Component(p,r*3+2);
+          const Real* Pt = Component(p,9+r);
+          for(int c=0;c<3;c++) {
+            Real a=T0.R(0,c), b=T0.R(1,c), d=T0.R(2,c);
+            Real* Rrc = R[r][c];
+            for(int k=k0;k<k1;k++)
+              Rrc[k] = P0[k]*a + P1[k]*b + P2[k]*d;
+          }
+          Real a=T0.t.x, b=T0.t.y, d=T0.t.z;
+          Real* tr = t[r];
+          for(int k=k0;k<k1;k++)
+            tr[k] = P0[k]*a + P1[k]*b + P2[k]*d + Pt[k];
+        }
+      }
+
+      //T = T*T(i->i)(qi)
+      const Vector3& w = axes[i];
+      if(types[i] == RobotLink3D::Prismatic) {
+        for(int k=k0;k<k1;k++) cs[k] = qs[k*stride+i];
+        for(int r=0;r<3;r++) {
+          const Real* R0 = R[r][0];
+          const Real* R1 = R[r][1];
+          const Real* R2 = R[r][2];
+          Real* tr = t[r];
+          for(int k=k0;k<k1;k++)
+            tr[k] += cs[k]*(R0[k]*w.x + R1[k]*w.y + R2[k]*w.z);
+        }
+      }
+      else {
+        Real scale = scales[i];
+        for(int k=k0;k<k1;k++) {
+          Real theta = qs[k*stride+i]*scale;
+          cs[k] = Cos(theta);
+          sn[k] = Sin(theta);
+        }
+        //R = R*L, where L is the rotation about a coordinate axis, or
+        //given by Rodrigues' formula L = cI + s[w] + (1-c)ww^T
+        int axis = -1;
+        if(w.x == One) axis = 0;
+        else if(w.y == One) axis = 1;
+        else if(w.z == One) axis = 2;
+        if(axis >= 0) {
+          //columns j,l of R rotate, with L(j,j)=L(l,l)=c, L(l,j)=s, L(j,l)=-s
+          int j = (axis+1)%3, l = (axis+2)%3;
+          for(int r=0;r<3;r++) {
+            Real* Rj = R[r][j];
+            Real* Rl = R[r][l];
+            for(int k=k0;k<k1;k++) {
+              Real a = Rj[k], b = Rl[k];
+              Rj[k] = a*cs[k] + b*sn[k];
+              Rl[k] = b*cs[k] - a*sn[k];
+            }
+          }
+        }
+        else for(int r=0;r<3;r++) {
+          Real* R0 = R[r][0];
+          Real* R1 = R[r][1];
+          Real* R2 = R[r][2];
+          for(int k=k0;k<k1;k++) {
+            Real c = cs[k], s = sn[k], v = 1-c;
+            Real L00 = c + w.x*w.x*v, L01 = w.x*w.y*v - w.z*s, L02 = w.x*w.z*v + w.y*s;
+            Real L10 = w.y*w.x*v + w.z*s, L11 = c + w.y*w.y*v, L12 = w.y*w.z*v - w.x*s;
+            Real L20 = w.z*w.x*v - w.y*s, L21 = w.z*w.y*v + w.x*s, L22 = c + w.z*w.z*v;
+            Real a = R0[k], b = R1[k], d = R2[k];
+            R0[k] = a*L00 + b*L10 + d*L20;
+            R1[k] = a*L01 + b*L11 + d*L21;
+            R2[k] = a*L02 + b*L12 + d*L22;
+          }
+        }
+      }
+    }
+  }
+}
+
+void BatchKinematics3D::GetTransform(int k,int link,RigidTransform& T) const
+{
+  Assert(k >= 0 && k < numConfigs);
+  for(int r=0;r<3;r++)
+    for(int c=0;c<3;c++)
+      T.R(r,c) = Component(link,r*3+c)[k];
+  T.t.set(Component(link,9)[k],Component(link,10)[k],Component(link,11)[k]);
+}
+
+void BatchKinematics3D::GetWorldPositions(const Vector3& pi,int link,vector<Vector3>& p) const
+{
+  p.resize(numConfigs);
+  for(int r=0;r<3;r++) {
+    const Real* R0 = Component(link,r*3);
+    const Real* R1 = Component(link,r*3+1);
+    const Real* R2 = Component(link,r*3+2);
+    const Real* tr = Component(link,9+r);
+    for(int k=0;k<numConfigs;k++)
+      p[k][r] = R0[k]*pi.x + R1[k]*pi.y + R2[k]*pi.z + tr[k];
+  }
+}
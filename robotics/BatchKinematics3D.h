@@ -0,0 +1,73 @@
+#ifndef ROBOTICS_BATCH_KINEMATICS_3D_H
+#define ROBOTICS_BATCH_KINEMATICS_3D_H
+
+#include "RobotKinematics3D.h"
+#include <vector>
+
+/** @ingroup Kinematics
+ * @brief Forward kinematics of many configurations at once, without
+ * touching the state of a RobotKinematics3D.
+ *
+ * The link parameters are copied from the robot at construction, so the
+ * robot may be modified or used by other threads afterwards.  Compute()
+ * walks the links in parent order once per batch, and for each link
+ * updates the transforms of all configurations in a loop over the
+ * configurations, which the compiler can vectorize.
+ *
+ * The transforms are stored as structure-of-arrays: component c of the
+ * transform of link i for configuration k is
+ * data[(i*NumComponents+c)*numConfigs+k], where the components are the
+ * rotation matrix entries R(0,0),R(0,1),R(0,2),R(1,0),...,R(2,2) followed
+ * by the translation t.x,t.y,t.z.  Component(i,c) points to the array of
+ * all configurations.
+ *
+ * Usage:
+ * @verbatim
+ * BatchKinematics3D batch(robot);
+ * batch.Compute(configs);
+ * RigidTransform T;
+ * batch.GetTransform(k,link,T);  //same as robot.links[link].T_World after
+ *                                //robot.UpdateConfig(configs[k])
+ * @endverbatim
+ */
+class BatchKinematics3D
+{
+ public:
+  enum { NumComponents = 12 };
+
+  BatchKinematics3D();
+  BatchKinematics3D(const RobotKinematics3D& robot);
+  ///Copies the link parameters of robot
+  void Initialize(const RobotKinematics3D& robot);
+  ///Computes the link transforms of each configuration in qs
+  void Compute(const std::vector<Config>& qs);
+  ///Computes the link transforms of numConfigs configurations, where
+  ///configuration k is qs[k*stride],...,qs[k*stride+numLinks-1]
+  void Compute(const Real* qs,int numConfigs,int stride);
+
+  inline int NumLinks() const { return (int)parents.size(); }
+  inline int NumConfigs() const { return numConfigs; }
+  inline Real* Component(int link,int c) { return &data[(link*NumComponents+c)*numConfigs]; }
+  inline const Real* Component(int link,int c) const { return &data[(link*NumComponents+c)*numConfigs]; }
+  ///Gets the world transform of link for configuration k
+  void GetTransform(int k,int link,RigidTransform& T) const;
+  ///Gets the world position of the point pi (local to link) for every
+  ///configuration
+  void GetWorldPositions(const Vector3& pi,int link,std::vector<Vector3>& p) const;
+
+  //link parameters
+  std::vector<int> parents;
+  std::vector<int> types;
+  ///Unit joint axes, and the scale of the joint value (the norm of
+  ///RobotLink3D::w) for revolute joints
+  std::vector<Vector3> axes;
+  std::vector<Real> scales;
+  std::vector<RigidTransform> T0_Parent;
+
+  int numConfigs;
+  std::vector<Real> data;
+  ///Temporary: the joint values of one link for all configurations
+  std::vector<Real> jointValues;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include "IKCache.h"
+#include "IKFunctions.h"
+#include <geometry/KDTree.h>
+#include <errors.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+using namespace std;
+using namespace Geometry;
+
+IKSolutionCache::Bucket::Bucket()
+  :tree(NULL)
+{}
+
+IKSolutionCache::Bucket::~Bucket()
+{
+  SafeDelete(tree);
+}
+
+void IKSolutionCache::Bucket::Rebuild()
+{
+  SafeDelete(tree);
+  if(!keys.empty())
+    tree = KDTree::Create(keys,keys[0].n,100);
+}
+
+IKSolutionCache::IKSolutionCache()
+  :maxSize(10000),rotationWeight(0.2),maxDistance(Inf),numEntries(0),useCounter(0)
+{
+  ResetStats();
+}
+
+IKSolutionCache::~IKSolutionCache()
+{
+  Clear();
+}
+
+void IKSolutionCache::Clear()
+{
+  for(map<string,Bucket*>::iterator i=buckets.begin();i!=buckets.end();i++)
+    delete i->second;
+  buckets.clear();
+  numEntries = 0;
+}
+
+void IKSolutionCache::ResetStats()
+{
+  numQueries = numHits = 0;
+  numWarmSolves = numColdSolves = numFailures = 0;
+  numEvicted = 0;
+}
+
+void IKSolutionCache::PrintStats() const
+{
+  printf("IK cache: %d entries in %d groups, %d queries, %d hits\n",numEntries,(int)buckets.size(),numQueries,numHits);
+  printf("  %d solved warm, %d solved cold, %d failed, %d evicted\n",numWarmSolves,numColdSolves,numFailures,numEvicted);
+}
+
+void IKSolutionCache::GetSignature(const vector<IKGoal>& goals,string& signature) const
+{
+  stringstream ss;
+  for(size_t i=0;i<goals.size();i++)
+    ss<<goals[i].link<<" "<<goals[i].destLink<<" "<<(int)goals[i].posConstraint<<" "<<(int)goals[i].rotConstraint<<";";
+  signature = ss.str();
+}
+
+void IKSolutionCache::GetKey(const vector<IKGoal>& goals,Vector& key) const
+{
+  int n=0;
+  for(size_t i=0;i<goals.size();i++) {
+    if(goals[i].posConstraint != IKGoal::PosNone) n += 3;
+    if(goals[i].rotConstraint != IKGoal::RotNone) n += 3;
+  }
+  key.resize(n);
+  n=0;
+  for(size_t i=0;i<goals.size();i++) {
+    if(goals[i].posConstraint != IKGoal::PosNone) {
+      goals[i].endPosition.get(key(n),key(n+1),key(n+2));
+      n += 3;
+    }
+    if(goals[i].rotConstraint != IKGoal::RotNone) {
+      Vector3 r = rotationWeight*goals[i].endRotation;
+      r.get(key(n),key(n+1),key(n+2));
+      n += 3;
+    }
+  }
+}
+
+bool IKSolutionCache::Lookup(const vector<IKGoal>& goals,Config& q,Real* distance)
+{
+  numQueries++;
+  string signature;
+  GetSignature(goals,signature);
+  map<string,Bucket*>::iterator i=buckets.find(signature);
+  if(i == buckets.end() || i->second->tree == NULL) return false;
+  Bucket* b = i->second;
+  Vector key;
+  GetKey(goals,key);
+  Real d;
+  int index = b->tree->ClosestPoint(key,d);
+  if(index < 0 || d > maxDistance) return false;
+  numHits++;
+  b->lastUsed[index] = ++useCounter;
+  q = b->solutions[index];
+  if(distance) *distance = d;
+  return true;
+}
+
+void IKSolutionCache::Add(const vector<IKGoal>& goals,const Config& q)
+{
+  string signature;
+  GetSignature(goals,signature);
+  Bucket*& b = buckets[signature];
+  if(!b) b = new Bucket;
+  Vector key;
+  GetKey(goals,key);
+  //the kd-tree refers to the keys' storage, so it is rebuilt if the keys
+  //are reallocated
+  bool moved = (b->keys.size() == b->keys.capacity());
+  b->keys.push_back(key);
+  b->goals.push_back(goals);
+  b->solutions.push_back(q);
+  b->lastUsed.push_back(++useCounter);
+  if(moved || b->tree == NULL) b->Rebuild();
+  else b->tree->Insert(b->keys.back(),(int)b->keys.size()-1,8);
+  numEntries++;
+  if(numEntries > maxSize) Evict();
+}
+
+void IKSolutionCache::Evict()
+{
+  //use counts are unique, so everything older than the threshold goes
+  vector<int> uses;
+  uses.reserve(numEntries);
+  for(map<string,Bucket*>::iterator i=buckets.begin();i!=buckets.end();i++)
+    uses.insert(uses.end(),i->second->lastUsed.begin(),i->second->lastUsed.end());
+  int numRemove = Max(numEntries - maxSize*3/4,1);
+  nth_element(uses.begin(),uses.begin()+(numRemove-1),uses.end());
+  int threshold = uses[numRemove-1];
+  map<string,Bucket*>::iterator i=buckets.begin();
+  while(i!=buckets.end()) {
+    Bucket* b = i->second;
+    size_t k=0;
+    for(size_t j=0;j<b->keys.size();j++) {
+      if(b->lastUsed[j] <= threshold) continue;
+      if(k != j) {
+        b->keys[k] = b->keys[j];
+        b->goals[k].swap(b->goals[j]);
+        b->solutions[k] = b->solutions[j];
+        b->lastUsed[k] = b->lastUsed[j];
+      }
+      k++;
+    }
+    if(k == b->keys.size()) { i++; continue; }
+    numEvicted += (int)(b->keys.size()-k);
+    numEntries -= (int)(b->keys.size()-k);
+    if(k == 0) {
+      delete b;
+      buckets.erase(i++);
+      continue;
+    }
+    b->keys.resize(k);
+    b->goals.resize(k);
+    b->solutions.resize(k);
+    b->lastUsed.resize(k);
+    b->Rebuild();
+    i++;
+  }
+}
+
+bool IKSolutionCache::Solve(RobotKinematics3D& robot,const vector<IKGoal>& goals,Real tolerance,int& iters)
+{
+  int maxIters = iters;
+  iters = 0;
+  Config q0 = robot.q;
+  Config qcache;
+  if(Lookup(goals,qcache)) {
+    robot.UpdateConfig(qcache);
+    int warmIters = maxIters;
+    bool res = SolveIK(robot,goals,tolerance,warmIters,0);
+    iters += warmIters;
+    if(res) {
+      numWarmSolves++;
+      Add(goals,robot.q);
+      return true;
+    }
+    robot.UpdateConfig(q0);
+  }
+  int coldIters = maxIters;
+  bool res = SolveIK(robot,goals,tolerance,coldIters,0);
+  iters += coldIters;
+  if(res) {
+    numColdSolves++;
+    Add(goals,robot.q);
+    return true;
+  }
+  numFailures++;
+  return false;
+}
+
+bool IKSolutionCache::Save(const char* fn) const
+{
+  ofstream out(fn,ios::out);
+  if(!out) {
+    fprintf(stderr,"IKSolutionCache::Save: could not open %s\n",fn);
+    return false;
+  }
+  out.precision(17);
+  out<<"IKSolutionCache "<<numEntries<<endl;
+  for(map<string,Bucket*>::const_iterator i=buckets.begin();i!=buckets.end();i++) {
+    const Bucket* b = i->second;
+    for(size_t j=0;j<b->solutions.size();j++) {
+      out<<b->goals[j].size()<<endl;
+      for(size_t k=0;k<b->goals[j].size();k++)
+        out<<b->goals[j][k];
+      out<<b->solutions[j]<<endl;
+    }
+  }
+  out.close();
+  return (bool)out;
+}
+
+bool IKSolutionCache::Load(const char* fn)
+{
+  ifstream in(fn,ios::in);
+  if(!in) {
+    fprintf(stderr,"IKSolutionCache::Load: could not open %s\n",fn);
+    return false;
+  }
+  string header;
+  int n;
+  in>>header>>n;
+  if(!in || header != "IKSolutionCache" || n < 0) {
+    fprintf(stderr,"IKSolutionCache::Load: %s is not an IK cache file\n",fn);
+    return false;
+  }
+  Clear();
+  vector<IKGoal> goals;
+  Config q;
+  for(int i=0;i<n;i++) {
+    int numGoals;
+    in>>numGoals;
+    if(!in || numGoals < 0) {
+      fprintf(stderr,"IKSolutionCache::Load: error reading entry %d of %s\n",i,fn);
+      return false;
+    }
+    goals.resize(numGoals);
+    for(int k=0;k<numGoals;k++)
+      in>>goals[k];
+    in>>q;
+    if(!in) {
+      fprintf(stderr,"IKSolutionCache::Load: error reading entry %d of %s\n",i,fn);
+      return false;
+    }
+    Add(goals,q);
+  }
+  return true;
+}
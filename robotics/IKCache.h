@@ -0,0 +1,90 @@
+#ifndef ROBOTICS_IK_CACHE_H
+#define ROBOTICS_IK_CACHE_H
+
+#include "RobotKinematics3D.h"
+#include "IK.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Geometry { class KDTree; }
+
+/** @ingroup Kinematics
+ * @brief A cache of solved IK problems, used to warm-start the IK solver
+ * from the solution of the most similar previous problem.
+ *
+ * Problems are grouped by their signature: the link, destination link, and
+ * constraint types of each goal.  Within a group, a problem is keyed by
+ * the endPosition of each goal with a position constraint, and
+ * rotationWeight*endRotation of each goal with a rotation constraint, and
+ * the nearest key is found with a kd-tree.
+ *
+ * Solve() looks up the nearest stored solution, solves from it, and if
+ * that fails, solves again from the robot's current configuration.
+ * Successful solutions are added to the cache.  When the cache has more
+ * than maxSize entries, the least recently used quarter of them is
+ * removed.
+ */
+class IKSolutionCache
+{
+ public:
+  IKSolutionCache();
+  ~IKSolutionCache();
+  void Clear();
+  ///Returns the number of stored solutions
+  int Size() const { return numEntries; }
+  ///Gets the nearest stored solution to the problem goals.  Returns false
+  ///if there is none within maxDistance.
+  bool Lookup(const std::vector<IKGoal>& goals,Config& q,Real* distance=NULL);
+  ///Adds a solution to the problem goals
+  void Add(const std::vector<IKGoal>& goals,const Config& q);
+  ///Solves the IK problem with SolveIK, warm-started from the cache, and
+  ///adds the solution.  On success the solution is in robot.q, otherwise
+  ///robot.q is the result of the last attempt.  iters is the maximum
+  ///number of iterations per attempt, and returns the total.
+  bool Solve(RobotKinematics3D& robot,const std::vector<IKGoal>& goals,Real tolerance,int& iters);
+  bool Save(const char* fn) const;
+  bool Load(const char* fn);
+  void ResetStats();
+  void PrintStats() const;
+
+  void GetSignature(const std::vector<IKGoal>& goals,std::string& signature) const;
+  void GetKey(const std::vector<IKGoal>& goals,Vector& key) const;
+
+  ///Maximum number of stored solutions (default 10000)
+  int maxSize;
+  ///Scale of the rotation terms of the key relative to the position terms
+  ///(default 0.2, i.e., 1 radian counts as 0.2 units of distance)
+  Real rotationWeight;
+  ///Stored solutions farther than this from the query are not used (default Inf)
+  Real maxDistance;
+
+  //statistics
+  int numQueries;      ///<calls to Lookup
+  int numHits;         ///<lookups that found a solution
+  int numWarmSolves;   ///<solves that succeeded from the cached solution
+  int numColdSolves;   ///<solves that succeeded from the robot's configuration
+  int numFailures;     ///<solves that failed
+  int numEvicted;      ///<solutions removed because the cache was full
+
+  //internal: the solutions of the problems with one signature
+  struct Bucket
+  {
+    Bucket();
+    ~Bucket();
+    void Rebuild();
+
+    std::vector<std::vector<IKGoal> > goals;
+    std::vector<Vector> keys;
+    std::vector<Config> solutions;
+    std::vector<int> lastUsed;
+    Geometry::KDTree* tree;
+  };
+  void Evict();
+
+  std::map<std::string,Bucket*> buckets;
+  int numEntries;
+  int useCounter;
+};
+
+#endif
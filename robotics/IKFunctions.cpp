@@ -308,101 +308,125 @@ Real IKGoalFunction::Eval_i(const Vector& x, int i)
   return Zero;
 }
 
-void IKGoalFunction::Jacobian(const Vector& x, Matrix& J)
+void IKGoalFunction::UpdateJacobianTemps()
 {
   UpdateEERot();
-  for(int k=0;k<x.n;k++) {
-    int baseLink = GetDOF(k);
-    Vector3 dp;
-    robot.GetPositionJacobian(goal.localPosition,goal.link,baseLink,dp);
-    if(goal.posConstraint==IKGoal::PosFixed) {
-      for(int j=0;j<3;j++)
-	J(j,k) = positionScale*dp[j];
-    }
-    else if(goal.posConstraint == IKGoal::PosLinear) {
-      Vector3 xb,yb;
-      Vector3 d;
-      if(goal.destLink < 0) d=goal.direction;
-      else d=robot.links[goal.destLink].T_World.R*goal.direction;
-      GetCanonicalBasis(d,xb,yb);
-      J(0,k) = positionScale*dot(dp,xb);
-      J(1,k) = positionScale*dot(dp,yb);
-    }
-    else if(goal.posConstraint == IKGoal::PosPlanar) {
-      Vector3 d;
-      if(goal.destLink < 0) d=goal.direction;
-      else d=robot.links[goal.destLink].T_World.R*goal.direction;
-      J(0,k) = positionScale*dot(dp,d);
-    }
+  robot.GetAncestors(goal.link,linkAncestors);
+  robot.GetWorldPosition(goal.localPosition,goal.link,pworld);
+  if(goal.destLink >= 0) {
+    if(goal.posConstraint == IKGoal::PosLinear || goal.posConstraint == IKGoal::PosPlanar || goal.rotConstraint == IKGoal::RotAxis)
+      FatalError("TODO: link-to-link fancy constraints");
+    robot.GetAncestors(goal.destLink,destAncestors);
+    robot.GetWorldPosition(goal.endPosition,goal.destLink,pdestworld);
+  }
+  else
+    destAncestors.clear();
+  if(goal.posConstraint == IKGoal::PosLinear || goal.posConstraint == IKGoal::PosPlanar) {
+    posDir = goal.direction;
+    if(goal.posConstraint == IKGoal::PosLinear)
+      GetCanonicalBasis(posDir,posBasis[0],posBasis[1]);
+  }
+  if(goal.rotConstraint==IKGoal::RotAxis) {
+    rotDir = goal.endRotation;
+    GetCanonicalBasis(rotDir,rotBasis[0],rotBasis[1]);
+    robot.links[goal.link].T_World.R.mul(goal.localAxis,curAxis);
+  }
+  else if(goal.rotConstraint!=IKGoal::RotFixed && goal.rotConstraint!=IKGoal::RotNone) {
+    printf("GetIKJacobian(): Invalid number of rotation terms\n");
+    Abort(); 
+  }
+}
 
-    if(goal.destLink >= 0) {
-      Vector3 dpdest;
-      robot.GetPositionJacobian(goal.endPosition,goal.destLink,baseLink,dpdest);
-      if(goal.posConstraint==IKGoal::PosFixed) {
-	for(int j=0;j<3;j++)
-	  J(j,k) -= positionScale*dpdest[j];
-      }
-      else if(goal.posConstraint == IKGoal::PosLinear) {
-	FatalError("TODO: link-to-link fancy constraints");
-	Vector3 xb,yb;
-	Vector3 d;
-	if(goal.destLink < 0) d=goal.direction;
-	else d=robot.links[goal.destLink].T_World.R*goal.direction;
-	GetCanonicalBasis(d,xb,yb);
-	J(0,k) -= positionScale*dot(dpdest,xb);
-	J(1,k) -= positionScale*dot(dpdest,yb);
-      }
-      else if(goal.posConstraint == IKGoal::PosPlanar) {
-	FatalError("TODO: link-to-link fancy constraints");
-	Vector3 d;
-	if(goal.destLink < 0) d=goal.direction;
-	else d=robot.links[goal.destLink].T_World.R*goal.direction;
-	J(0,k) -= positionScale*dot(dpdest,d);
-      }
-    }
+void IKGoalFunction::GetJacobianColumn(int baseLink,Real* Jk) const
+{
+  bool onLink = linkAncestors[baseLink];
+  bool onDest = (!destAncestors.empty() && destAncestors[baseLink]);
+  const RobotLink3D& link = robot.links[baseLink];
+  Vector3 dp(Zero);
+  if(onLink) link.GetPositionJacobian(robot.q(baseLink),pworld,dp);
+  if(onDest) {
+    Vector3 dpdest;
+    link.GetPositionJacobian(robot.q(baseLink),pdestworld,dpdest);
+    dp -= dpdest;
+  }
+  if(goal.posConstraint==IKGoal::PosFixed) {
+    for(int j=0;j<3;j++)
+      Jk[j] = positionScale*dp[j];
+  }
+  else if(goal.posConstraint == IKGoal::PosLinear) {
+    Jk[0] = positionScale*dot(dp,posBasis[0]);
+    Jk[1] = positionScale*dot(dp,posBasis[1]);
+  }
+  else if(goal.posConstraint == IKGoal::PosPlanar) {
+    Jk[0] = positionScale*dot(dp,posDir);
+  }
 
-    int m=IKGoal::NumDims(goal.posConstraint);
-    Vector3 dr,dw;
-    if(goal.rotConstraint==IKGoal::RotFixed) {
-      robot.GetOrientationJacobian(goal.link,baseLink,dw);
-      if(goal.destLink >= 0) {
-	//m = moment(Rdiff)
-	//dRdiff = d/dt(R1(q)Rl^T R2^T(q))
-	//       = dR1/dt(q)Rl^TR2^T(q) + R1(q)Rl^TdR2/dt^T(q)
-	//       = [w1]R1 Rl^T R2^T + R1 Rl^T R2^T [-w2]
-	//       = [w1]R1 Rl^T R2^T - [R1 Rl^T R2^R w2] R1 Rl^T R2^T
-	//assume dRdiff = [w]Rdiff, then w = w1-eerot*w2
-	Vector3 dwdest;
-	robot.GetOrientationJacobian(goal.destLink,baseLink,dwdest);
-	dw -= eerot*dwdest;
-      }
-      MomentDerivative(eerot,dw,dr);
-      //robot.GetWorldRotationDeriv_Moment(goal.link,baseLink,dr);
-      J(m,k) = rotationScale*dr.x;
-      J(m+1,k) = rotationScale*dr.y;
-      J(m+2,k) = rotationScale*dr.z;
-    }
-    else if(goal.rotConstraint==IKGoal::RotAxis) {
-      Vector3 x,y;
-      Vector3 d;
-      if(goal.destLink < 0) d=goal.endRotation;
-      else d = robot.links[goal.destLink].T_World.R*goal.endRotation;
-      if(goal.destLink >= 0) 
-	FatalError("TODO: link-to-link fancy constraints");
-      GetCanonicalBasis(d,x,y);
-      robot.GetOrientationJacobian(goal.link,baseLink,dr);
-      Vector3 curAxis;
-      robot.links[goal.link].T_World.R.mul(goal.localAxis,curAxis);
-      Vector3 axisRateOfChange = cross(dr,curAxis);
-      J(m,k) = rotationScale*(Sign(dot(curAxis,x))*dot(axisRateOfChange,x)-dot(axisRateOfChange,d));
-      J(m+1,k) = rotationScale*(Sign(dot(curAxis,y))*dot(axisRateOfChange,y)-dot(axisRateOfChange,d));
-    }
-    else if(goal.rotConstraint==IKGoal::RotNone) {
-    }
-    else {
-      printf("GetIKJacobian(): Invalid number of rotation terms\n");
-      Abort(); 
+  int m=IKGoal::NumDims(goal.posConstraint);
+  Vector3 dw(Zero);
+  if(onLink) link.GetOrientationJacobian(dw);
+  if(goal.rotConstraint==IKGoal::RotFixed) {
+    if(onDest) {
+      //m = moment(Rdiff)
+      //dRdiff = d/dt(R1(q)Rl^T R2^T(q))
+      //       = dR1/dt(q)Rl^TR2^T(q) + R1(q)Rl^TdR2/dt^T(q)
+      //       = [w1]R1 Rl^T R2^T + R1 Rl^T R2^T [-w2]
+      //       = [w1]R1 Rl^T R2^T - [R1 Rl^T R2^R w2] R1 Rl^T R2^T
+      //assume dRdiff = [w]Rdiff, then w = w1-eerot*w2
+      Vector3 dwdest;
+      link.GetOrientationJacobian(dwdest);
+      dw -= eerot*dwdest;
     }
+    Vector3 dr;
+    MomentDerivative(eerot,dw,dr);
+    Jk[m] = rotationScale*dr.x;
+    Jk[m+1] = rotationScale*dr.y;
+    Jk[m+2] = rotationScale*dr.z;
+  }
+  else if(goal.rotConstraint==IKGoal::RotAxis) {
+    Vector3 axisRateOfChange = cross(dw,curAxis);
+    Jk[m] = rotationScale*(Sign(dot(curAxis,rotBasis[0]))*dot(axisRateOfChange,rotBasis[0])-dot(axisRateOfChange,rotDir));
+    Jk[m+1] = rotationScale*(Sign(dot(curAxis,rotBasis[1]))*dot(axisRateOfChange,rotBasis[1])-dot(axisRateOfChange,rotDir));
+  }
+}
+
+void IKGoalFunction::GetNonzeroColumns(int n,vector<int>& columns)
+{
+  if(linkAncestors.size() != robot.links.size()) UpdateJacobianTemps();
+  columns.resize(0);
+  for(int k=0;k<n;k++) {
+    int baseLink = GetDOF(k);
+    if(linkAncestors[baseLink] || (!destAncestors.empty() && destAncestors[baseLink]))
+      columns.push_back(k);
+  }
+}
+
+void IKGoalFunction::Jacobian(const Vector& x, Matrix& J)
+{
+  //only the ancestors of the goal links have nonzero columns
+  UpdateJacobianTemps();
+  GetNonzeroColumns(x.n,columns);
+  J.setZero();
+  Real Jk[6];
+  for(size_t c=0;c<columns.size();c++) {
+    int k=columns[c];
+    GetJacobianColumn(GetDOF(k),Jk);
+    for(int i=0;i<J.m;i++) J(i,k) = Jk[i];
+  }
+}
+
+void IKGoalFunction::Jacobian_Sparse(const Vector& x, SparseMatrix& J)
+{
+  UpdateJacobianTemps();
+  GetNonzeroColumns(x.n,columns);
+  J.resize(NumDimensions(),x.n);
+  J.setZero();
+  Real Jk[6];
+  for(size_t c=0;c<columns.size();c++) {
+    int k=columns[c];
+    GetJacobianColumn(GetDOF(k),Jk);
+    //columns are increasing, so these are appended at the end of each row
+    for(int i=0;i<J.m;i++)
+      if(Jk[i] != Zero) J.rows[i].push_back(k,Jk[i]);
   }
 }
 
@@ -763,6 +787,43 @@ void RobotIKFunction::PreEval(const Vector& x)
   CompositeVectorFieldFunction::PreEval(x);
 }
 
+void RobotIKFunction::Jacobian_Sparse(const Vector& x,SparseMatrix& J)
+{
+  J.resize(NumDimensions(),x.n);
+  J.setZero();
+  SparseMatrix Jf;
+  Matrix Jdense;
+  int offset=0;
+  for(size_t i=0;i<functions.size();i++) {
+    int m=functions[i]->NumDimensions();
+    IKGoalFunction* ik = dynamic_cast<IKGoalFunction*>((VectorFieldFunction*)functions[i]);
+    if(ik) {
+      ik->Jacobian_Sparse(x,Jf);
+      for(int j=0;j<m;j++)
+        J.rows[offset+j].entries.swap(Jf.rows[j].entries);
+    }
+    else {
+      Jdense.resize(m,x.n);
+      functions[i]->Jacobian(x,Jdense);
+      J.copySubMatrix(offset,0,Jdense);
+    }
+    offset += m;
+  }
+}
+
+
+
+RobotIKSparseFunction::RobotIKSparseFunction(RobotIKFunction& f)
+  :function(f)
+{}
+
+void RobotIKSparseFunction::Jacobian_i_Sparse(const Vector& x,int i,SparseVector& Ji)
+{
+  Vector temp(x.n);
+  function.Jacobian_i(x,i,temp);
+  Ji.set(temp);
+}
+
 
 
 
@@ -772,7 +833,7 @@ void RobotIKFunction::PreEval(const Vector& x)
 
 
 RobotIKSolver::RobotIKSolver(RobotIKFunction& f)
-  :solver(&f),function(f),robot(f.robot)
+  :solver(&f),function(f),sparseFunction(f),robot(f.robot)
 {
   solver.svd.preMultiply = false;
 }
@@ -825,6 +886,13 @@ void RobotIKSolver::ClearJointLimits()
   solver.bmax.clear();
 }
 
+void RobotIKSolver::UseSparseJacobian(bool sparse)
+{
+  solver.sparse = sparse;
+  if(sparse) solver.func = &sparseFunction;
+  else solver.func = &function;
+}
+
 void RobotIKSolver::RobotToState()
 {
   solver.x.resize(function.activeDofs.Size());
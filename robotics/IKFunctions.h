@@ -4,6 +4,7 @@
 #include "RobotKinematics3D.h"
 #include "IK.h"
 #include <KrisLibrary/math/vectorfunction.h>
+#include <KrisLibrary/math/sparsefunction.h>
 #include <KrisLibrary/optimization/Newton.h>
 #include <KrisLibrary/utils/ArrayMapping.h>
 #include <KrisLibrary/utils/DirtyData.h>
@@ -43,6 +44,9 @@ struct RobotIKFunction : public CompositeVectorFieldFunction
   void SetState(const Vector& x) const;
   void GetState(Vector& x) const;
   virtual void PreEval(const Vector& x);
+  ///Computes the Jacobian as a sparse matrix.  The IK goals only fill in
+  ///the columns of the active dofs that are ancestors of their links.
+  void Jacobian_Sparse(const Vector& x,SparseMatrix& J);
 
   RobotKinematics3D& robot;
 
@@ -50,6 +54,24 @@ struct RobotIKFunction : public CompositeVectorFieldFunction
   //vector<Real> scaleDofs; TODO? enable scaling of dofs
 };
 
+/** @brief Presents a RobotIKFunction as a SparseVectorFunction, so that it
+ * can be solved with NewtonRoot's sparse least-squares steps.
+ */
+struct RobotIKSparseFunction : public SparseVectorFunction
+{
+  RobotIKSparseFunction(RobotIKFunction& function);
+  virtual std::string Label() const { return function.Label(); }
+  virtual std::string Label(int i) const { return function.Label(i); }
+  virtual int NumDimensions() const { return function.NumDimensions(); }
+  virtual void PreEval(const Vector& x) { function.PreEval(x); }
+  virtual void Eval(const Vector& x,Vector& v) { function.Eval(x,v); }
+  virtual Real Eval_i(const Vector& x,int i) { return function.Eval_i(x,i); }
+  virtual void Jacobian_Sparse(const Vector& x,SparseMatrix& J) { function.Jacobian_Sparse(x,J); }
+  virtual void Jacobian_i_Sparse(const Vector& x,int i,SparseVector& Ji);
+
+  RobotIKFunction& function;
+};
+
 /** @brief A Newton-Raphson robot IK solver.
  * 
  * Joint limits are optionally included if the UseJointLimits() functions
@@ -63,6 +85,11 @@ struct RobotIKFunction : public CompositeVectorFieldFunction
  * than t. Specifying a value less than 2pi is useful to avoid local minima
  * for joints with wide ranges, because it allows the joint angle to pass from
  * -pi to pi, and vice versa.
+ *
+ * For robots with many links and IK goals, UseSparseJacobian() builds the
+ * Jacobian as a sparse matrix and solves each Newton step with LSQR
+ * instead of a dense SVD.  The bias configuration is not supported in
+ * this mode.
  */
 struct RobotIKSolver
 {
@@ -71,6 +98,7 @@ struct RobotIKSolver
   void UseJointLimits(const Vector& qmin,const Vector& qmax);
   void UseBiasConfiguration(const Vector& qdesired);
   void ClearJointLimits();
+  void UseSparseJacobian(bool sparse=true);
   void RobotToState();
   void StateToRobot();
   bool Solve(Real tolerance,int& iters);
@@ -78,6 +106,7 @@ struct RobotIKSolver
 
   Optimization::NewtonRoot solver;
   RobotIKFunction& function;
+  RobotIKSparseFunction sparseFunction;
   RobotKinematics3D& robot;
 };
 
@@ -176,9 +205,20 @@ struct IKGoalFunction : public VectorFieldFunction
   virtual void Jacobian(const Vector& x, Matrix& J);
   virtual void Jacobian_i(const Vector& x, int i, Vector& Ji);
   virtual void Hessian_i(const Vector& x,int i,Matrix& Hi);
+  ///Same as Jacobian, but J is sparse.  Only the columns in
+  ///GetNonzeroColumns() are filled in.
+  void Jacobian_Sparse(const Vector& x, SparseMatrix& J);
+  ///Returns the columns of the Jacobian that are not structurally zero,
+  ///i.e., the active dofs that are ancestors of goal.link or goal.destLink
+  void GetNonzeroColumns(int n,std::vector<int>& columns);
 
   void UpdateEEPos();
   void UpdateEERot();
+  ///Computes the quantities shared by all columns of the Jacobian
+  void UpdateJacobianTemps();
+  ///Computes the Jacobian column of the dof baseLink into Jk, after
+  ///UpdateJacobianTemps()
+  void GetJacobianColumn(int baseLink,Real* Jk) const;
 
   RobotKinematics3D& robot;
   const IKGoal& goal;
@@ -188,6 +228,12 @@ struct IKGoalFunction : public VectorFieldFunction
   DirtyData<Vector3> eepos;
   DirtyData<Matrix3> eerot;
   DirtyData<std::vector<Matrix> > H;
+  //temporaries for the Jacobian: the ancestors of goal.link and
+  //goal.destLink, the world positions of the goal points, and the
+  //constraint directions
+  std::vector<bool> linkAncestors,destAncestors;
+  Vector3 pworld,pdestworld,posDir,posBasis[2],rotDir,rotBasis[2],curAxis;
+  std::vector<int> columns;
 };
 
 /** @brief Function class that measures the difference between the robot's
@@ -0,0 +1,141 @@
+#include "MultiStartIK.h"
+#include "IKFunctions.h"
+#include <math/random.h>
+#include <utils/threadutils.h>
+using namespace std;
+
+struct MultiStartIKShared
+{
+  MultiStartIKSolver* solver;
+  const vector<IKGoal>* goals;
+  Real tolerance;
+  int maxIters;
+
+  //protected by mutex
+  Mutex mutex;
+  int nextStart;
+  bool done;
+  int numSolved;
+  int bestStart;
+  Real bestCost;
+  Config best;
+};
+
+//returns true if the solve converged
+static bool RunStart(MultiStartIKShared* shared,RobotKinematics3D& robot,int k)
+{
+  MultiStartIKSolver* s = shared->solver;
+  if(k > 0) {
+    RNG64 rng;
+    rng.seed(s->seed,k);
+    RNG64* oldRng = threadRng;
+    threadRng = &rng;
+    s->SampleSeed(k,robot.q);
+    threadRng = oldRng;
+  }
+  robot.UpdateFrames();
+
+  RobotIKFunction function(robot);
+  function.UseIK(*shared->goals);
+  if(s->activeDofs.empty())
+    GetDefaultIKDofs(robot,*shared->goals,function.activeDofs);
+  else
+    function.activeDofs.mapping = s->activeDofs;
+  RobotIKSolver solver(function);
+  solver.UseJointLimits(s->revJointThreshold);
+  solver.solver.verbose = 0;
+  solver.solver.tolf = shared->tolerance;
+  solver.solver.tolx = shared->tolerance*0.01;
+  solver.RobotToState();
+  int itersLeft = shared->maxIters;
+  bool solved = false;
+  while(itersLeft > 0) {
+    int iters = Min(itersLeft,Max(s->itersPerCheck,1));
+    ConvergenceResult res;
+    solved = solver.solver.GlobalSolve(iters,&res);
+    itersLeft -= Max(iters,1);
+    if(solved || res != MaxItersReached) break;
+    ScopedLock lock(shared->mutex);
+    if(shared->done) break;
+  }
+  if(!solved) return false;
+  solver.StateToRobot();
+  return true;
+}
+
+static void* MultiStartIKThreadFunc(void* vdata)
+{
+  MultiStartIKShared* shared = (MultiStartIKShared*)vdata;
+  MultiStartIKSolver* s = shared->solver;
+  RobotKinematics3D robot = s->robot;
+  Config q0 = s->robot.q;
+  while(true) {
+    int k;
+    {
+      ScopedLock lock(shared->mutex);
+      if(shared->done || shared->nextStart >= s->numStarts) break;
+      k = shared->nextStart++;
+    }
+    robot.q = q0;
+    if(!RunStart(shared,robot,k)) continue;
+    Real cost = s->Cost(robot.q);
+    ScopedLock lock(shared->mutex);
+    shared->numSolved++;
+    //ties go to the lower start index, so that the result does not depend
+    //on the order in which the starts finish
+    if(shared->bestStart < 0 || cost < shared->bestCost ||
+       (cost == shared->bestCost && k < shared->bestStart)) {
+      shared->bestStart = k;
+      shared->bestCost = cost;
+      shared->best = robot.q;
+    }
+    if(cost <= s->acceptCost) shared->done = true;
+  }
+  return NULL;
+}
+
+MultiStartIKSolver::MultiStartIKSolver(const RobotKinematics3D& _robot)
+  :robot(_robot),numThreads(4),numStarts(16),itersPerCheck(5),seed(0),
+   acceptCost(Inf),revJointThreshold(TwoPi),
+   numStarted(0),numSolved(0),bestStart(-1),bestCost(Inf)
+{}
+
+void MultiStartIKSolver::SampleSeed(int k,Config& q)
+{
+  for(int i=0;i<q.n;i++) {
+    Real lo = (IsFinite(robot.qMin(i)) ? robot.qMin(i) : -Pi);
+    Real hi = (IsFinite(robot.qMax(i)) ? robot.qMax(i) : Pi);
+    q(i) = Rand(lo,hi);
+  }
+}
+
+bool MultiStartIKSolver::Solve(const vector<IKGoal>& goals,Real tolerance,int maxIters,Config& q)
+{
+  MultiStartIKShared shared;
+  shared.solver = this;
+  shared.goals = &goals;
+  shared.tolerance = tolerance;
+  shared.maxIters = maxIters;
+  shared.nextStart = 0;
+  shared.done = false;
+  shared.numSolved = 0;
+  shared.bestStart = -1;
+  shared.bestCost = Inf;
+
+  int numWorkers = Max(1,Min(numThreads,numStarts));
+  vector<Thread> threads;
+  threads.reserve(numWorkers);
+  for(int w=1;w<numWorkers;w++)
+    threads.push_back(ThreadStart(MultiStartIKThreadFunc,&shared));
+  MultiStartIKThreadFunc(&shared);
+  for(size_t i=0;i<threads.size();i++)
+    ThreadJoin(threads[i]);
+
+  numStarted = Min(shared.nextStart,numStarts);
+  numSolved = shared.numSolved;
+  bestStart = shared.bestStart;
+  bestCost = shared.bestCost;
+  if(bestStart < 0) return false;
+  q = shared.best;
+  return true;
+}
@@ -0,0 +1,65 @@
+#ifndef ROBOTICS_MULTI_START_IK_H
+#define ROBOTICS_MULTI_START_IK_H
+
+#include "RobotKinematics3D.h"
+#include "IK.h"
+#include <vector>
+
+/** @ingroup Kinematics
+ * @brief Runs Newton-Raphson IK solves from several seed configurations in
+ * parallel threads, and returns the best solution.
+ *
+ * Start 0 is seeded with robot.q, and start k>0 with SampleSeed(k), which
+ * by default draws a configuration uniformly from the joint limits using a
+ * random number stream seeded from (seed,k).  Each thread works on its own
+ * copy of the robot, so the robot passed in is not modified.
+ *
+ * The solves are run in chunks of itersPerCheck iterations.  Between
+ * chunks, a thread stops if another thread has found a solution whose
+ * Cost() is at most acceptCost.  With the default acceptCost=Inf, the
+ * first solution found ends the search.  With acceptCost=-Inf, all starts
+ * are run and the lowest-cost solution is returned.  Since the threads race
+ * each other, which solution is returned in the first case can depend on
+ * timing.
+ *
+ * Cost() is called from the worker threads, so it must be safe to call
+ * concurrently.
+ */
+class MultiStartIKSolver
+{
+ public:
+  MultiStartIKSolver(const RobotKinematics3D& robot);
+  virtual ~MultiStartIKSolver() {}
+  ///Solves for the goals, with at most maxIters Newton iterations per
+  ///start.  Returns true if any start succeeded, and then q is set to the
+  ///best solution.
+  bool Solve(const std::vector<IKGoal>& goals,Real tolerance,int maxIters,Config& q);
+  ///The cost of a solution, lower is better.  Default returns 0.
+  virtual Real Cost(const Config& q) { return 0; }
+  ///Samples the seed of start k>0.  Random numbers drawn with the Math
+  ///random functions come from the stream of start k.
+  virtual void SampleSeed(int k,Config& q);
+
+  const RobotKinematics3D& robot;
+  ///Number of threads, including the calling thread (default 4)
+  int numThreads;
+  ///Number of seeds (default 16)
+  int numStarts;
+  ///Iterations between checks for cancellation (default 5)
+  int itersPerCheck;
+  ///Seed for the random number streams (default 0)
+  unsigned long seed;
+  ///A solution with cost at most acceptCost ends the search (default Inf)
+  Real acceptCost;
+  ///Threshold passed to RobotIKSolver::UseJointLimits (default TwoPi)
+  Real revJointThreshold;
+  ///The active dofs.  If empty, GetDefaultIKDofs is used
+  std::vector<int> activeDofs;
+
+  //statistics of the last Solve call
+  int numStarted,numSolved;
+  int bestStart;
+  Real bestCost;
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <math/CholeskyDecomposition.h>
 #include <math/MatrixPrinter.h>
 #include <math/VectorPrinter.h>
+#include <math/differentiation.h>
 using namespace std;
 
 
@@ -265,6 +266,237 @@ void NewtonEulerSolver::CalcTorques(const Vector& ddq,Vector& t)
 }
 
 
+//helpers for the torque derivatives: spatial motion vectors (w,v) and
+//force vectors (m,f) in world coordinates about the world origin
+
+//r = a x b
+static inline void CrossMotion(const RigidBodyVelocity& a,const RigidBodyVelocity& b,RigidBodyVelocity& r)
+{
+  r.w.setCross(a.w,b.w);
+  r.v.setCross(a.w,b.v);
+  r.v += cross(a.v,b.w);
+}
+
+//r = a x* f
+static inline void CrossForce(const RigidBodyVelocity& a,const Wrench& f,Wrench& r)
+{
+  r.m.setCross(a.w,f.m);
+  r.m += cross(a.v,f.f);
+  r.f.setCross(a.w,f.f);
+}
+
+//r = I*a for a body with the given mass, world center of mass, and world
+//inertia about the center of mass
+static inline void MulInertia(Real mass,const Vector3& com,const Matrix3& Icom,const RigidBodyVelocity& a,Wrench& r)
+{
+  r.f.setCross(a.w,com);
+  r.f += a.v;
+  r.f *= mass;
+  r.m = Icom*a.w;
+  r.m += cross(com,r.f);
+}
+
+//r = d/dx (I*a) where the body moves with velocity x: x x* (I*a) - I*(x x a)
+static inline void MulInertiaDeriv(Real mass,const Vector3& com,const Matrix3& Icom,const RigidBodyVelocity& x,const RigidBodyVelocity& a,const Wrench& Ia,Wrench& r)
+{
+  RigidBodyVelocity xa;
+  Wrench Ixa;
+  CrossMotion(x,a,xa);
+  MulInertia(mass,com,Icom,xa,Ixa);
+  CrossForce(x,Ia,r);
+  r.m -= Ixa.m;
+  r.f -= Ixa.f;
+}
+
+static inline Real Dot(const RigidBodyVelocity& a,const Wrench& f)
+{
+  return dot(a.w,f.m)+dot(a.v,f.f);
+}
+
+static inline void Madd(RigidBodyVelocity& a,const RigidBodyVelocity& b,Real s)
+{
+  a.w.madd(b.w,s);
+  a.v.madd(b.v,s);
+}
+
+static inline void Add(Wrench& a,const Wrench& b)
+{
+  a.m += b.m;
+  a.f += b.f;
+}
+
+void NewtonEulerSolver::CalcTorqueDerivatives(const Vector& ddq,Matrix& dt_q,Matrix& dt_dq)
+{
+  //Recursive Newton-Euler in world coordinates about the origin, where
+  //  v[k] = v[p] + S[k]*dq[k]
+  //  a[k] = a[p] + S[k]*ddq[k] + v[k] x S[k]*dq[k]
+  //  F[k] = I[k]*a[k] + v[k] x* I[k]*v[k] - fext[k] + sum of children's F
+  //  t[k] = S[k]^T F[k]
+  //Changing q[j] moves the subtree of j with the velocity S[j], and
+  //changing dq[j] only changes the velocities of the subtree of j, so
+  //each column of the derivatives is a forward-mode sweep over the
+  //subtree of j, followed by a walk up the ancestors of j.
+  int n = (int)robot.links.size();
+  Assert(ddq.n == n);
+  vector<RigidBodyVelocity> S(n),v(n),a(n);
+  vector<Wrench> h(n),Ia(n),F(n);
+  vector<Vector3> com(n);
+  vector<Matrix3> Icom(n);
+  RigidBodyVelocity temp;
+  Wrench wtemp;
+  for(int k=0;k<n;k++) {
+    const RobotLink3D& lk = robot.links[k];
+    Vector3 z = lk.T_World.R*lk.w;
+    if(lk.type == RobotLink3D::Revolute) {
+      S[k].w = z;
+      S[k].v.setCross(lk.T_World.t,z);
+    }
+    else {
+      S[k].w.setZero();
+      S[k].v = z;
+    }
+    int p = robot.parents[k];
+    if(p < 0) {
+      v[k].w.setZero(); v[k].v.setZero();
+      a[k].w.setZero(); a[k].v.setZero();
+    }
+    else {
+      v[k] = v[p];
+      a[k] = a[p];
+    }
+    Madd(v[k],S[k],robot.dq(k));
+    Madd(a[k],S[k],ddq(k));
+    CrossMotion(v[k],S[k],temp);
+    Madd(a[k],temp,robot.dq(k));
+    lk.GetWorldCOM(com[k]);
+    lk.GetWorldInertia(Icom[k]);
+    MulInertia(lk.mass,com[k],Icom[k],v[k],h[k]);
+    MulInertia(lk.mass,com[k],Icom[k],a[k],Ia[k]);
+    CrossForce(v[k],h[k],F[k]);
+    Add(F[k],Ia[k]);
+    F[k].m -= externalWrenches[k].m + cross(com[k],externalWrenches[k].f);
+    F[k].f -= externalWrenches[k].f;
+  }
+  for(int k=n-1;k>=0;k--)
+    if(robot.parents[k] >= 0) Add(F[robot.parents[k]],F[k]);
+
+  dt_q.resize(n,n);
+  dt_dq.resize(n,n);
+  dt_q.setZero();
+  dt_dq.setZero();
+  //derivatives with respect to q[j] (dS,dv,da,dF) and dq[j] (dvd,dad,dFd)
+  vector<RigidBodyVelocity> dS(n),dv(n),da(n),dvd(n),dad(n);
+  vector<Wrench> dF(n),dFd(n);
+  vector<bool> inSubtree(n,false);
+  Wrench dh,dIa;
+  for(int j=0;j<n;j++) {
+    const RigidBodyVelocity& X = S[j];
+    for(int k=j;k<n;k++) {
+      int p = robot.parents[k];
+      inSubtree[k] = (k == j || (p >= j && inSubtree[p]));
+      if(!inSubtree[k]) continue;
+      const RobotLink3D& lk = robot.links[k];
+      Real dqk = robot.dq(k);
+      if(k == j) {
+        dS[k].w.setZero(); dS[k].v.setZero();
+        dv[k] = dS[k];
+        da[k] = dS[k];
+        dvd[k] = S[k];
+        CrossMotion(v[k],S[k],dad[k]);
+      }
+      else {
+        CrossMotion(X,S[k],dS[k]);
+        dv[k] = dv[p];
+        Madd(dv[k],dS[k],dqk);
+        da[k] = da[p];
+        Madd(da[k],dS[k],ddq(k));
+        CrossMotion(dv[k],S[k],temp);
+        Madd(da[k],temp,dqk);
+        CrossMotion(v[k],dS[k],temp);
+        Madd(da[k],temp,dqk);
+        dvd[k] = dvd[p];
+        dad[k] = dad[p];
+        CrossMotion(dvd[k],S[k],temp);
+        Madd(dad[k],temp,dqk);
+      }
+
+      //q: dF = d(I*a) + dv x* h + v x* dh - dfext, with dh = d(I*v)
+      MulInertiaDeriv(lk.mass,com[k],Icom[k],X,a[k],Ia[k],dIa);
+      MulInertia(lk.mass,com[k],Icom[k],da[k],wtemp);
+      Add(dIa,wtemp);
+      MulInertiaDeriv(lk.mass,com[k],Icom[k],X,v[k],h[k],dh);
+      MulInertia(lk.mass,com[k],Icom[k],dv[k],wtemp);
+      Add(dh,wtemp);
+      CrossForce(dv[k],h[k],dF[k]);
+      Add(dF[k],dIa);
+      CrossForce(v[k],dh,wtemp);
+      Add(dF[k],wtemp);
+      //the external force is applied at the center of mass, which moves
+      //with velocity X
+      Vector3 dcom = cross(X.w,com[k]) + X.v;
+      dF[k].m -= cross(dcom,externalWrenches[k].f);
+
+      //dq: dF = I*da + dv x* h + v x* I*dv
+      MulInertia(lk.mass,com[k],Icom[k],dad[k],dFd[k]);
+      CrossForce(dvd[k],h[k],wtemp);
+      Add(dFd[k],wtemp);
+      MulInertia(lk.mass,com[k],Icom[k],dvd[k],dh);
+      CrossForce(v[k],dh,wtemp);
+      Add(dFd[k],wtemp);
+    }
+    for(int k=n-1;k>=j;k--) {
+      if(!inSubtree[k]) continue;
+      dt_q(k,j) = Dot(dS[k],F[k]) + Dot(S[k],dF[k]);
+      dt_dq(k,j) = Dot(S[k],dFd[k]);
+      if(k > j) {
+        Add(dF[robot.parents[k]],dF[k]);
+        Add(dFd[robot.parents[k]],dFd[k]);
+      }
+    }
+    //the ancestors of j only feel the change in F[j]
+    for(int p=robot.parents[j];p>=0;p=robot.parents[p]) {
+      dt_q(p,j) = Dot(S[p],dF[j]);
+      dt_dq(p,j) = Dot(S[p],dFd[j]);
+    }
+  }
+}
+
+//the torques of CalcTorques as a function of q or dq
+struct NewtonEulerTorqueFunction : public VectorFieldFunction
+{
+  NewtonEulerTorqueFunction(NewtonEulerSolver& _solver,const Vector& _ddq,bool _velocity)
+    :solver(_solver),ddq(_ddq),velocity(_velocity)
+  {}
+  virtual int NumDimensions() const { return ddq.n; }
+  virtual void PreEval(const Vector& x) {
+    if(velocity) solver.robot.dq = x;
+    else {
+      solver.robot.q = x;
+      solver.robot.UpdateFrames();
+    }
+  }
+  virtual void Eval(const Vector& x,Vector& t) { solver.CalcTorques(ddq,t); }
+
+  NewtonEulerSolver& solver;
+  const Vector& ddq;
+  bool velocity;
+};
+
+void NewtonEulerSolver::CalcTorqueDerivativesFD(const Vector& ddq,Matrix& dt_q,Matrix& dt_dq,Real h)
+{
+  Config q=robot.q,dq=robot.dq;
+  dt_q.resize(q.n,q.n);
+  dt_dq.resize(q.n,q.n);
+  NewtonEulerTorqueFunction fq(*this,ddq,false),fdq(*this,ddq,true);
+  Vector x=q;
+  JacobianCenteredDifference(fq,x,h,dt_q);
+  robot.q = q;
+  robot.UpdateFrames();
+  x = dq;
+  JacobianCenteredDifference(fdq,x,h,dt_dq);
+  robot.dq = dq;
+}
+
 void NewtonEulerSolver::CalcAccel(const Vector& t,Vector& ddq)
 {
   ddq.resize(robot.links.size());
@@ -718,6 +950,24 @@ void NewtonEulerSolver::SelfTest()
     Abort();
   }
   cout<<"NewtonEulerSolver::SelfTest() Passed kinetic energy inverse test."<<endl;
+
+  //check torque derivatives against finite differences
+  SetGravityWrenches(Vector3(0,0,-9.8));
+  for(int i=0;i<ddq.n;i++)
+    ddq(i) = Rand(-One,One);
+  Matrix dt_q,dt_dq,dt_qFD,dt_dqFD;
+  CalcTorqueDerivatives(ddq,dt_q,dt_dq);
+  CalcTorqueDerivativesFD(ddq,dt_qFD,dt_dqFD);
+  Real scale = Max(One,dt_q.maxAbsElement(),dt_dq.maxAbsElement());
+  if(!dt_q.isEqual(dt_qFD,1e-4*scale) || !dt_dq.isEqual(dt_dqFD,1e-4*scale)) {
+    cerr<<"Torque derivatives don't match finite differences!"<<endl;
+    cerr<<"Analytic d/dq:"<<endl<<MatrixPrinter(dt_q)<<endl;
+    cerr<<"Finite differences:"<<endl<<MatrixPrinter(dt_qFD)<<endl;
+    cerr<<"Analytic d/ddq:"<<endl<<MatrixPrinter(dt_dq)<<endl;
+    cerr<<"Finite differences:"<<endl<<MatrixPrinter(dt_dqFD)<<endl;
+    Abort();
+  }
+  cout<<"NewtonEulerSolver::SelfTest() Passed torque derivative test."<<endl;
   cout<<"NewtonEulerSolver::SelfTest() Done!"<<endl;
 }
 
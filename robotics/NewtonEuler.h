@@ -36,6 +36,12 @@ struct NewtonEulerSolver
   void CalcKineticEnergyMatrixInverse(Matrix& Binv);
   void CalcResidualTorques(Vector& CG);
   void CalcResidualAccel(Vector& ddq0);
+  //derivatives of the joint torques of CalcTorques(ddq,t) with respect to
+  //q (dt_q(i,j) = dt(i)/dq(j)) and dq, holding the external wrenches fixed
+  //in the world frame.  The analytic version takes O(n^2) time, the
+  //finite-difference version takes O(n) calls to CalcTorques.
+  void CalcTorqueDerivatives(const Vector& ddq,Matrix& dt_q,Matrix& dt_dq);
+  void CalcTorqueDerivativesFD(const Vector& ddq,Matrix& dt_q,Matrix& dt_dq,Real h=1e-5);
 
   //helpers (also assume current state of robot has been updated)
   void MulKineticEnergyMatrix(const Vector& x,Vector& Bx);
@@ -0,0 +1,503 @@
+#include "RobotCodeGenerator.h"
+#include "NewtonEuler.h"
+#include <math/random.h>
+#include <Timer.h>
+#include <fstream>
+#include <map>
+#include <stdio.h>
+using namespace std;
+
+namespace {
+
+/* A polynomial in the symbols of the generated code.  terms maps a
+ * product of symbols ("" for the constant term) to its coefficient, and
+ * zero terms are dropped, so the constants of the robot fold away while
+ * the code is generated.
+ */
+struct Expr
+{
+  Expr() {}
+  Expr(Real c) { if(c != 0) terms[""] = c; }
+  Expr(const string& symbol) { terms[symbol] = 1; }
+  bool IsConstant() const { return terms.empty() || (terms.size()==1 && terms.begin()->first.empty()); }
+
+  map<string,Real> terms;
+};
+
+void AddTerm(Expr& e,const string& key,Real c)
+{
+  if(c == 0) return;
+  Real& v = e.terms[key];
+  v += c;
+  if(v == 0) e.terms.erase(key);
+}
+
+Expr operator + (const Expr& a,const Expr& b)
+{
+  Expr r = a;
+  for(map<string,Real>::const_iterator i=b.terms.begin();i!=b.terms.end();i++)
+    AddTerm(r,i->first,i->second);
+  return r;
+}
+
+Expr operator - (const Expr& a,const Expr& b)
+{
+  Expr r = a;
+  for(map<string,Real>::const_iterator i=b.terms.begin();i!=b.terms.end();i++)
+    AddTerm(r,i->first,-i->second);
+  return r;
+}
+
+Expr operator * (const Expr& a,const Expr& b)
+{
+  Expr r;
+  for(map<string,Real>::const_iterator i=a.terms.begin();i!=a.terms.end();i++) {
+    for(map<string,Real>::const_iterator j=b.terms.begin();j!=b.terms.end();j++) {
+      string key;
+      if(i->first.empty()) key = j->first;
+      else if(j->first.empty()) key = i->first;
+      else key = i->first + "*" + j->first;
+      AddTerm(r,key,i->second*j->second);
+    }
+  }
+  return r;
+}
+
+string ToString(Real x)
+{
+  char buf[64];
+  snprintf(buf,64,"%.17g",x);
+  return buf;
+}
+
+string ToString(const Expr& e)
+{
+  if(e.terms.empty()) return "0";
+  string s;
+  for(map<string,Real>::const_iterator i=e.terms.begin();i!=e.terms.end();i++) {
+    Real c = i->second;
+    if(i != e.terms.begin()) s += (c < 0 ? " - " : " + ");
+    else if(c < 0) s += "-";
+    if(i->first.empty()) s += ToString(Abs(c));
+    else if(Abs(c) == 1) s += i->first;
+    else s += ToString(Abs(c)) + "*" + i->first;
+  }
+  return s;
+}
+
+struct EVector3
+{
+  EVector3() {}
+  EVector3(const Vector3& v) { x[0]=v.x; x[1]=v.y; x[2]=v.z; }
+  EVector3(const string& name) { for(int k=0;k<3;k++) x[k] = Expr(name+"["+ToString(Real(k))+"]"); }
+  Expr x[3];
+};
+
+struct EMatrix3
+{
+  EMatrix3() {}
+  EMatrix3(const Matrix3& m) { for(int i=0;i<3;i++) for(int j=0;j<3;j++) x[i][j] = m(i,j); }
+  Expr x[3][3];
+};
+
+EVector3 operator + (const EVector3& a,const EVector3& b)
+{
+  EVector3 r;
+  for(int k=0;k<3;k++) r.x[k] = a.x[k]+b.x[k];
+  return r;
+}
+
+EVector3 operator - (const EVector3& a,const EVector3& b)
+{
+  EVector3 r;
+  for(int k=0;k<3;k++) r.x[k] = a.x[k]-b.x[k];
+  return r;
+}
+
+EVector3 operator * (const Expr& c,const EVector3& a)
+{
+  EVector3 r;
+  for(int k=0;k<3;k++) r.x[k] = c*a.x[k];
+  return r;
+}
+
+EVector3 operator * (const EMatrix3& m,const EVector3& a)
+{
+  EVector3 r;
+  for(int i=0;i<3;i++)
+    r.x[i] = m.x[i][0]*a.x[0] + m.x[i][1]*a.x[1] + m.x[i][2]*a.x[2];
+  return r;
+}
+
+EVector3 MulTranspose(const EMatrix3& m,const EVector3& a)
+{
+  EVector3 r;
+  for(int i=0;i<3;i++)
+    r.x[i] = m.x[0][i]*a.x[0] + m.x[1][i]*a.x[1] + m.x[2][i]*a.x[2];
+  return r;
+}
+
+EVector3 Cross(const EVector3& a,const EVector3& b)
+{
+  EVector3 r;
+  r.x[0] = a.x[1]*b.x[2] - a.x[2]*b.x[1];
+  r.x[1] = a.x[2]*b.x[0] - a.x[0]*b.x[2];
+  r.x[2] = a.x[0]*b.x[1] - a.x[1]*b.x[0];
+  return r;
+}
+
+Expr Dot(const EVector3& a,const EVector3& b)
+{
+  return a.x[0]*b.x[0] + a.x[1]*b.x[1] + a.x[2]*b.x[2];
+}
+
+string Name(const char* prefix,int i,int k)
+{
+  return string(prefix)+ToString(Real(i))+"_"+ToString(Real(k));
+}
+
+struct CodeWriter
+{
+  CodeWriter(ostream& _out) : out(_out) {}
+  //emits a local for e and returns its symbol, unless e is a constant or a
+  //single symbol
+  Expr Define(const string& name,const Expr& e) {
+    if(e.IsConstant()) return e;
+    if(e.terms.size()==1 && e.terms.begin()->second==1) return e;
+    out<<"  const double "<<name<<" = "<<ToString(e)<<";\n";
+    return Expr(name);
+  }
+  EVector3 Define(const char* prefix,int i,const EVector3& v) {
+    EVector3 r;
+    for(int k=0;k<3;k++) r.x[k] = Define(Name(prefix,i,k),v.x[k]);
+    return r;
+  }
+  void Assign(const string& lhs,const Expr& e) {
+    out<<"  "<<lhs<<" = "<<ToString(e)<<";\n";
+  }
+  ostream& out;
+};
+
+struct EFrame
+{
+  EMatrix3 R;
+  EVector3 t;
+};
+
+//writes the world frames of the links marked in needed, which must
+//include all of their ancestors
+void WriteFrames(CodeWriter& w,const RobotKinematics3D& robot,const vector<bool>& needed,vector<EFrame>& frames)
+{
+  frames.resize(robot.links.size());
+  for(size_t i=0;i<robot.links.size();i++) {
+    if(!needed[i]) continue;
+    const RobotLink3D& link = robot.links[i];
+    int p = robot.parents[i];
+    string qi = "q["+ToString(Real(i))+"]";
+    //A = T_World(parent)*T0_Parent
+    EFrame A;
+    if(p < 0) {
+      A.R = EMatrix3(link.T0_Parent.R);
+      A.t = EVector3(link.T0_Parent.t);
+    }
+    else {
+      Assert(needed[p]);
+      EMatrix3 T0R(link.T0_Parent.R);
+      for(int r=0;r<3;r++) {
+        for(int c=0;c<3;c++)
+          A.R.x[r][c] = w.Define("a"+ToString(Real(i))+"_"+ToString(Real(r*3+c)),
+                                 frames[p].R.x[r][0]*T0R.x[0][c] + frames[p].R.x[r][1]*T0R.x[1][c] + frames[p].R.x[r][2]*T0R.x[2][c]);
+      }
+      A.t = w.Define("at",(int)i,frames[p].R*EVector3(link.T0_Parent.t) + frames[p].t);
+    }
+    //T_World = A*T(i->i)(qi)
+    EFrame& T = frames[i];
+    if(link.type == RobotLink3D::Prismatic) {
+      T.R = A.R;
+      T.t = w.Define("t",(int)i,A.t + Expr(qi)*(A.R*EVector3(link.w)));
+      continue;
+    }
+    T.t = A.t;
+    Real scale = link.w.norm();
+    if(scale == 0) {
+      T.R = A.R;
+      continue;
+    }
+    string angle = (scale == 1 ? qi : ToString(scale)+"*"+qi);
+    string ci = "c"+ToString(Real(i)), si = "s"+ToString(Real(i));
+    w.out<<"  const double "<<ci<<" = cos("<<angle<<");\n";
+    w.out<<"  const double "<<si<<" = sin("<<angle<<");\n";
+    Expr c(ci),s(si);
+    EMatrix3 R;
+    int axis = -1;
+    if(link.w.x == One) axis = 0;
+    else if(link.w.y == One) axis = 1;
+    else if(link.w.z == One) axis = 2;
+    if(axis >= 0) {
+      //columns j,l rotate: L(j,j)=L(l,l)=c, L(l,j)=s, L(j,l)=-s
+      int j = (axis+1)%3, l = (axis+2)%3;
+      for(int r=0;r<3;r++) {
+        R.x[r][axis] = A.R.x[r][axis];
+        R.x[r][j] = A.R.x[r][j]*c + A.R.x[r][l]*s;
+        R.x[r][l] = A.R.x[r][l]*c - A.R.x[r][j]*s;
+      }
+    }
+    else {
+      //Rodrigues' formula L = ww^T + c(I-ww^T) + s[w]
+      Vector3 u = link.w/scale;
+      Matrix3 ww,K;
+      ww.setOuterProduct(u,u);
+      K.setCrossProduct(u);
+      Expr L[3][3];
+      for(int m=0;m<3;m++)
+        for(int n=0;n<3;n++)
+          L[m][n] = Expr(ww(m,n)) + Expr((m==n?One:Zero)-ww(m,n))*c + Expr(K(m,n))*s;
+      for(int r=0;r<3;r++)
+        for(int n=0;n<3;n++)
+          R.x[r][n] = A.R.x[r][0]*L[0][n] + A.R.x[r][1]*L[1][n] + A.R.x[r][2]*L[2][n];
+    }
+    for(int r=0;r<3;r++)
+      for(int n=0;n<3;n++)
+        T.R.x[r][n] = w.Define("r"+ToString(Real(i))+"_"+ToString(Real(r*3+n)),R.x[r][n]);
+  }
+}
+
+} //namespace
+
+RobotCodeGenerator::RobotCodeGenerator(const RobotKinematics3D& _robot)
+  :robot(_robot)
+{}
+
+void RobotCodeGenerator::WriteForwardKinematics(ostream& out,const char* name) const
+{
+  int n = (int)robot.links.size();
+  out<<"void "<<name<<"(const double* q,double* T)\n{\n";
+  CodeWriter w(out);
+  vector<EFrame> frames;
+  WriteFrames(w,robot,vector<bool>(n,true),frames);
+  for(int i=0;i<n;i++) {
+    for(int r=0;r<3;r++)
+      for(int c=0;c<3;c++)
+        w.Assign("T["+ToString(Real(12*i+r*3+c))+"]",frames[i].R.x[r][c]);
+    for(int r=0;r<3;r++)
+      w.Assign("T["+ToString(Real(12*i+9+r))+"]",frames[i].t.x[r]);
+  }
+  out<<"}\n\n";
+}
+
+void RobotCodeGenerator::WriteJacobian(ostream& out,const char* name,int link) const
+{
+  int n = (int)robot.links.size();
+  vector<bool> chain(n,false);
+  for(int j=link;j>=0;j=robot.parents[j]) chain[j] = true;
+  out<<"void "<<name<<"(const double* q,const double* p,double* J)\n{\n";
+  CodeWriter w(out);
+  vector<EFrame> frames;
+  WriteFrames(w,robot,chain,frames);
+  EVector3 pw = w.Define("pw",link,frames[link].R*EVector3(string("p"))+frames[link].t);
+  for(int j=0;j<n;j++) {
+    EVector3 dw,dv;
+    if(chain[j]) {
+      EVector3 axis = w.Define("z",j,frames[j].R*EVector3(robot.links[j].w));
+      if(robot.links[j].type == RobotLink3D::Revolute) {
+        dw = axis;
+        dv = Cross(axis,pw-frames[j].t);
+      }
+      else
+        dv = axis;
+    }
+    for(int k=0;k<3;k++) {
+      w.Assign("J["+ToString(Real(k*n+j))+"]",dw.x[k]);
+      w.Assign("J["+ToString(Real((k+3)*n+j))+"]",dv.x[k]);
+    }
+  }
+  out<<"}\n\n";
+}
+
+void RobotCodeGenerator::WriteNewtonEuler(ostream& out,const char* name) const
+{
+  int n = (int)robot.links.size();
+  out<<"void "<<name<<"(const double* q,const double* dq,const double* ddq,const double* gravity,double* t)\n{\n";
+  CodeWriter w(out);
+  vector<EFrame> frames;
+  WriteFrames(w,robot,vector<bool>(n,true),frames);
+  vector<vector<int> > children;
+  robot.GetChildList(children);
+  EVector3 g(string("gravity"));
+
+  //velocities and accelerations of the link origins, as in
+  //NewtonEulerSolver::CalcLinkAccel
+  vector<EVector3> axes(n),v(n),omega(n),a(n),alpha(n);
+  for(int i=0;i<n;i++) {
+    const RobotLink3D& link = robot.links[i];
+    int p = robot.parents[i];
+    string si = ToString(Real(i));
+    axes[i] = w.Define("z",i,frames[i].R*EVector3(link.w));
+    EVector3 odiff;
+    if(p >= 0) {
+      odiff = w.Define("od",i,frames[i].t-frames[p].t);
+      v[i] = v[p] + Cross(omega[p],odiff);
+      omega[i] = omega[p];
+    }
+    Expr dqi("dq["+si+"]"),ddqi("ddq["+si+"]");
+    if(link.type == RobotLink3D::Revolute) omega[i] = omega[i] + dqi*axes[i];
+    else v[i] = v[i] + dqi*axes[i];
+    v[i] = w.Define("v",i,v[i]);
+    omega[i] = w.Define("w",i,omega[i]);
+    if(p >= 0) {
+      a[i] = a[p] + Cross(alpha[p],odiff) + Expr(Two)*Cross(omega[p],v[i]-v[p]) - Cross(omega[p],Cross(omega[p],odiff));
+      alpha[i] = alpha[p] - Cross(omega[i],omega[p]);
+    }
+    if(link.type == RobotLink3D::Revolute) alpha[i] = alpha[i] + ddqi*axes[i];
+    else a[i] = a[i] + ddqi*axes[i];
+    a[i] = w.Define("av",i,a[i]);
+    alpha[i] = w.Define("aw",i,alpha[i]);
+  }
+  //joint wrenches, as in NewtonEulerSolver::CalcTorques
+  vector<EVector3> f(n),m(n);
+  for(int i=n-1;i>=0;i--) {
+    const RobotLink3D& link = robot.links[i];
+    EVector3 cm = w.Define("cm",i,frames[i].R*EVector3(link.com));
+    EVector3 acm = a[i] + Cross(alpha[i],cm) + Cross(omega[i],Cross(omega[i],cm));
+    EVector3 fcm = Expr(link.mass)*(acm - g);
+    //world inertia times x is R*(I*(R^T*x))
+    EMatrix3 I(link.inertia);
+    EVector3 Ialpha = w.Define("ia",i,frames[i].R*(I*w.Define("ra",i,MulTranspose(frames[i].R,alpha[i]))));
+    EVector3 Iomega = w.Define("iw",i,frames[i].R*(I*w.Define("rw",i,MulTranspose(frames[i].R,omega[i]))));
+    EVector3 mcm = Ialpha + Cross(omega[i],Iomega);
+    for(size_t k=0;k<children[i].size();k++) {
+      int c = children[i][k];
+      fcm = fcm + f[c];
+      mcm = mcm + m[c] + Cross(frames[c].t-frames[i].t-cm,f[c]);
+    }
+    f[i] = w.Define("f",i,fcm);
+    m[i] = w.Define("m",i,mcm + Cross(cm,f[i]));
+    if(link.type == RobotLink3D::Revolute)
+      w.Assign("t["+ToString(Real(i))+"]",Dot(m[i],axes[i]));
+    else
+      w.Assign("t["+ToString(Real(i))+"]",Dot(f[i],axes[i]));
+  }
+  out<<"}\n\n";
+}
+
+bool RobotCodeGenerator::WriteSource(const char* fn,const char* prefix) const
+{
+  ofstream out(fn,ios::out);
+  if(!out) return false;
+  int n = (int)robot.links.size();
+  string p(prefix);
+  out<<"//Generated by RobotCodeGenerator for a robot with "<<n<<" links.  Do not edit.\n";
+  out<<"#include <math.h>\n\n";
+  WriteForwardKinematics(out,(p+"_fk").c_str());
+  for(int i=0;i<n;i++)
+    WriteJacobian(out,(p+"_jacobian_"+ToString(Real(i))).c_str(),i);
+  out<<"void (*"<<p<<"_jacobians["<<n<<"])(const double*,const double*,double*) = {";
+  for(int i=0;i<n;i++)
+    out<<(i==0?"":",")<<"\n  "<<p<<"_jacobian_"<<i;
+  out<<"\n};\n\n";
+  WriteNewtonEuler(out,(p+"_torques").c_str());
+  out.close();
+  return (bool)out;
+}
+
+Real BenchmarkGeneratedCode(RobotDynamics3D& robot,GeneratedFKFunction fk,
+                            GeneratedJacobianFunction jacobian,int jacobianLink,
+                            GeneratedTorqueFunction torques,const Vector3& gravity,
+                            int numSamples)
+{
+  int n = (int)robot.links.size();
+  vector<Config> qs(numSamples),dqs(numSamples),ddqs(numSamples);
+  for(int k=0;k<numSamples;k++) {
+    qs[k].resize(n);
+    dqs[k].resize(n);
+    ddqs[k].resize(n);
+    for(int i=0;i<n;i++) {
+      Real lo = (IsFinite(robot.qMin(i)) ? robot.qMin(i) : -Pi);
+      Real hi = (IsFinite(robot.qMax(i)) ? robot.qMax(i) : Pi);
+      qs[k](i) = Rand(lo,hi);
+      dqs[k](i) = Rand(-1,1);
+      ddqs[k](i) = Rand(-1,1);
+    }
+  }
+  Real maxError = 0;
+  Timer timer;
+  Real genericTime,generatedTime;
+  if(fk) {
+    vector<double> T(12*n);
+    Real error = 0;
+    for(int k=0;k<numSamples;k++) {
+      robot.UpdateConfig(qs[k]);
+      fk(qs[k].getStart(),&T[0]);
+      for(int i=0;i<n;i++) {
+        const RigidTransform& Ti = robot.links[i].T_World;
+        for(int r=0;r<3;r++) {
+          for(int c=0;c<3;c++)
+            error = Max(error,Abs(T[12*i+r*3+c]-Ti.R(r,c)));
+          error = Max(error,Abs(T[12*i+9+r]-Ti.t[r]));
+        }
+      }
+    }
+    timer.Reset();
+    for(int k=0;k<numSamples;k++) robot.UpdateConfig(qs[k]);
+    genericTime = timer.ElapsedTime();
+    timer.Reset();
+    for(int k=0;k<numSamples;k++) fk(qs[k].getStart(),&T[0]);
+    generatedTime = timer.ElapsedTime();
+    printf("Forward kinematics: generic %gs, generated %gs, max difference %g\n",genericTime,generatedTime,error);
+    maxError = Max(maxError,error);
+  }
+  if(jacobian) {
+    Vector3 pt(0.1,-0.2,0.3);
+    vector<double> J(6*n);
+    Matrix Jg;
+    Real error = 0;
+    for(int k=0;k<numSamples;k++) {
+      robot.UpdateConfig(qs[k]);
+      robot.GetFullJacobian(pt,jacobianLink,Jg);
+      jacobian(qs[k].getStart(),&pt.x,&J[0]);
+      for(int r=0;r<6;r++)
+        for(int j=0;j<n;j++)
+          error = Max(error,Abs(J[r*n+j]-Jg(r,j)));
+    }
+    timer.Reset();
+    for(int k=0;k<numSamples;k++) {
+      robot.UpdateConfig(qs[k]);
+      robot.GetFullJacobian(pt,jacobianLink,Jg);
+    }
+    genericTime = timer.ElapsedTime();
+    timer.Reset();
+    for(int k=0;k<numSamples;k++) jacobian(qs[k].getStart(),&pt.x,&J[0]);
+    generatedTime = timer.ElapsedTime();
+    printf("Jacobian of link %d: generic %gs, generated %gs, max difference %g\n",jacobianLink,genericTime,generatedTime,error);
+    maxError = Max(maxError,error);
+  }
+  if(torques) {
+    NewtonEulerSolver ne(robot);
+    ne.SetGravityWrenches(gravity);
+    Vector tg;
+    vector<double> t(n);
+    Real error = 0;
+    for(int k=0;k<numSamples;k++) {
+      robot.UpdateConfig(qs[k]);
+      robot.dq = dqs[k];
+      ne.CalcTorques(ddqs[k],tg);
+      torques(qs[k].getStart(),dqs[k].getStart(),ddqs[k].getStart(),&gravity.x,&t[0]);
+      for(int i=0;i<n;i++)
+        error = Max(error,Abs(t[i]-tg(i)));
+    }
+    timer.Reset();
+    for(int k=0;k<numSamples;k++) {
+      robot.UpdateConfig(qs[k]);
+      robot.dq = dqs[k];
+      ne.CalcTorques(ddqs[k],tg);
+    }
+    genericTime = timer.ElapsedTime();
+    timer.Reset();
+    for(int k=0;k<numSamples;k++)
+      torques(qs[k].getStart(),dqs[k].getStart(),ddqs[k].getStart(),&gravity.x,&t[0]);
+    generatedTime = timer.ElapsedTime();
+    printf("Newton-Euler torques: generic %gs, generated %gs, max difference %g\n",genericTime,generatedTime,error);
+    maxError = Max(maxError,error);
+  }
+  return maxError;
+}
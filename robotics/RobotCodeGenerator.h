@@ -0,0 +1,64 @@
+#ifndef ROBOTICS_CODE_GENERATOR_H
+#define ROBOTICS_CODE_GENERATOR_H
+
+#include "RobotDynamics3D.h"
+#include <iosfwd>
+
+/** @ingroup Kinematics
+ * @brief Generates straight-line C++ code for the forward kinematics,
+ * Jacobians, and Newton-Euler inverse dynamics of a fixed robot.
+ *
+ * The structure and parameters of the robot are folded into the generated
+ * code: there are no loops over links, no branches on joint types, and
+ * multiplications by the zeros and ones of the link frames and axes are
+ * left out.  The generated functions only depend on <math.h> and take
+ * plain double arrays:
+ *
+ * - void name(const double* q,double* T): the world transform of each link
+ *   i, as in links[i].T_World after UpdateConfig(q), in T[12*i...12*i+11]
+ *   (the rotation matrix in row-major order, then the translation, as in
+ *   BatchKinematics3D).
+ * - void name(const double* q,const double* p,double* J): the 6 x n
+ *   Jacobian of the point p, local to a given link, in row-major order, as
+ *   in GetFullJacobian.
+ * - void name(const double* q,const double* dq,const double* ddq,
+ *   const double* gravity,double* t): the joint torques of
+ *   NewtonEulerSolver::CalcTorques(ddq,t) under SetGravityWrenches(gravity)
+ *   at the state (q,dq).
+ *
+ * WriteSource() writes all of these into a file that can be compiled into
+ * a program, and BenchmarkGeneratedCode() checks and times the compiled
+ * functions against the generic versions.  The code must be regenerated
+ * if the robot changes.
+ */
+class RobotCodeGenerator
+{
+ public:
+  RobotCodeGenerator(const RobotKinematics3D& robot);
+  void WriteForwardKinematics(std::ostream& out,const char* name) const;
+  void WriteJacobian(std::ostream& out,const char* name,int link) const;
+  void WriteNewtonEuler(std::ostream& out,const char* name) const;
+  ///Writes prefix_fk, prefix_jacobian_i for each link i (and the table
+  ///prefix_jacobians), and prefix_torques to the file fn
+  bool WriteSource(const char* fn,const char* prefix) const;
+
+  const RobotKinematics3D& robot;
+};
+
+typedef void (*GeneratedFKFunction)(const double* q,double* T);
+typedef void (*GeneratedJacobianFunction)(const double* q,const double* p,double* J);
+typedef void (*GeneratedTorqueFunction)(const double* q,const double* dq,const double* ddq,const double* gravity,double* t);
+
+/** @ingroup Kinematics
+ * @brief Compares and times generated code (see RobotCodeGenerator)
+ * against RobotKinematics3D::UpdateConfig, GetFullJacobian, and
+ * NewtonEulerSolver::CalcTorques over numSamples random states, and prints
+ * the results.  Any of the functions may be NULL.  Modifies the state of
+ * robot.  Returns the largest difference found.
+ */
+Real BenchmarkGeneratedCode(RobotDynamics3D& robot,GeneratedFKFunction fk,
+                            GeneratedJacobianFunction jacobian,int jacobianLink,
+                            GeneratedTorqueFunction torques,const Vector3& gravity,
+                            int numSamples=10000);
+
+#endif
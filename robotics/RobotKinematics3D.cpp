@@ -13,6 +13,7 @@ void RobotKinematics3D::Initialize(int numLinks)
   q.resize(numLinks,Zero);
   qMin.resize(numLinks,-Inf);
   qMax.resize(numLinks,Inf);
+  qFrames.clear();
 }
 
 void RobotKinematics3D::InitializeRigidObject()
@@ -22,6 +23,7 @@ void RobotKinematics3D::InitializeRigidObject()
   q.resize(6,Zero);
   qMin.resize(6,-Inf);
   qMax.resize(6,Inf);
+  qFrames.clear();
   links[0].SetTranslationJoint(Vector3(1,0,0));
   links[1].SetTranslationJoint(Vector3(0,1,0));
   links[2].SetTranslationJoint(Vector3(0,0,1));
@@ -175,6 +177,14 @@ void RobotKinematics3D::UpdateFrames()
       li.T_World*=Ti;
     }
   }
+  //everything may have changed
+  updateCounter++;
+  frameStamps.resize(links.size());
+  jointStamps.resize(links.size());
+  fill(frameStamps.begin(),frameStamps.end(),updateCounter);
+  fill(jointStamps.begin(),jointStamps.end(),updateCounter);
+  if(qFrames.n != q.n) qFrames.resize(q.n);
+  qFrames.copy(q);
 }
 
 void RobotKinematics3D::UpdateSelectedFrames(int link,int base)
@@ -188,6 +198,8 @@ void RobotKinematics3D::UpdateSelectedFrames(int link,int base)
   if(base != -1)
     updlinks.push_back(base);
   reverse(updlinks.begin(),updlinks.end());
+  bool tracked = (qFrames.n == q.n && frameStamps.size() == links.size());
+  if(tracked) updateCounter++;
   for(size_t k=0;k<updlinks.size();k++) {
     int i = updlinks[k];
     RobotLink3D& li = links[i];
@@ -199,7 +211,61 @@ void RobotKinematics3D::UpdateSelectedFrames(int link,int base)
       li.T_World.mul(links[pi].T_World,li.T0_Parent);
       li.T_World*=Ti;
     }
+    if(tracked) {
+      frameStamps[i] = jointStamps[i] = updateCounter;
+      qFrames(i) = q(i);
+    }
+  }
+}
+
+int RobotKinematics3D::UpdateConfigIncremental(const Config& q_new)
+{
+  Assert(q_new.n == q.n);
+  q.copy(q_new);
+  if(qFrames.n != q.n || frameStamps.size() != links.size()) {
+    UpdateFrames();
+    return (int)links.size();
+  }
+  //a frame is recomputed if its joint changed or its parent's frame is
+  //newer than it, so the changes propagate down the subtrees
+  updateCounter++;
+  Frame3D Ti;
+  int num=0;
+  for(size_t i=0;i<links.size();i++) {
+    int pi=parents[i];
+    if(q(i) != qFrames(i)) jointStamps[i] = updateCounter;
+    else if(pi==-1 || frameStamps[pi] <= frameStamps[i]) continue;
+    RobotLink3D& li = links[i];
+    li.GetLocalTransform(q(i),Ti);
+    if(pi==-1)
+      li.T_World.mul(li.T0_Parent,Ti);
+    else {
+      li.T_World.mul(links[pi].T_World,li.T0_Parent);
+      li.T_World*=Ti;
+    }
+    frameStamps[i] = updateCounter;
+    num++;
+  }
+  qFrames.copy(q);
+  return num;
+}
+
+int RobotKinematics3D::RelativeChangeStamp(int i,int j) const
+{
+  //parents have lower indices, so walk up from the larger index until the
+  //paths meet
+  int stamp = 0;
+  while(i != j) {
+    if(i > j) {
+      stamp = Max(stamp,jointStamps[i]);
+      i = parents[i];
+    }
+    else {
+      stamp = Max(stamp,jointStamps[j]);
+      j = parents[j];
+    }
   }
+  return stamp;
 }
 
 bool RobotKinematics3D::InJointLimits(const Config& q) const
@@ -25,6 +25,15 @@ typedef Vector Config;
  * frames are updated when UpdateFrames() is called, and are stored
  * in links[i].T_World.
  *
+ * UpdateConfigIncremental() only recomputes the frames of the links whose
+ * joint values changed since the frames were last computed, and their
+ * descendants.  It tracks changes with stamps: each update increments
+ * updateCounter, and frameStamps[i] is the counter when links[i].T_World
+ * was last recomputed, and jointStamps[i] the counter when q(i) was last
+ * found to change.  The tracking assumes the frames are only changed by
+ * the Update* functions; call UpdateFrames() after modifying the model or
+ * the frames directly.
+ *
  * Note that the kinematic model is often used for temporary storage
  * (i.e. in planners, simulators, etc.) so you should count on the state
  * being changed.  If you need to store state, copy out the current
@@ -33,7 +42,7 @@ typedef Vector Config;
 class RobotKinematics3D : public Chain
 {
 public:
-  RobotKinematics3D() {}
+  RobotKinematics3D() : updateCounter(0) {}
   virtual ~RobotKinematics3D() {}
   virtual std::string LinkName(int i) const;  
 
@@ -52,6 +61,12 @@ public:
   void UpdateSelectedFrames(int link,int root=-1);
   /// sets the current config q and updates frames
   void UpdateConfig(const Config& q);
+  /// sets the current config q and updates only the frames that it changes.
+  /// Returns the number of frames recomputed.
+  int UpdateConfigIncremental(const Config& q);
+  /// returns the last update in which the transform between links i and j
+  /// may have changed, i.e., the largest jointStamp on the path between them
+  int RelativeChangeStamp(int i,int j) const;
 
   /// returns true if q is within joint limits
   bool InJointLimits(const Config& q) const;
@@ -123,6 +138,12 @@ public:
   std::vector<RobotLink3D> links;
   Config q;           ///< current configuration
   Vector qMin,qMax;   ///< joint limits
+
+  ///Change tracking, see above.  qFrames is the configuration of the
+  ///current frames, and is empty if unknown.
+  Config qFrames;
+  std::vector<int> frameStamps,jointStamps;
+  int updateCounter;
 };
 
 
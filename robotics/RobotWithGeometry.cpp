@@ -12,14 +12,17 @@ using namespace GLDraw;
 using namespace std;
 
 RobotWithGeometry::RobotWithGeometry()
+  :cacheSelfCollisions(false)
 {}
 
 RobotWithGeometry::RobotWithGeometry(const RobotDynamics3D& rhs)
+  :cacheSelfCollisions(false)
 {
   operator = (rhs);
 }
 
 RobotWithGeometry::RobotWithGeometry(const RobotWithGeometry& rhs)
+  :cacheSelfCollisions(false)
 {
   operator = (rhs);
 }
@@ -40,6 +43,8 @@ void RobotWithGeometry::Initialize(int n)
   geometry.resize(n);
   selfCollisions.resize(n,n,NULL);
   envCollisions.resize(n,NULL);
+  boundingAABBs.clear();
+  geometryStamps.clear();
 }
 
 void RobotWithGeometry::Merge(const std::vector<RobotWithGeometry*>& robots)
@@ -54,6 +59,8 @@ void RobotWithGeometry::Merge(const std::vector<RobotWithGeometry*>& robots)
   geometry.resize(n);
   selfCollisions.resize(n,n,NULL);
   envCollisions.resize(n,NULL);
+  boundingAABBs.clear();
+  geometryStamps.clear();
   
   size_t nl = 0;
   vector<size_t> offset(robots.size());
@@ -86,7 +93,10 @@ const RobotWithGeometry& RobotWithGeometry::operator = (const RobotWithGeometry&
   geometry.resize(n);
   selfCollisions.resize(n,n,NULL);
   envCollisions.resize(n,NULL);
+  boundingAABBs.clear();
+  geometryStamps.clear();
   geometry = rhs.geometry;
+  cacheSelfCollisions = rhs.cacheSelfCollisions;
   for(int j=0;j<n;j++) {
     if(rhs.envCollisions[j])
       envCollisions[j] = new CollisionQuery(*geometry[j],*rhs.envCollisions[j]->b);
@@ -108,6 +118,8 @@ const RobotWithGeometry& RobotWithGeometry::operator = (const RobotDynamics3D& r
   geometry.resize(n);
   selfCollisions.resize(n,n,NULL);
   envCollisions.resize(n,NULL);
+  boundingAABBs.clear();
+  geometryStamps.clear();
   return *this;
 }
 
@@ -115,6 +127,8 @@ const RobotWithGeometry& RobotWithGeometry::operator = (const RobotDynamics3D& r
 bool RobotWithGeometry::LoadGeometry(int i,const char* file)
 {
   geometry[i] = new CollisionGeometry;
+  geometryStamps.clear();
+  ClearSelfCollisionCache();
   if(!geometry[i]->Load(file)) return false;
   return true;
 }
@@ -165,6 +179,8 @@ void RobotWithGeometry::InitSelfCollisionPair(int i,int j)
   Assert(j < (int)geometry.size());
   if(!IsGeometryEmpty(i) && !IsGeometryEmpty(j)) 
     selfCollisions(i,j) = new CollisionQuery(*geometry[i],*geometry[j]);
+  if(i < selfCollisionCache.m && j < selfCollisionCache.n)
+    selfCollisionCache(i,j).stamp = -1;
 }
 
 
@@ -194,6 +210,12 @@ void RobotWithGeometry::CleanupSelfCollisions()
   for(int i=0;i<selfCollisions.m;i++) 
     for(int j=0;j<selfCollisions.n;j++)
       SafeDelete(selfCollisions(i,j));
+  ClearSelfCollisionCache();
+}
+
+void RobotWithGeometry::ClearSelfCollisionCache()
+{
+  selfCollisionCache.clear();
 }
 
 void RobotWithGeometry::UpdateGeometry()
@@ -205,6 +227,48 @@ void RobotWithGeometry::UpdateGeometry()
 void RobotWithGeometry::UpdateGeometry(int i)
 {
   if(geometry[i]) geometry[i]->SetTransform(links[i].T_World);
+  UpdateBoundingVolumes(i);
+  if(frameStamps.size() == links.size()) {
+    if(geometryStamps.size() != links.size()) geometryStamps.resize(links.size(),-1);
+    geometryStamps[i] = frameStamps[i];
+  }
+}
+
+int RobotWithGeometry::UpdateGeometryIncremental()
+{
+  if(frameStamps.size() != links.size() || geometryStamps.size() != links.size()) {
+    UpdateGeometry();
+    return (int)links.size();
+  }
+  int num=0;
+  for(size_t i=0;i<links.size();i++) {
+    if(geometryStamps[i] == frameStamps[i]) continue;
+    UpdateGeometry(i);
+    num++;
+  }
+  return num;
+}
+
+void RobotWithGeometry::UpdateBoundingVolumes(int i)
+{
+  if(boundingAABBs.size() != links.size()) {
+    //first update since the geometry was set up, get all the links
+    boundingSpheres.resize(links.size());
+    boundingBoxes.resize(links.size());
+    boundingAABBs.resize(links.size());
+    for(size_t k=0;k<links.size();k++)
+      if((int)k != i) UpdateBoundingVolumes(k);
+  }
+  if(IsGeometryEmpty(i)) {
+    boundingAABBs[i].minimize();
+    boundingSpheres[i].center.setZero();
+    boundingSpheres[i].radius = 0;
+    return;
+  }
+  boundingBoxes[i] = geometry[i]->GetBB();
+  boundingBoxes[i].getAABB(boundingAABBs[i]);
+  boundingSpheres[i].center = boundingBoxes[i].center();
+  boundingSpheres[i].radius = 0.5*boundingBoxes[i].dims.norm();
 }
 
 void RobotWithGeometry::InitMeshCollision(CollisionGeometry& mesh)
@@ -236,12 +300,39 @@ bool UnderCollisionMargin(Geometry::AnyCollisionQuery* q,Real adj)
   }
 }
 
+bool RobotWithGeometry::QuerySelfCollision(int i,int j,Real d)
+{
+  CollisionQuery* query=selfCollisions(i,j);
+  if(!cacheSelfCollisions || jointStamps.size() != links.size() || geometryStamps.size() != links.size())
+    return UnderCollisionMargin(query,d);
+  if(selfCollisionCache.m != selfCollisions.m || selfCollisionCache.n != selfCollisions.n) {
+    SelfCollisionCacheEntry blank;
+    blank.stamp = -1;
+    blank.distance = 0;
+    blank.result = false;
+    selfCollisionCache.resize(selfCollisions.m,selfCollisions.n,blank);
+  }
+  //the result still holds if no joint between the links moved since
+  SelfCollisionCacheEntry& entry = selfCollisionCache(i,j);
+  if(entry.stamp >= 0 && entry.distance == d && entry.stamp >= RelativeChangeStamp(i,j))
+    return entry.result;
+  bool res = UnderCollisionMargin(query,d);
+  //only cache results computed from up-to-date geometry
+  if(geometryStamps[i] == frameStamps[i] && geometryStamps[j] == frameStamps[j]) {
+    entry.stamp = updateCounter;
+    entry.distance = d;
+    entry.result = res;
+  }
+  else entry.stamp = -1;
+  return res;
+}
+
 bool RobotWithGeometry::SelfCollision(int i, int j, Real d)
 {
   if(i > j) std::swap(i,j);
   CollisionQuery* query=selfCollisions(i,j);
   if(query == NULL) return false;
-  return UnderCollisionMargin(query,d);
+  return QuerySelfCollision(i,j,d);
 }
 
 bool RobotWithGeometry::SelfCollision(const vector<int>& bodies,Real distance)
@@ -343,70 +434,95 @@ bool RobotWithGeometry::SelfCollision(const vector<int>& set1,const vector<int>&
   return false;
 }
 
-bool RobotWithGeometry::SelfCollision(Real distance)
+//expands b by d on all sides
+static void ExpandBox(Box3D& b,Real d)
 {
-  //get world space bounding boxes for quick reject test
-  vector<int> validbodies;
-  validbodies.reserve(links.size());
-  for(size_t i=0;i<links.size();i++) 
-    if(!IsGeometryEmpty(i)) validbodies.push_back(i);
-  vector<AABB3D> bbs(validbodies.size());
-  for(size_t i=0;i<validbodies.size();i++) {
-    bbs[i] = geometry[validbodies[i]]->GetAABB();
+  b.dims += Vector3(d*2.0);
+  b.origin -= d * (b.xbasis+b.ybasis+b.zbasis);
+}
+
+void RobotWithGeometry::SelfCollisionBroadPhase(vector<pair<int,int> >& pairs,Real distance)
+{
+  pairs.resize(0);
+  int n = (int)links.size();
+  if(boundingAABBs.size() != links.size()) {
+    for(int i=0;i<n;i++) UpdateBoundingVolumes(i);
   }
-  if(distance != 0) {
-    //adjust bounding  boxes
-    Vector3 d(distance*0.5);
-    for(size_t i=0;i<bbs.size();i++) {
-      bbs[i].bmin -= d;
-      bbs[i].bmax += d;
+  //a negative distance allows some penetration, but the bounding volumes
+  //are not tight enough to cull with that
+  Real d = Max(distance,0.0);
+  //insertion sort by the lower x coordinate, which is fast if the order
+  //hasn't changed much since the last call
+  if(sweepOrder.size() != links.size()) {
+    sweepOrder.resize(n);
+    for(int i=0;i<n;i++) sweepOrder[i] = i;
+  }
+  for(int i=1;i<n;i++) {
+    int k = sweepOrder[i];
+    Real x = boundingAABBs[k].bmin.x;
+    int j = i-1;
+    while(j >= 0 && boundingAABBs[sweepOrder[j]].bmin.x > x) {
+      sweepOrder[j+1] = sweepOrder[j];
+      j--;
     }
+    sweepOrder[j+1] = k;
   }
-  //if |validbodies| > 300, you may want to use the functions in geometry/RangeQuery.h
-  //now check collisions, ensuring BBs overlap
-  for(size_t i=0;i<validbodies.size();i++) {
-    for(size_t j=i+1;j<validbodies.size();j++) {
-      CollisionQuery* query=selfCollisions(validbodies[i],validbodies[j]);
+  //sweep along x; empty links have empty AABBs and never overlap
+  vector<pair<Real,pair<int,int> > > candidates;
+  Box3D bi,bj;
+  for(int a=0;a<n;a++) {
+    int i = sweepOrder[a];
+    const AABB3D& bbi = boundingAABBs[i];
+    Real xmax = bbi.bmax.x + d;
+    for(int b=a+1;b<n;b++) {
+      int j = sweepOrder[b];
+      const AABB3D& bbj = boundingAABBs[j];
+      if(bbj.bmin.x > xmax) break;
+      CollisionQuery* query = (i < j ? selfCollisions(i,j) : selfCollisions(j,i));
       if(query == NULL) continue;
-      if(!bbs[i].intersects(bbs[j])) continue;
-      if(UnderCollisionMargin(query,distance)) return true;
+      if(bbj.bmin.y > bbi.bmax.y + d || bbi.bmin.y > bbj.bmax.y + d) continue;
+      if(bbj.bmin.z > bbi.bmax.z + d || bbi.bmin.z > bbj.bmax.z + d) continue;
+      Real gap = boundingSpheres[i].center.distance(boundingSpheres[j].center) - boundingSpheres[i].radius - boundingSpheres[j].radius;
+      if(gap > d) continue;
+      if(d == 0) {
+        if(!boundingBoxes[i].intersects(boundingBoxes[j])) continue;
+      }
+      else {
+        bi = boundingBoxes[i];
+        bj = boundingBoxes[j];
+        ExpandBox(bi,d*0.5);
+        ExpandBox(bj,d*0.5);
+        if(!bi.intersects(bj)) continue;
+      }
+      candidates.push_back(pair<Real,pair<int,int> >(gap,pair<int,int>(Min(i,j),Max(i,j))));
     }
   }
+  //the most deeply overlapping pairs are the most likely to collide
+  sort(candidates.begin(),candidates.end());
+  pairs.resize(candidates.size());
+  for(size_t i=0;i<candidates.size();i++)
+    pairs[i] = candidates[i].second;
+}
+
+bool RobotWithGeometry::SelfCollision(Real distance)
+{
+  vector<pair<int,int> > pairs;
+  SelfCollisionBroadPhase(pairs,distance);
+  for(size_t i=0;i<pairs.size();i++)
+    if(QuerySelfCollision(pairs[i].first,pairs[i].second,distance)) return true;
   return false;
 }
 
 void RobotWithGeometry::SelfCollisions(vector<pair<int,int> >& pairs,Real distance)
 {
-  //get world space bounding boxes for quick reject test
-  vector<int> validbodies;
-  validbodies.reserve(links.size());
-  for(size_t i=0;i<links.size();i++) 
-    if(!IsGeometryEmpty(i)) validbodies.push_back(i);
-  vector<AABB3D> bbs(validbodies.size());
-  for(size_t i=0;i<validbodies.size();i++) 
-    bbs[i] = geometry[validbodies[i]]->GetAABB();
-  if(distance != 0) {
-    //adjust bounding  boxes
-    Vector3 d(distance*0.5);
-    for(size_t i=0;i<bbs.size();i++) {
-      bbs[i].bmin -= d;
-      bbs[i].bmax += d;
-    }
-  }
-  //if |validbodies| > 300, you may want to use the functions in geometry/RangeQuery.h
-  //now check collisions, ensuring BBs overlap
-  for(size_t i=0;i<validbodies.size();i++) {
-    for(size_t j=i+1;j<validbodies.size();j++) {
-      CollisionQuery* query=selfCollisions(validbodies[i],validbodies[j]);
-      if(query == NULL) continue;
-      if(!bbs[i].intersects(bbs[j])) continue;
-      if(UnderCollisionMargin(query,distance)) pairs.push_back(pair<int,int>(validbodies[i],validbodies[j]));
-    }
-  }
-
+  vector<pair<int,int> > candidates;
+  SelfCollisionBroadPhase(candidates,distance);
+  //report the pairs in index order
+  sort(candidates.begin(),candidates.end());
+  for(size_t i=0;i<candidates.size();i++)
+    if(QuerySelfCollision(candidates[i].first,candidates[i].second,distance)) pairs.push_back(candidates[i]);
 }
 
-
 bool RobotWithGeometry::MeshCollision(CollisionGeometry& mesh)
 {
   if(!envCollisions[0] || envCollisions[0]->b != &mesh) {
@@ -4,6 +4,9 @@
 #include "RobotDynamics3D.h"
 #include <KrisLibrary/structs/array2d.h>
 #include <KrisLibrary/geometry/AnyGeometry.h>
+#include <KrisLibrary/math3d/Sphere3D.h>
+#include <KrisLibrary/math3d/Box3D.h>
+#include <KrisLibrary/math3d/AABB3D.h>
 #include <KrisLibrary/utils/SmartPointer.h>
 
 /** @ingroup Robot
@@ -15,6 +18,21 @@
  * 2) Load the geometry for each link using LoadGeometry(),
  * 3) Initialize the collision structures (and self collision pairs) using
  *    InitCollisions() and InitSelfCollisionPair().
+ *
+ * UpdateGeometry() also computes world-space bounding volumes of each link,
+ * which SelfCollision uses to cull link pairs before running the geometry
+ * queries: a sweep-and-prune over the links' AABBs, then bounding sphere and
+ * OBB tests on the pairs that survive.  The remaining pairs are queried in
+ * order of increasing bounding sphere separation.
+ *
+ * For planners that change a few joints at a time, UpdateConfigIncremental()
+ * followed by UpdateGeometryIncremental() only recomputes the frames and
+ * geometry transforms of the links that moved.  If cacheSelfCollisions is
+ * set, the self collision queries also remember their results, and reuse
+ * them while no joint between the two links has changed (tracked by the
+ * stamps of RobotKinematics3D).  The cache is only valid if the geometry is
+ * updated after each configuration change, and should be cleared with
+ * ClearSelfCollisionCache() if the geometry or its margins are modified.
  */
 class RobotWithGeometry : public RobotDynamics3D
 {
@@ -51,6 +69,11 @@ public:
   /// Call this before querying self collisions
   virtual void UpdateGeometry();
   virtual void UpdateGeometry(int i);
+  /// Updates the geometry of the links whose frames changed since their
+  /// geometry was last updated.  Returns the number of links updated.
+  int UpdateGeometryIncremental();
+  /// Computes the bounding volumes of link i from its geometry's transform
+  void UpdateBoundingVolumes(int i);
   /// Call this before querying environment collisions 
   virtual void InitMeshCollision(CollisionGeometry& mesh);
 
@@ -63,6 +86,13 @@ public:
   virtual bool SelfCollision(int i, int j, Real distance=0); 
   /// Compute all self collisions (faster than 
   virtual void SelfCollisions(std::vector<std::pair<int,int> >& pairs,Real distance=0);
+  /// Computes the self collision pairs whose bounding volumes are within the
+  /// given distance, sorted by increasing bounding sphere separation
+  void SelfCollisionBroadPhase(std::vector<std::pair<int,int> >& pairs,Real distance=0);
+  /// Runs the query of self collision pair i<j, using the cache if
+  /// cacheSelfCollisions is set
+  bool QuerySelfCollision(int i,int j,Real distance);
+  void ClearSelfCollisionCache();
 
   virtual bool MeshCollision(CollisionGeometry& mesh);
   virtual bool MeshCollision(int i,Real distance=0);
@@ -74,6 +104,25 @@ public:
   ///matrix(i,j) of collisions between bodies, i < j (upper triangular)
   Array2D<CollisionQuery*> selfCollisions;
   std::vector<CollisionQuery*> envCollisions;
+  ///World-space bounding volumes of the link geometries, set by UpdateGeometry
+  std::vector<Sphere3D> boundingSpheres;
+  std::vector<Box3D> boundingBoxes;
+  std::vector<AABB3D> boundingAABBs;
+  ///temporary: the links sorted by boundingAABBs[i].bmin.x in the last
+  ///broad phase, which is usually nearly sorted for the next one
+  std::vector<int> sweepOrder;
+  ///frameStamps[i] at the last UpdateGeometry(i), or -1
+  std::vector<int> geometryStamps;
+  ///If true, self collision results are reused while the links don't move
+  ///relative to each other (default false)
+  bool cacheSelfCollisions;
+  struct SelfCollisionCacheEntry
+  {
+    int stamp;      ///<updateCounter when the result was computed, or -1
+    Real distance;
+    bool result;
+  };
+  Array2D<SelfCollisionCacheEntry> selfCollisionCache;
 };
 
 #endif
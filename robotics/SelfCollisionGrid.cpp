@@ -0,0 +1,409 @@
+#include "SelfCollisionGrid.h"
+#include <math3d/Triangle3D.h>
+#include <errors.h>
+#include <fstream>
+#include <math.h>
+using namespace std;
+using namespace Geometry;
+
+//cells are never subdivided more than this many times
+const static int kMaxDepth = 16;
+
+//Returns the amount by which triangles A and B overlap along the axis u,
+//normalized by |u|.  Negative if u separates them.
+static Real AxisOverlap(const Triangle3D& A,const Triangle3D& B,const Vector3& u)
+{
+  Real a0=dot(u,A.a),a1=dot(u,A.b),a2=dot(u,A.c);
+  Real b0=dot(u,B.a),b1=dot(u,B.b),b2=dot(u,B.c);
+  Real amin=Min(a0,a1,a2),amax=Max(a0,a1,a2);
+  Real bmin=Min(b0,b1,b2),bmax=Max(b0,b1,b2);
+  return Min(amax-bmin,bmax-amin)/u.norm();
+}
+
+//Returns the penetration depth of two triangles, i.e., the shortest
+//translation of A that separates it from B, or a value <= 0 if they don't
+//intersect.  The separating axis candidates are the triangle normals and
+//the cross products of their edges.
+static Real TrianglePenetration(const Triangle3D& A,const Triangle3D& B)
+{
+  Vector3 ea[3]={A.b-A.a,A.c-A.b,A.a-A.c};
+  Vector3 eb[3]={B.b-B.a,B.c-B.b,B.a-B.c};
+  Vector3 na,nb;
+  na.setCross(ea[0],ea[1]);
+  nb.setCross(eb[0],eb[1]);
+  if(na.normSquared() == 0 || nb.normSquared() == 0) return 0;
+  Real depth = Min(AxisOverlap(A,B,na),AxisOverlap(A,B,nb));
+  Real scale = Max(na.norm(),nb.norm());
+  for(int i=0;i<3;i++)
+    for(int j=0;j<3;j++) {
+      Vector3 u;
+      u.setCross(ea[i],eb[j]);
+      //parallel edges give no new axis
+      if(u.norm() <= 1e-8*scale) continue;
+      depth = Min(depth,AxisOverlap(A,B,u));
+    }
+  return depth;
+}
+
+//Returns the largest distance from the link origin to a point of the
+//geometry, including the margin
+static Real LocalRadius(const RobotWithGeometry::CollisionGeometry& geom)
+{
+  AABB3D bb = geom.AnyGeometry3D::GetAABB();
+  Vector3 far(Max(Abs(bb.bmin.x),Abs(bb.bmax.x)),
+              Max(Abs(bb.bmin.y),Abs(bb.bmax.y)),
+              Max(Abs(bb.bmin.z),Abs(bb.bmax.z)));
+  return far.norm()+geom.margin;
+}
+
+//Returns the largest distance from the axis w through the link origin to a
+//point of the geometry, including the margin
+static Real LocalAxisRadius(const RobotWithGeometry::CollisionGeometry& geom,const Vector3& w)
+{
+  if(w.normSquared() == 0) return LocalRadius(geom);
+  AABB3D bb = geom.AnyGeometry3D::GetAABB();
+  Vector3 axis = w/w.norm();
+  Real rmax = 0;
+  for(int i=0;i<8;i++) {
+    Vector3 p((i&1)?bb.bmax.x:bb.bmin.x,(i&2)?bb.bmax.y:bb.bmin.y,(i&4)?bb.bmax.z:bb.bmin.z);
+    rmax = Max(rmax,cross(axis,p).norm());
+  }
+  return rmax+geom.margin;
+}
+
+//Rounds a positive bound down to float precision
+static float RoundDown(Real v)
+{
+  float f = (float)v;
+  if(f > v) f = nextafterf(f,0);
+  return f;
+}
+
+SelfCollisionGrid::SelfCollisionGrid(RobotWithGeometry& _robot)
+  :robot(_robot)
+{
+  ResetStats();
+}
+
+void SelfCollisionGrid::Clear()
+{
+  pairs.clear();
+  grids.clear();
+  gridIndex.clear();
+}
+
+void SelfCollisionGrid::ResetStats()
+{
+  numQueries = 0;
+  numCertifiedFree = numCertifiedColliding = numExact = 0;
+}
+
+void SelfCollisionGrid::PrintStats() const
+{
+  printf("Self collision grid: %d of %d pairs gridded, %d cells\n",(int)grids.size(),(int)pairs.size(),NumCells());
+  printf("  %d queries, %d pairs certified free, %d certified colliding, %d exact\n",numQueries,numCertifiedFree,numCertifiedColliding,numExact);
+}
+
+int SelfCollisionGrid::NumCells() const
+{
+  int n=0;
+  for(size_t i=0;i<grids.size();i++)
+    n += (int)grids[i].bounds.size();
+  return n;
+}
+
+void SelfCollisionGrid::InitPairs()
+{
+  int n = (int)robot.links.size();
+  pairs.clear();
+  grids.clear();
+  gridIndex.resize(n,n,-1);
+  gridIndex.set(-1);
+  for(int i=0;i<robot.selfCollisions.m;i++)
+    for(int j=i+1;j<robot.selfCollisions.n;j++)
+      if(robot.selfCollisions(i,j)) pairs.push_back(pair<int,int>(i,j));
+}
+
+void SelfCollisionGrid::GetPathDofs(int a,int b,vector<int>& dofs,vector<int>& sides) const
+{
+  dofs.resize(0);
+  sides.resize(0);
+  vector<bool> aboveA(robot.links.size(),false);
+  for(int k=a;k>=0;k=robot.parents[k]) aboveA[k]=true;
+  int lca=b;
+  while(lca>=0 && !aboveA[lca]) lca=robot.parents[lca];
+  for(int k=a;k!=lca;k=robot.parents[k]) { dofs.push_back(k); sides.push_back(0); }
+  for(int k=b;k!=lca;k=robot.parents[k]) { dofs.push_back(k); sides.push_back(1); }
+}
+
+//Returns the value of a cell whose center is the current configuration, and
+//in which the geometry moves at most slack
+static float CellBound(RobotWithGeometry::CollisionQuery* query,Real slack)
+{
+  if(query->CollideAll()) {
+    //colliding in the whole cell if some pair of triangles penetrates by
+    //more than the cell can move them
+    const CollisionMesh& ma = query->a->TriangleMeshCollisionData();
+    const CollisionMesh& mb = query->b->TriangleMeshCollisionData();
+    Triangle3D ta,tb;
+    Real depth = 0;
+    for(size_t e=0;e<query->elements1.size();e++) {
+      ma.GetTriangle(query->elements1[e],ta);
+      mb.GetTriangle(query->elements2[e],tb);
+      ta.a = ma.currentTransform*ta.a; ta.b = ma.currentTransform*ta.b; ta.c = ma.currentTransform*ta.c;
+      tb.a = mb.currentTransform*tb.a; tb.b = mb.currentTransform*tb.b; tb.c = mb.currentTransform*tb.c;
+      depth = Max(depth,TrianglePenetration(ta,tb));
+    }
+    if(depth > slack) return -Max((float)(depth-slack),1e-30f);
+    return 0;
+  }
+  Real d = query->Distance(0,0);
+  if(d > slack) return RoundDown(d-slack);
+  return 0;
+}
+
+bool SelfCollisionGrid::BuildPair(int a,int b,int maxDofs,int maxCells,PairGrid& grid)
+{
+  RobotWithGeometry::CollisionQuery* query = robot.selfCollisions(a,b);
+  if(!query || robot.IsGeometryEmpty(a) || robot.IsGeometryEmpty(b)) return false;
+  if(query->a->type != AnyGeometry3D::TriangleMesh || query->b->type != AnyGeometry3D::TriangleMesh) return false;
+  query->a->InitCollisionData();
+  query->b->InitCollisionData();
+  vector<int> dofs,sides;
+  GetPathDofs(a,b,dofs,sides);
+  int numActive=0;
+  for(size_t k=0;k<dofs.size();k++) {
+    Real lo=robot.qMin(dofs[k]),hi=robot.qMax(dofs[k]);
+    if(!IsFinite(lo) || !IsFinite(hi) || hi < lo) return false;
+    if(hi > lo) numActive++;
+  }
+  if(numActive > maxDofs) return false;
+
+  //bound the rate at which each dof moves its side's geometry, walking up
+  //from the link and accumulating the largest distance from the joint to
+  //the geometry
+  vector<Real> rate(dofs.size());
+  Real reach[2]={LocalRadius(*robot.geometry[a]),LocalRadius(*robot.geometry[b])};
+  for(size_t k=0;k<dofs.size();k++) {
+    const RobotLink3D& link=robot.links[dofs[k]];
+    Real& r = reach[sides[k]];
+    Real wnorm = link.w.norm();
+    if(link.type == RobotLink3D::Revolute) {
+      //the link's own joint rotates the geometry about the axis
+      if(dofs[k] == a || dofs[k] == b)
+        rate[k] = wnorm*Min(r,LocalAxisRadius(*robot.geometry[dofs[k]],link.w));
+      else
+        rate[k] = wnorm*r;
+    }
+    else rate[k] = wnorm;
+    r += link.T0_Parent.t.norm();
+    if(link.type == RobotLink3D::Prismatic)
+      r += wnorm*Max(Abs(robot.qMin(dofs[k])),Abs(robot.qMax(dofs[k])));
+  }
+
+  //subdivide breadth-first, so that the budget refines the tree evenly.
+  //Nodes are appended in breadth-first order, so they are processed in
+  //index order.
+  grid.a = a;
+  grid.b = b;
+  grid.dofs = dofs;
+  grid.qmin.resize(dofs.size());
+  grid.qmax.resize(dofs.size());
+  for(size_t k=0;k<dofs.size();k++) {
+    grid.qmin[k] = robot.qMin(dofs[k]);
+    grid.qmax[k] = robot.qMax(dofs[k]);
+  }
+  int nd = (int)dofs.size();
+  int numChildren = (1<<numActive);
+  grid.bounds.resize(1);
+  grid.children.resize(1);
+  grid.children[0] = -1;
+  vector<int> levels(1,0),coords(nd,0);
+  for(size_t node=0;node<grid.bounds.size();node++) {
+    int level = levels[node];
+    Real slack = 0;  //the most the geometry moves within the cell
+    for(int k=0;k<nd;k++) {
+      Real width = (grid.qmax[k]-grid.qmin[k])/(1<<level);
+      robot.q(dofs[k]) = grid.qmin[k] + (coords[node*nd+k]+0.5)*width;
+      slack += 0.5*rate[k]*width;
+    }
+    robot.UpdateFrames();
+    robot.UpdateGeometry(a);
+    robot.UpdateGeometry(b);
+    float v = CellBound(query,slack);
+    grid.bounds[node] = v;
+    if(v != 0 || numActive == 0 || level >= kMaxDepth || (int)grid.bounds.size()+numChildren > maxCells) continue;
+    grid.children[node] = (int)grid.bounds.size();
+    for(int c=0;c<numChildren;c++) {
+      grid.bounds.push_back(0);
+      grid.children.push_back(-1);
+      levels.push_back(level+1);
+      int bit=0;
+      for(int k=0;k<nd;k++) {
+        if(grid.qmax[k] > grid.qmin[k]) {
+          coords.push_back(2*coords[node*nd+k]+((c>>bit)&1));
+          bit++;
+        }
+        else coords.push_back(0);
+      }
+    }
+  }
+  return true;
+}
+
+void SelfCollisionGrid::Build(int maxDofs,int maxCells)
+{
+  InitPairs();
+  Config q0 = robot.q;
+  PairGrid grid;
+  for(size_t p=0;p<pairs.size();p++) {
+    if(!BuildPair(pairs[p].first,pairs[p].second,maxDofs,maxCells,grid)) continue;
+    gridIndex(grid.a,grid.b) = (int)grids.size();
+    grids.push_back(grid);
+  }
+  robot.UpdateConfig(q0);
+  robot.UpdateGeometry();
+}
+
+float SelfCollisionGrid::Lookup(const PairGrid& grid,const Config& q) const
+{
+  for(size_t k=0;k<grid.dofs.size();k++) {
+    Real x = q(grid.dofs[k]);
+    if(x < grid.qmin[k] || x > grid.qmax[k]) return 0;
+  }
+  //descend the tree; the child's bit for each dof is the lowest bit of the
+  //cell coordinate at the child's level
+  int node=0,level=0;
+  while(grid.children[node] >= 0) {
+    level++;
+    int n=(1<<level),c=0,bit=0;
+    for(size_t k=0;k<grid.dofs.size();k++) {
+      if(grid.qmax[k] == grid.qmin[k]) continue;
+      int ck = (int)((q(grid.dofs[k])-grid.qmin[k])/(grid.qmax[k]-grid.qmin[k])*n);
+      if(ck >= n) ck = n-1;
+      c |= (ck&1)<<bit;
+      bit++;
+    }
+    node = grid.children[node]+c;
+  }
+  return grid.bounds[node];
+}
+
+int SelfCollisionGrid::Classify(int i,int j,const Config& q,Real distance) const
+{
+  if(i > j) swap(i,j);
+  if(distance < 0 || i >= gridIndex.m || j >= gridIndex.n) return 0;
+  int g = gridIndex(i,j);
+  if(g < 0) return 0;
+  float v = Lookup(grids[g],q);
+  if(v > distance) return 1;
+  if(v < 0) return -1;
+  return 0;
+}
+
+bool SelfCollisionGrid::SelfCollision(const Config& q,Real distance)
+{
+  numQueries++;
+  vector<pair<int,int> > uncertain;
+  for(size_t p=0;p<pairs.size();p++) {
+    int res = Classify(pairs[p].first,pairs[p].second,q,distance);
+    if(res < 0) {
+      numCertifiedColliding++;
+      return true;
+    }
+    if(res > 0) numCertifiedFree++;
+    else uncertain.push_back(pairs[p]);
+  }
+  if(uncertain.empty()) return false;
+
+  robot.UpdateConfigIncremental(q);
+  vector<bool> updated(robot.links.size(),false);
+  for(size_t p=0;p<uncertain.size();p++) {
+    int a=uncertain[p].first,b=uncertain[p].second;
+    if(!updated[a]) { robot.UpdateGeometry(a); updated[a]=true; }
+    if(!updated[b]) { robot.UpdateGeometry(b); updated[b]=true; }
+    //cheap rejection with the bounding spheres
+    const Sphere3D& sa=robot.boundingSpheres[a],&sb=robot.boundingSpheres[b];
+    if(sa.center.distance(sb.center) > sa.radius+sb.radius+distance) continue;
+    numExact++;
+    if(robot.SelfCollision(a,b,distance)) return true;
+  }
+  return false;
+}
+
+bool SelfCollisionGrid::Save(const char* fn) const
+{
+  ofstream out(fn,ios::out);
+  if(!out) {
+    fprintf(stderr,"SelfCollisionGrid::Save: could not open %s\n",fn);
+    return false;
+  }
+  out<<"SelfCollisionGrid "<<robot.links.size()<<" "<<grids.size()<<endl;
+  for(size_t g=0;g<grids.size();g++) {
+    const PairGrid& grid=grids[g];
+    out<<grid.a<<" "<<grid.b<<" "<<grid.dofs.size()<<" "<<grid.bounds.size()<<endl;
+    out.precision(17);
+    for(size_t k=0;k<grid.dofs.size();k++)
+      out<<grid.dofs[k]<<" "<<grid.qmin[k]<<" "<<grid.qmax[k]<<endl;
+    out.precision(9);
+    for(size_t c=0;c<grid.bounds.size();c++)
+      out<<grid.bounds[c]<<" "<<grid.children[c]<<endl;
+  }
+  out.close();
+  return (bool)out;
+}
+
+bool SelfCollisionGrid::Load(const char* fn)
+{
+  ifstream in(fn,ios::in);
+  if(!in) {
+    fprintf(stderr,"SelfCollisionGrid::Load: could not open %s\n",fn);
+    return false;
+  }
+  string header;
+  int numLinks,numGrids;
+  in>>header>>numLinks>>numGrids;
+  if(!in || header != "SelfCollisionGrid" || numGrids < 0) {
+    fprintf(stderr,"SelfCollisionGrid::Load: %s is not a self collision grid file\n",fn);
+    return false;
+  }
+  if(numLinks != (int)robot.links.size()) {
+    fprintf(stderr,"SelfCollisionGrid::Load: %s was built for a robot with %d links, not %d\n",fn,numLinks,(int)robot.links.size());
+    return false;
+  }
+  InitPairs();
+  for(int g=0;g<numGrids;g++) {
+    PairGrid grid;
+    int numDofs,numNodes;
+    in>>grid.a>>grid.b>>numDofs>>numNodes;
+    bool ok = (in && grid.a >= 0 && grid.a < grid.b && grid.b < numLinks && numDofs >= 0 && numNodes > 0 && robot.selfCollisions(grid.a,grid.b));
+    int numChildren = 1;
+    if(ok) {
+      grid.dofs.resize(numDofs);
+      grid.qmin.resize(numDofs);
+      grid.qmax.resize(numDofs);
+      for(int k=0;k<numDofs && ok;k++) {
+        in>>grid.dofs[k]>>grid.qmin[k]>>grid.qmax[k];
+        ok = (in && grid.dofs[k] >= 0 && grid.dofs[k] < numLinks && grid.qmin[k] <= grid.qmax[k]);
+        if(grid.qmax[k] > grid.qmin[k]) numChildren *= 2;
+      }
+    }
+    if(ok) {
+      grid.bounds.resize(numNodes);
+      grid.children.resize(numNodes);
+      for(int c=0;c<numNodes && ok;c++) {
+        in>>grid.bounds[c]>>grid.children[c];
+        //children come after their parent, so the tree has no cycles
+        ok = (in && (grid.children[c] < 0 || (grid.children[c] > c && grid.children[c]+numChildren <= numNodes)));
+      }
+    }
+    if(!ok) {
+      fprintf(stderr,"SelfCollisionGrid::Load: error reading grid %d of %s\n",g,fn);
+      Clear();
+      return false;
+    }
+    gridIndex(grid.a,grid.b) = (int)grids.size();
+    grids.push_back(grid);
+  }
+  return true;
+}
@@ -0,0 +1,98 @@
+#ifndef ROBOTICS_SELF_COLLISION_GRID_H
+#define ROBOTICS_SELF_COLLISION_GRID_H
+
+#include "RobotWithGeometry.h"
+#include <KrisLibrary/structs/array2d.h>
+#include <vector>
+
+/** @ingroup Robot
+ * @brief Precomputed, conservative self-collision bounds for the link pairs
+ * of a RobotWithGeometry, which certify most configurations as free or
+ * colliding without computing frames or running geometry queries.
+ *
+ * The relative transform of links a and b only depends on the joints on
+ * the path between them (below their lowest common ancestor).  For each
+ * self collision pair between two triangle meshes with at most maxDofs
+ * such joints (not counting frozen ones), all with finite ranges, Build()
+ * divides the range of those joints into a tree of cells, splitting each
+ * cell in half along every joint, and queries the geometry at each cell
+ * center.  A cell is stored as a single float:
+ * - v > 0: the distance between the links is at least v in the whole cell,
+ *   computed from the distance d at the center as d - sum_k L_k*h_k/2,
+ *   where h_k is the cell width and L_k bounds the rate at which joint k
+ *   moves the points of one link relative to the other.
+ * - v < 0: the links collide in the whole cell, because a pair of triangles
+ *   at the center overlaps by more than the cell can move them.
+ * - v = 0: unknown, the cell is split, or if it is too small or the pair
+ *   has used up maxCells, an exact query is needed there.
+ * So only the cells near the boundary between free and colliding
+ * configurations are refined, and a pair that never collides takes a
+ * single cell.
+ *
+ * Pairs without a grid (too many joints, unbounded joints, or geometry
+ * other than triangle meshes) are always checked exactly.  Queries with a
+ * negative distance (allowed penetration) are also checked exactly.
+ *
+ * Build() changes the robot's configuration and restores it at the end.
+ * The grids are only valid for the robot's geometry, joint limits and
+ * self collision pairs at the time of the build.
+ */
+class SelfCollisionGrid
+{
+ public:
+  SelfCollisionGrid(RobotWithGeometry& robot);
+  void Clear();
+  ///Precomputes the grids of all self collision pairs that depend on at
+  ///most maxDofs joints, with at most maxCells cells each.
+  void Build(int maxDofs=3,int maxCells=10000);
+  ///Returns 1 if links i and j are certified to be farther than distance
+  ///apart at q, -1 if they are certified to be colliding, and 0 if unknown.
+  int Classify(int i,int j,const Config& q,Real distance=0) const;
+  ///Returns true if the robot is in self collision at q.  The robot's
+  ///frames and geometry are only updated to q if some pair can't be
+  ///classified from the grids.
+  bool SelfCollision(const Config& q,Real distance=0);
+  bool Save(const char* fn) const;
+  bool Load(const char* fn);
+  ///Returns the total number of cells stored
+  int NumCells() const;
+  void ResetStats();
+  void PrintStats() const;
+
+  RobotWithGeometry& robot;
+
+  //statistics
+  int numQueries;          ///<calls to SelfCollision
+  int numCertifiedFree;    ///<pairs certified free by a grid
+  int numCertifiedColliding; ///<pairs certified colliding by a grid
+  int numExact;            ///<pairs checked with the geometry
+
+  //internal: the cell tree of one pair.  Cell 0 is the whole range of the
+  //dofs, and the 2^d children of a split cell are stored contiguously, the
+  //k'th bit of the child's index selecting the upper half of the k'th dof
+  //with a nonzero range.
+  struct PairGrid
+  {
+    int a,b;
+    std::vector<int> dofs;
+    std::vector<Real> qmin,qmax;
+    std::vector<float> bounds;   ///<the value of each cell
+    std::vector<int> children;   ///<the index of each cell's first child, or -1
+  };
+  void InitPairs();
+  ///Gets the joints on the path between links a and b, and on which side
+  ///each one is (0 moves a, 1 moves b)
+  void GetPathDofs(int a,int b,std::vector<int>& dofs,std::vector<int>& sides) const;
+  ///Computes the cell tree of pair (a,b).  Returns false if the pair is not suited
+  ///for a grid.
+  bool BuildPair(int a,int b,int maxDofs,int maxCells,PairGrid& grid);
+  ///Returns the value stored for q, or 0 if q is outside the grid
+  float Lookup(const PairGrid& grid,const Config& q) const;
+
+  std::vector<std::pair<int,int> > pairs;
+  std::vector<PairGrid> grids;
+  ///gridIndex(i,j) is the index of the grid of pair i<j, or -1
+  Array2D<int> gridIndex;
+};
+
+#endif
@@ -72,6 +72,17 @@ int PiecewisePolynomial::FindSegment(double t) const
   return times.size()-1;
 }
 
+int PiecewisePolynomial::FindSegment(double t,int hint) const
+{
+  if(hint >= 0 && hint < (int)times.size() && times[hint] <= t) {
+    for(int k=0;k<4;k++,hint++) {
+      if(hint+1 == (int)times.size() || t < times[hint+1])
+        return hint;
+    }
+  }
+  return FindSegment(t);
+}
+
 double PiecewisePolynomial::Evaluate(double t) const
 {
   assert(!segments.empty());
@@ -84,6 +95,15 @@ double PiecewisePolynomial::Evaluate(double t) const
   }
 }
 
+double PiecewisePolynomial::Evaluate(double t,int& segment) const
+{
+  assert(!segments.empty());
+  segment = FindSegment(t,segment);
+  if(segment < 0) return Start();
+  else if (segment >= (int)segments.size()) return End();
+  else return segments[segment](t-timeShift[segment]);
+}
+
 double PiecewisePolynomial::Derivative(double t) const
 {
   assert(!segments.empty());
@@ -340,6 +360,28 @@ Vector PiecewisePolynomialND::Evaluate(double t) const
   return res;
 }
 
+void PiecewisePolynomialND::Evaluate(double t,Vector& res,std::vector<int>& segments) const
+{
+  res.resize(elements.size());
+  if(segments.size() != elements.size()) segments.assign(elements.size(),0);
+  for(size_t i=0;i<elements.size();i++)
+    res[i] = elements[i].Evaluate(t,segments[i]);
+}
+
+void PiecewisePolynomialND::Evaluate(const std::vector<double>& ts,std::vector<double>& out) const
+{
+  size_t n = elements.size();
+  out.resize(ts.size()*n);
+  std::vector<int> segments(n,0);
+  for(size_t i=0;i<n;i++) {
+    //one element at a time, so its segments stay in cache
+    const PiecewisePolynomial& e = elements[i];
+    int& segment = segments[i];
+    for(size_t j=0;j<ts.size();j++)
+      out[j*n+i] = e.Evaluate(ts[j],segment);
+  }
+}
+
 Vector PiecewisePolynomialND::Derivative(double t) const
 {
   Vector res(elements.size());
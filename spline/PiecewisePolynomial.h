@@ -30,7 +30,14 @@ class PiecewisePolynomial
   PiecewisePolynomial(const std::vector<Poly>& _segments,const std::vector<double>& _times,const std::vector<double>& _timeShifts);
 
   int FindSegment(double t) const;
+  ///Same as FindSegment(t), but first looks at segment hint and the few
+  ///after it, so a sequence of increasing times, e.g., a controller's
+  ///samples, takes O(1) amortized time per lookup
+  int FindSegment(double t,int hint) const;
   double Evaluate(double t) const;
+  ///Same as Evaluate(t), but uses segment as a hint for FindSegment and
+  ///sets it to the segment of t
+  double Evaluate(double t,int& segment) const;
   double Derivative(double t) const;
   double Derivative(double t,int n) const;
   double operator () (double t) const { return Evaluate(t); }
@@ -113,6 +120,14 @@ class PiecewisePolynomialND
   PiecewisePolynomialND(const std::vector<PiecewisePolynomial>& elements);
 
   Vector Evaluate(double t) const;
+  ///Evaluates at t into res.  segments holds the segment of each element
+  ///found by the previous call, and is used as a hint (see
+  ///PiecewisePolynomial::FindSegment).  Start with an empty segments.
+  void Evaluate(double t,Vector& res,std::vector<int>& segments) const;
+  ///Evaluates at each of the times ts, and stores the values in out, one
+  ///row of elements.size() values per time.  Increasing times take O(1)
+  ///amortized time each to look up.
+  void Evaluate(const std::vector<double>& ts,std::vector<double>& out) const;
   Vector Derivative(double t) const;
   Vector Derivative(double t,int n) const;
   Vector operator () (double t) const { return Evaluate(t); }
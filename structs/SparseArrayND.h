@@ -0,0 +1,199 @@
+#ifndef SPARSE_ARRAY_ND_H
+#define SPARSE_ARRAY_ND_H
+
+#include <KrisLibrary/utils/stl_tr1.h>
+#include <vector>
+#include <assert.h>
+
+/** @brief A sparse N-D array stored as a hash of fixed-size blocks.
+ *
+ * The index space is split into cubic blocks of blockSize^N cells.  A block
+ * is only allocated when one of its cells is written with ref() or the
+ * block is allocated explicitly; reads of cells in unallocated blocks
+ * return the background value.  This lets very large, high-dimensional
+ * grids be used when only a thin region of them is ever touched.
+ *
+ * Cells inside a block are stored in row-major order, like ArrayND.
+ * Blocks are identified by a 64-bit key, the row-major offset of the block
+ * in the grid of blocks.  Block storage does not move when other blocks are
+ * allocated, so pointers returned by getBlock() remain valid until
+ * the block is erased or the array is cleared.
+ */
+template <class T>
+class SparseArrayND
+{
+ public:
+  typedef long long Key;
+  typedef std::vector<T> Block;
+  typedef UNORDERED_MAP_TEMPLATE<Key,Block> BlockMap;
+
+  SparseArrayND();
+  ///note: resize is destructive
+  void resize(const std::vector<int>& dims,int blockSize=8,const T& background=T());
+  void clear();
+  inline size_t numDims() const { return dims.size(); }
+  ///Number of values in the allocated blocks
+  inline size_t numValues() const { return blocks.size()*blockValues; }
+  inline size_t numBlocks() const { return blocks.size(); }
+  inline const std::vector<int>& size() const { return dims; }
+  ///Approximate number of bytes used by the allocated blocks
+  size_t memoryUsage() const;
+
+  ///Returns the background value if the cell's block is not allocated
+  const T& operator [] (const std::vector<int>& index) const;
+  ///Allocates the cell's block if needed
+  T& ref(const std::vector<int>& index);
+  bool isAllocated(const std::vector<int>& index) const;
+
+  //block-level access
+  Key blockKey(const std::vector<int>& index) const;
+  int offsetInBlock(const std::vector<int>& index) const;
+  ///Returns NULL if the block is not allocated
+  T* getBlock(Key key);
+  const T* getBlock(Key key) const;
+  ///Allocates the block, filled with the background value, if needed
+  T* allocateBlock(Key key);
+  void eraseBlock(Key key);
+  ///Gets the lowest cell index of the block
+  void blockStart(Key key,std::vector<int>& index) const;
+
+  std::vector<int> dims;
+  int blockSize;
+  T background;
+  ///Number of blocks along each axis
+  std::vector<int> blockDims;
+  std::vector<Key> blockStrides;
+  ///Strides of the cells within a block
+  std::vector<int> cellStrides;
+  int blockValues;
+  BlockMap blocks;
+};
+
+template <class T>
+SparseArrayND<T>::SparseArrayND()
+  :blockSize(0),background(),blockValues(0)
+{}
+
+template <class T>
+void SparseArrayND<T>::resize(const std::vector<int>& _dims,int _blockSize,const T& _background)
+{
+  assert(_blockSize > 0);
+  blocks.clear();
+  dims = _dims;
+  blockSize = _blockSize;
+  background = _background;
+  int n = (int)dims.size();
+  blockDims.resize(n);
+  blockStrides.resize(n);
+  cellStrides.resize(n);
+  Key numBlocks = 1;
+  blockValues = 1;
+  for(int i=n-1;i>=0;i--) {
+    blockDims[i] = (dims[i]+blockSize-1)/blockSize;
+    blockStrides[i] = numBlocks;
+    numBlocks *= blockDims[i];
+    cellStrides[i] = blockValues;
+    blockValues *= blockSize;
+  }
+}
+
+template <class T>
+void SparseArrayND<T>::clear()
+{
+  blocks.clear();
+  dims.resize(0);
+  blockDims.resize(0);
+  blockStrides.resize(0);
+  cellStrides.resize(0);
+  blockValues = 0;
+}
+
+template <class T>
+size_t SparseArrayND<T>::memoryUsage() const
+{
+  //block contents plus a rough estimate of the hash node and bucket overhead
+  size_t perBlock = blockValues*sizeof(T) + sizeof(Key) + sizeof(Block) + 3*sizeof(void*);
+  return blocks.size()*perBlock + blocks.bucket_count()*sizeof(void*);
+}
+
+template <class T>
+typename SparseArrayND<T>::Key SparseArrayND<T>::blockKey(const std::vector<int>& index) const
+{
+  assert(index.size() == dims.size());
+  Key key = 0;
+  for(size_t i=0;i<index.size();i++) {
+    assert(index[i] >= 0 && index[i] < dims[i]);
+    key += Key(index[i]/blockSize)*blockStrides[i];
+  }
+  return key;
+}
+
+template <class T>
+int SparseArrayND<T>::offsetInBlock(const std::vector<int>& index) const
+{
+  int offset = 0;
+  for(size_t i=0;i<index.size();i++)
+    offset += (index[i]%blockSize)*cellStrides[i];
+  return offset;
+}
+
+template <class T>
+const T& SparseArrayND<T>::operator [] (const std::vector<int>& index) const
+{
+  const T* block = getBlock(blockKey(index));
+  if(!block) return background;
+  return block[offsetInBlock(index)];
+}
+
+template <class T>
+T& SparseArrayND<T>::ref(const std::vector<int>& index)
+{
+  return allocateBlock(blockKey(index))[offsetInBlock(index)];
+}
+
+template <class T>
+bool SparseArrayND<T>::isAllocated(const std::vector<int>& index) const
+{
+  return blocks.count(blockKey(index)) != 0;
+}
+
+template <class T>
+T* SparseArrayND<T>::getBlock(Key key)
+{
+  typename BlockMap::iterator i = blocks.find(key);
+  if(i == blocks.end()) return NULL;
+  return &i->second[0];
+}
+
+template <class T>
+const T* SparseArrayND<T>::getBlock(Key key) const
+{
+  typename BlockMap::const_iterator i = blocks.find(key);
+  if(i == blocks.end()) return NULL;
+  return &i->second[0];
+}
+
+template <class T>
+T* SparseArrayND<T>::allocateBlock(Key key)
+{
+  Block& block = blocks[key];
+  if(block.empty()) block.resize(blockValues,background);
+  return &block[0];
+}
+
+template <class T>
+void SparseArrayND<T>::eraseBlock(Key key)
+{
+  blocks.erase(key);
+}
+
+template <class T>
+void SparseArrayND<T>::blockStart(Key key,std::vector<int>& index) const
+{
+  index.resize(dims.size());
+  for(size_t i=0;i<dims.size();i++) {
+    index[i] = int((key/blockStrides[i])%blockDims[i])*blockSize;
+  }
+}
+
+#endif
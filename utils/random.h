@@ -43,6 +43,54 @@ struct StandardRNG
 };
 
 
+/** @brief A fast 64-bit xorshift* generator that keeps its own state.
+ *
+ * Unlike StandardRNG, each object is an independent generator, so separate
+ * objects can be used concurrently on separate threads.  seed(n,stream)
+ * scrambles the (seed,stream) pair so that different streams with the same
+ * seed produce uncorrelated sequences.
+ */
+struct RNG64
+{
+  RNG64(unsigned long n=0) { seed(n,0); }
+  inline void seed(unsigned long n) { seed(n,0); }
+  inline void seed(unsigned long n,unsigned long stream) {
+    //splitmix64 scrambling of the seed and stream index
+    unsigned long long z = (unsigned long long)n + 0x9E3779B97F4A7C15ULL*((unsigned long long)stream+1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    state = (z == 0 ? 0x9E3779B97F4A7C15ULL : z);
+    gaussianSpare = 0;
+  }
+  inline unsigned long long randLong() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+  }
+  static inline long int maxValue() { return INT_MAX; }
+  inline long int randInt() { return (long int)(randLong() >> 33); }
+  inline float randFloat() { return float(randLong() >> 40)*(1.0f/16777216.0f); }
+  inline double randDouble() { return double(randLong() >> 11)*(1.0/9007199254740992.0); }
+
+  ///helpers
+  inline long int randInt(long int n) { return randInt()%n; }
+  inline float randFloat(float a, float b) {
+    float t = randFloat();
+    return a + t*(b-a); 
+  }
+  inline double randDouble(double a, double b) {
+    double t = randDouble();
+    return a + t*(b-a);
+  }
+
+  unsigned long long state;
+  ///Second value from the last gaussian draw, 0 if none is cached (see
+  ///drand_gaussian in math/random.h)
+  double gaussianSpare;
+};
+
 #if 0
 ///This RNG generates a lot of warnings
 ///generates a random 32 bit random number using a linear congruential generator